@@ -18,6 +18,7 @@
 
 
 #define EEPROM_BOOT_PARAMS_MAX_SIZE                        (512)    //参数区大小
+#define EEPROM_LEGACY_BOOT_PARAMS_ADDR                      (4096 - EEPROM_BOOT_PARAMS_MAX_SIZE)    //旧版4096字节EEPROM中的参数区地址
 
 hal_boot_params_t intorobot_boot_params;         //bootloader参数
 hal_system_params_t intorobot_system_params;     //设备参数
@@ -67,9 +68,7 @@ void read_boot_params(hal_boot_params_t *pboot_params) {
         return;
     }
 
-    for (int num = 0; num<len; num++) {
-        pboot[num] = HAL_EEPROM_Read(address+num);
-    }
+    HAL_EEPROM_Get(address, pboot, len);
 }
 
 /*
@@ -84,9 +83,28 @@ void save_boot_params(hal_boot_params_t *pboot_params) {
         return;
     }
 
-    for (int num = 0; num<len; num++) {
-        HAL_EEPROM_Write(address+num, pboot[num]);
-    }
+    //整块写入 复位时不会留下一半新一半旧的参数
+    HAL_EEPROM_Put(address, pboot, len);
+}
+
+/*
+ * 读取旧版EEPROM中的bootloader参数区
+ * 旧版按4096个虚拟地址存储 记录格式与现在相同 超出容量的记录仍然可读
+ * */
+bool read_legacy_boot_params(hal_boot_params_t *pboot_params) {
+    HAL_EEPROM_Get(EEPROM_LEGACY_BOOT_PARAMS_ADDR, pboot_params, sizeof(hal_boot_params_t));
+    return BOOT_PARAMS_HEADER == pboot_params->header;
+}
+
+/*
+ * 清除旧地址的bootloader参数区
+ * 写为0xFF的记录在页交换时不再搬移
+ * */
+void clear_legacy_boot_params(void) {
+    hal_boot_params_t erased;
+
+    memset((uint8_t *)&erased, 0xFF, sizeof(hal_boot_params_t));
+    HAL_EEPROM_Put(EEPROM_LEGACY_BOOT_PARAMS_ADDR, &erased, sizeof(hal_boot_params_t));
 }
 
 void save_system_params(hal_system_params_t *psystem_params);
@@ -145,13 +163,26 @@ void HAL_PARAMS_Init_Boot_Params(void) {
  * 读取bootloader参数区
  * */
 void HAL_PARAMS_Load_Boot_Params(void) {
+    hal_boot_params_t legacy_params;
+    bool legacy = read_legacy_boot_params(&legacy_params);
+
     read_boot_params(&intorobot_boot_params);
     if( BOOT_PARAMS_HEADER != intorobot_boot_params.header ) {
-        //擦除eeprom区域 并初始化
-        HAL_FLASH_Interminal_Erase(HAL_FLASH_Interminal_Get_Sector(EEPROM_START_ADDR));
-        HAL_FLASH_Interminal_Erase(HAL_FLASH_Interminal_Get_Sector(EEPROM_START_ADDR)+1);
-        HAL_EEPROM_Init();
-        HAL_PARAMS_Init_Boot_Params();
+        //从旧版EEPROM升级 迁移参数到新地址 旧版bootloader期间应用也写在旧地址
+        if(legacy) {
+            memcpy(&intorobot_boot_params, &legacy_params, sizeof(hal_boot_params_t));
+            save_boot_params(&intorobot_boot_params);
+        } else {
+            //擦除eeprom区域 并初始化
+            HAL_FLASH_Interminal_Erase(HAL_FLASH_Interminal_Get_Sector(EEPROM_START_ADDR));
+            HAL_FLASH_Interminal_Erase(HAL_FLASH_Interminal_Get_Sector(EEPROM_START_ADDR)+1);
+            HAL_EEPROM_Init();
+            HAL_PARAMS_Init_Boot_Params();
+        }
+    }
+    //迁移后清除旧地址 应用由此知道bootloader已更新 迁移中途复位时下次启动再清除
+    if(legacy) {
+        clear_legacy_boot_params();
     }
 }
 
@@ -4,7 +4,7 @@
 #include "eeprom_hal.h"
 #include "boot_debug.h"
 
-#define ESP8266_USART_QUEUE_SIZE              (1024*20)
+#define ESP8266_USART_QUEUE_SIZE              (1024*32)    //队列大小须为2的幂，不小于原来的20K
 
 UART_HandleTypeDef UartHandleDebug;
 UART_HandleTypeDef UartHandleEsp8266;
@@ -55,6 +55,8 @@ uint8_t HAL_OTA_Get_Download_Progress();
 bool HAL_OTA_CheckValidAddressRange(uint32_t startAddress, uint32_t length);
 uint32_t HAL_OTA_FlashAddress();
 uint32_t HAL_OTA_FlashLength();
+uint32_t HAL_APP_FlashAddress();
+uint32_t HAL_APP_FlashLength();
 uint16_t HAL_OTA_ChunkSize();
 uint32_t HAL_DEF_APP_FlashAddress();
 uint32_t HAL_DEF_APP_FlashLength();
@@ -63,6 +65,8 @@ uint32_t HAL_BOOT_FlashLength();
 
 bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved);
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved);
+/* 读取flash内容, 差分升级时读取正在运行的应用程序. 成功返回0 */
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length);
 
 typedef enum {
     HAL_UPDATE_ERROR,
@@ -72,6 +76,10 @@ typedef enum {
 
 hal_update_complete_t HAL_FLASH_End(void);
 
+/* 在线升级断点记录, data为NULL时清除记录 */
+bool HAL_OTA_Get_Checkpoint(void* data, uint32_t length);
+bool HAL_OTA_Set_Checkpoint(const void* data, uint32_t length);
+
 #ifdef	__cplusplus
 }
 #endif
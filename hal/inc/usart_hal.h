@@ -66,9 +66,11 @@ void HAL_USART_Initial(HAL_USART_Serial serial);
 void HAL_USART_Begin(HAL_USART_Serial serial, uint32_t baud);
 void HAL_USART_End(HAL_USART_Serial serial);
 uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data);
+int32_t HAL_USART_Write_Buffer(HAL_USART_Serial serial, const uint8_t *buffer, uint32_t size);
 int32_t HAL_USART_Available_Data_For_Write(HAL_USART_Serial serial);
 int32_t HAL_USART_Available_Data(HAL_USART_Serial serial);
 int32_t HAL_USART_Read_Data(HAL_USART_Serial serial);
+int32_t HAL_USART_Read_Buffer(HAL_USART_Serial serial, uint8_t *buffer, uint32_t size);
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial);
 void HAL_USART_Flush_Data(HAL_USART_Serial serial);
 bool HAL_USART_Is_Enabled(HAL_USART_Serial serial);
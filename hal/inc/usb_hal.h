@@ -69,6 +69,12 @@ int32_t USB_USART_Available_Data_For_Write(void);
  */
 int32_t USB_USART_Receive_Data(uint8_t peek);
 
+/**
+ * Reads up to size bytes from the input buffer without blocking.
+ * @return the number of bytes read.
+ */
+int32_t USB_USART_Receive_Buffer(uint8_t *buffer, uint32_t size);
+
 /**
  * Sends data to the USB serial.
  * @param Data      The data to write.
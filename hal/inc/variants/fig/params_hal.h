@@ -122,6 +122,9 @@ int HAL_PARAMS_Set_System_http_domain(const char* buffer);
 int HAL_PARAMS_Get_System_http_port(void);
 int HAL_PARAMS_Set_System_http_port(int port);
 
+uint16_t HAL_PARAMS_Get_System_ota_checkpoint(void* buffer, uint16_t len);
+int HAL_PARAMS_Set_System_ota_checkpoint(const void* buffer, uint16_t len);
+
 #ifdef __cplusplus
 }
 #endif
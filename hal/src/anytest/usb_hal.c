@@ -119,6 +119,17 @@ int32_t USB_USART_Receive_Data(uint8_t peek)
     return -1;
 }
 
+/*******************************************************************************
+ * Function Name  : USB_USART_Receive_Buffer.
+ * Description    : Read up to size bytes sent by USB Host.
+ * Input          : buffer, size.
+ * Return         : Number of bytes read.
+ *******************************************************************************/
+int32_t USB_USART_Receive_Buffer(uint8_t *buffer, uint32_t size)
+{
+    return sdkGetQueueBuffer(&USB_Rx_Queue, buffer, size);
+}
+
 /*******************************************************************************
  * Function Name  : USB_USART_Available_Data_For_Write.
  * Description    : Return the length of available space in TX buffer
@@ -248,15 +248,7 @@ int OpenwrtConnClass::socketReadable(int socket)
         {
             uint8_t cmd[] = {'K', (uint8_t)_sockets[socket].handle, sizeof(buffer)};
             int len = bridge.transfer(cmd, 3, buffer, sizeof(buffer));
-            int n=0;
-            for(n=0; n < len ; n++) {
-                if (_sockets[socket].pipe->writeable()) {
-                    _sockets[socket].pipe->putc(buffer[n]);
-                }
-                else{
-                    break;
-                }
-            }
+            int n = (len > 0) ? _sockets[socket].pipe->put((const char*)buffer, len) : 0;
             _sockets[socket].pending += n;
         }
         pending = _sockets[socket].pending;
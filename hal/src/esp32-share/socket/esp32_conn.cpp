@@ -355,14 +355,7 @@ int Esp32ConnClass::socketReadable(int socket)
             _sockets[socket].remote_port = si_other.sa_data[0]<<8 | si_other.sa_data[1];
             _sockets[socket].remote_ip = IPADR(si_other.sa_data[2], si_other.sa_data[3], si_other.sa_data[4], si_other.sa_data[5]);
             HALSOCKET_DEBUG("OK! socket:%d rev data, remote_ip:" IPSTR ", port:%d, len:%d!\r\n", socket, IPNUM(_sockets[socket].remote_ip), _sockets[socket].remote_port, res);
-            int n=0;
-            for(n=0; n < res ; n++) {
-                if (_sockets[socket].pipe->writeable()) {
-                    _sockets[socket].pipe->putc(buffer[n]);
-                } else {
-                    break;
-                }
-            }
+            int n = _sockets[socket].pipe->put((const char*)buffer, res);
             _sockets[socket].pending += n;
         }
     }
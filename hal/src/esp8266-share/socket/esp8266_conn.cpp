@@ -553,13 +553,7 @@ void Esp8266ConnClass::_espconn_recv_callback(void *arg, char *pusrdata, unsigne
     }
     if (NUMSOCKETS != socket) {
         HALSOCKET_DEBUG("Socket %d: has %d bytes pending\r\n", socket, len);
-        for(n=0; n < len ; n++) {
-            if (_sockets[socket].pipe->writeable()) {
-                _sockets[socket].pipe->putc(pusrdata[n]);
-            } else {
-                break;
-            }
-        }
+        n = _sockets[socket].pipe->put(pusrdata, len);
         _sockets[socket].pending += n;
         //UDP 获取remote_ip 和 remote_port
         if(MDM_IPPROTO_UDP == _sockets[socket].ipproto) {
@@ -666,14 +660,7 @@ void Esp8266ConnClass::_espconn_tcp_server_recv_callback(void *arg, char *pusrda
                 HALSOCKET_DEBUG("remote_port:%d\r\n", pespconn->proto.tcp->remote_port);
                 int handle = _sockets[socket].server_client_list[i].handle;
                 HALSOCKET_DEBUG("Socket %d: has %d bytes pending\r\n", handle, len);
-                int n = 0;
-                for(n=0; n < len ; n++) {
-                    if (_sockets[handle].pipe->writeable()) {
-                        _sockets[handle].pipe->putc(pusrdata[n]);
-                    } else {
-                        break;
-                    }
-                }
+                int n = _sockets[handle].pipe->put(pusrdata, len);
                 _sockets[handle].pending += n;
                 break;
             }
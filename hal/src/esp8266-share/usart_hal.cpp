@@ -186,6 +186,12 @@ uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data)
     return 1;
 }
 
+int32_t HAL_USART_Write_Buffer(HAL_USART_Serial serial, const uint8_t *buffer, uint32_t size)
+{
+    uartWriteBuf(usartMap[serial]->usart, buffer, size);
+    return size;
+}
+
 uint32_t HAL_USART_Write_NineBitData(HAL_USART_Serial serial, uint16_t data)
 {
     uartWriteBuf(usartMap[serial]->usart, (uint8_t *)&data, 2);
@@ -215,6 +221,17 @@ int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
     return -1;
 }
 
+int32_t HAL_USART_Read_Buffer(HAL_USART_Serial serial, uint8_t *buffer, uint32_t size)
+{
+    uint32_t n = 0;
+
+    while((n < size) && uartAvailable(usartMap[serial]->usart))
+    {
+        buffer[n++] = uartRead(usartMap[serial]->usart);
+    }
+    return n;
+}
+
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 {
     if (HAL_USART_Available_Data(serial)) {
@@ -198,6 +198,16 @@ uint32_t HAL_OTA_FlashLength()
     return CACHE_ONLINE_APP_SEC_NUM * SPI_FLASH_SEC_SIZE;
 }
 
+uint32_t HAL_APP_FlashAddress()
+{
+    return APP_START_ADDR;
+}
+
+uint32_t HAL_APP_FlashLength()
+{
+    return APP_SEC_NUM * SPI_FLASH_SEC_SIZE;
+}
+
 uint16_t HAL_OTA_ChunkSize()
 {
     return OTA_CHUNK_SIZE;
@@ -234,8 +244,27 @@ int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length,
     return FLASH_Update(pBuffer, address, length);
 }
 
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length)
+{
+    return FLASH_ReadMemory(FLASH_SERIAL, address, (uint32_t *)pBuffer, length) ? 0 : -1;
+}
+
 hal_update_complete_t HAL_FLASH_End(void)
 {
     return HAL_UPDATE_ERROR;
 }
 
+bool HAL_OTA_Get_Checkpoint(void* data, uint32_t length)
+{
+    return HAL_PARAMS_Get_System_ota_checkpoint(data, length) == length;
+}
+
+bool HAL_OTA_Set_Checkpoint(const void* data, uint32_t length)
+{
+    if (HAL_PARAMS_Set_System_ota_checkpoint(data, length)) {
+        return false;
+    }
+    HAL_PARAMS_Save_Params();
+    return true;
+}
+
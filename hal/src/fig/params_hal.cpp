@@ -574,3 +574,29 @@ int HAL_PARAMS_Set_System_http_port(int port) {
     return 0;
 }
 
+/*
+ * 读取在线升级断点记录
+ * */
+uint16_t HAL_PARAMS_Get_System_ota_checkpoint(void* buffer, uint16_t len) {
+    uint16_t templen = MIN(sizeof(intorobot_system_params.ota_checkpoint), len);
+
+    if (buffer!=NULL) {
+        memcpy(buffer, intorobot_system_params.ota_checkpoint, templen);
+        return templen;
+    }
+    return 0;
+}
+
+/*
+ * 设置在线升级断点记录 buffer为NULL时清除记录
+ * */
+int HAL_PARAMS_Set_System_ota_checkpoint(const void* buffer, uint16_t len) {
+    if (len > sizeof(intorobot_system_params.ota_checkpoint)) {
+        return -1;
+    }
+    memset(intorobot_system_params.ota_checkpoint, 0, sizeof(intorobot_system_params.ota_checkpoint));
+    if (buffer!=NULL) {
+        memcpy(intorobot_system_params.ota_checkpoint, buffer, len);
+    }
+    return 0;
+}
@@ -65,8 +65,9 @@ typedef struct
     char     reserve3[52];         // 预留区
     char     http_domain[52];      // http服务器域名
     int      http_port;            // http服务器端口
+    uint8_t  ota_checkpoint[160];  // 在线升级断点记录, 内容由升级程序解释
 
-    uint8_t  reserve[491];         // 参数预留区 每添加一个参数，预留区大小减1
+    uint8_t  reserve[331];         // 参数预留区 每添加一个参数，预留区大小减1
     uint8_t  end;
 }hal_system_params_t;
 
@@ -96,7 +96,7 @@ public:
     */
     int free(void)
     {
-        int s = _r - _w;
+        int s = _load(_r) - _w;
         if (s <= 0)
             s += _s;
         return s - 1;
@@ -108,13 +108,12 @@ public:
     */
     T putc(T c)
     {
-        int i = _w;
-        int j = i;
-        i = _inc(i);
-        while (i == _r) // = !writeable()
+        int w = _w;
+        int i = _inc(w);
+        while (i == _load(_r)) // = !writeable()
             /* nothing / just wait */;
-        _b[j] = c;
-        _w = i;
+        _b[w] = c;
+        _store(_w, i);
         return c;
     }
 
@@ -133,18 +132,21 @@ public:
             for (;;) // wait for space
             {
                 f = free();
-                if (f > 0) break;     // data avail
+                if (f > 0) break;     // space avail
                 if (!t) return n - c; // no more space and not blocking
                 /* nothing / just wait */;
             }
-            // check free space
             if (c < f) f = c;
             int w = _w;
             int m = _s - w;
-            // check wrap
-            if (f > m) f = m;
-            memcpy(&_b[w], p, f);
-            _w = _inc(w, f);
+            // at most two copies, up to the end of the buffer and from its start
+            if (f > m) {
+                memcpy(&_b[w], p, m * sizeof(T));
+                memcpy(_b, p + m, (f - m) * sizeof(T));
+            } else {
+                memcpy(&_b[w], p, f * sizeof(T));
+            }
+            _store(_w, _inc(w, f));
             c -= f;
             p += f;
         }
@@ -159,7 +161,7 @@ public:
     */
     bool readable(void)
     {
-        return (_r != _w);
+        return (_r != _load(_w));
     }
 
     /** Get the number of values available in the buffer
@@ -167,7 +169,7 @@ public:
     */
     int size(void)
     {
-        int s = _w - _r;
+        int s = _load(_w) - _r;
         if (s < 0)
             s += _s;
         return s;
@@ -179,10 +181,10 @@ public:
     T getc(void)
     {
         int r = _r;
-        while (r == _w) // = !readable()
+        while (r == _load(_w)) // = !readable()
             /* nothing / just wait */;
         T t = _b[r];
-        _r = _inc(r);
+        _store(_r, _inc(r));
         return t;
     }
 
@@ -201,24 +203,81 @@ public:
             for (;;) // wait for data
             {
                 f = size();
-                if (f)  break;        // free space
-                if (!t) return n - c; // no space and not blocking
+                if (f)  break;        // data avail
+                if (!t) return n - c; // no data and not blocking
                 /* nothing / just wait */;
             }
-            // check available data
             if (c < f) f = c;
             int r = _r;
             int m = _s - r;
-            // check wrap
-            if (f > m) f = m;
-            memcpy(p, &_b[r], f);
-            _r = _inc(r, f);
+            // at most two copies, up to the end of the buffer and from its start
+            if (f > m) {
+                memcpy(p, &_b[r], m * sizeof(T));
+                memcpy(p + m, _b, (f - m) * sizeof(T));
+            } else {
+                memcpy(p, &_b[r], f * sizeof(T));
+            }
+            _store(_r, _inc(r, f));
             c -= f;
             p += f;
         }
         return n - c;
     }
 
+    /** move elements into another pipe, those it has no room for are dropped
+        \param p the pipe receiving the elements, NULL to drop them all
+        \param n the number elements to take from this pipe
+        \return number elements put into p
+    */
+    int move(Pipe<T>* p, int n)
+    {
+        int c = size();
+        if (n > c) n = c;
+        int f = p ? p->free() : 0;
+        int k = 0;
+        while (n)
+        {
+            const T* s = NULL;
+            int m = peek(&s);
+            if (m > n) m = n;
+            if (k < f) k += p->put(s, (m < f - k) ? m : f - k);
+            skip(m);
+            n -= m;
+        }
+        return k;
+    }
+
+    /** get the available elements in place, without copying them. The
+        elements stay in the pipe until they are consumed with skip().
+        \param p set to the first element
+        \param ix the number of elements to look past the read index
+        \return the number of elements stored in a row at p, the rest
+                 (if any) follows at the start of the buffer
+    */
+    int peek(const T** p, int ix = 0)
+    {
+        int sz = size();
+        if (ix >= sz)
+            return 0;
+        int o = _inc(_r, ix);
+        int m = _s - o;
+        sz -= ix;
+        *p = &_b[o];
+        return (sz < m) ? sz : m;
+    }
+
+    /** consume elements, i.e. those inspected with peek()
+        \param n the number elements to drop
+        \return number elements dropped
+    */
+    int skip(int n)
+    {
+        int sz = size();
+        if (n > sz) n = sz;
+        _store(_r, _inc(_r, n));
+        return n;
+    }
+
     // the following functions are useful if you like to inspect
     // or parse the buffer in the reading thread/context
     // --------------------------------------------------------
@@ -251,7 +310,7 @@ public:
     */
     void done(void)
     {
-        _r = _o;
+        _store(_r, _o);
     }
 
 private:
@@ -268,11 +327,26 @@ private:
         return i;
     }
 
+    /** read an index owned by the other context, the elements it
+        covers are visible once it is read
+    */
+    static inline int _load(const volatile int& i)
+    {
+        return __atomic_load_n(&i, __ATOMIC_ACQUIRE);
+    }
+
+    /** publish an index to the other context, after the elements it covers
+    */
+    static inline void _store(volatile int& i, int v)
+    {
+        __atomic_store_n(&i, v, __ATOMIC_RELEASE);
+    }
+
     T*            _b; //!< buffer
     T*            _a; //!< allocated buffer
     int           _s; //!< size of buffer (s - 1) elements can be stored
-    volatile int  _w; //!< write index
-    volatile int  _r; //!< read index
+    volatile int  _w; //!< write index, changed by the writing context only
+    volatile int  _r; //!< read index, changed by the reading context only
     int           _o; //!< offest index used by parsing functions
 };
 
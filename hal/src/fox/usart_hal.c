@@ -209,6 +209,12 @@ uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data)
     return 1;
 }
 
+int32_t HAL_USART_Write_Buffer(HAL_USART_Serial serial, const uint8_t *buffer, uint32_t size)
+{
+    HAL_UART_Transmit(usartMap[serial]->uart_handle, (uint8_t *)buffer, size, 100);
+    return size;
+}
+
 uint32_t HAL_USART_Write_NineBitData(HAL_USART_Serial serial, uint16_t data)
 {
     HAL_UART_Transmit(usartMap[serial]->uart_handle, (uint8_t *)&data, 2, 100);//100ms
@@ -237,6 +243,11 @@ int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
     return -1;
 }
 
+int32_t HAL_USART_Read_Buffer(HAL_USART_Serial serial, uint8_t *buffer, uint32_t size)
+{
+    return sdkGetQueueBuffer(usartMap[serial]->usart_rx_queue, buffer, size);
+}
+
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 {
     uint8_t data;
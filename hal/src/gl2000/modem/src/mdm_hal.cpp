@@ -55,6 +55,32 @@ extern "C"
 
 /* Private typedef ----------------------------------------------------------*/
 
+// ids of the responses whose parsed fields are used, see _token
+enum {
+    TOKEN_NONE = 0,
+    TOKEN_IPD,
+    TOKEN_DOWNFILE,
+    TOKEN_NETDOWN,
+};
+
+// states of a candidate match in _getLine, those from MATCH_DATA on can no longer fail
+enum {
+    MATCH_FMT = 0,
+    MATCH_NUMBER,
+    MATCH_NEGATIVE,
+    MATCH_DATA,
+    MATCH_ANY,
+    MATCH_END,
+    MATCH_DONE,
+};
+
+// states of the queued write in progress
+enum {
+    TX_IDLE = 0,
+    TX_PROMPT,          // AT+CIPSEND sent, waiting for the prompt
+    TX_SENDOK,          // data sent, waiting for SEND OK
+};
+
 /* Private define -----------------------------------------------------------*/
 /* Private macro ------------------------------------------------------------*/
 #define ESP8266_EN_GPIO_PIN             GPIO_PIN_9
@@ -66,7 +92,8 @@ extern "C"
 
 #define PROFILE         "0"   //!< this is the psd profile used
 #define MAX_SIZE        2048  //!< max expected messages (used with RX)
-#define USO_MAX_WRITE   1024  //!< maximum number of bytes to write to socket (used with TX)
+#define USO_MAX_WRITE   2048  //!< maximum number of bytes of one AT+CIPSEND (used with TX)
+#define USO_TX_TIMEOUT  10000 //!< time for the module to take a block (used with TX)
 // num sockets
 #define NUMSOCKETS      ((int)(sizeof(_sockets)/sizeof(*_sockets)))
 //! test if it is a socket is ok to use
@@ -146,6 +173,14 @@ MDMParser::MDMParser(void)
     _aplistindex = 0;
 
     _cancel_all_operations = false;
+    memset(&_token, 0, sizeof(_token));
+    _matchReset();
+    _txSegs = 0;
+    _txUsed = 0;
+    _txBlockSegs = 0;
+    _txBlock = 0;
+    _txState = TX_IDLE;
+    _txTime = 0;
     memset(_sockets, 0, sizeof(_sockets));
     for (int socket = 0; socket < NUMSOCKETS; socket ++)
         _sockets[socket].handle = MDM_SOCKET_ERROR;
@@ -179,6 +214,7 @@ int MDMParser::send(const char* buf, int len)
 int MDMParser::sendFormated(const char* format, ...) {
     if (_cancel_all_operations) return 0;
 
+    _txFlush();
     char buf[MAX_SIZE];
     va_list args;
     va_start(args, format);
@@ -221,33 +257,24 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
             /*******************************************/
             //handle unsolicited commands here
             if (type == TYPE_PLUS) {
-                const char* cmd = buf+1;
-                int sz, p, a,b,c,d;
-                int n;
-                char *s;
+                int a;
 
                 // Socket Specific Command ---------------------------------
                 // +IPD, <socket>,<length>,<remote IP>,<remote port>
-                if ((sscanf(cmd, "IPD,%d,%d," IPSTR ",%d", &sk, &sz, &a, &b, &c, &d, &p) == 7)) {
+                if (_token.id == TOKEN_IPD) {
+                    sk = _token.field[0];
                     socket = _findSocket(sk);
-                    MDM_DEBUG_D("Socket %d: handle %d has %d bytes pending!\r\n", socket, sk, sz);
+                    MDM_DEBUG_D("Socket %d: handle %d has %d bytes pending!\r\n", socket, sk, _token.field[1]);
                     if (socket != MDM_SOCKET_ERROR) {
-                        s = strchr(buf, ':');
-                        for(n=0; n < sz; n++) {
-                            if (_sockets[socket].pipe->writeable()) {
-                                _sockets[socket].pipe->putc(s[n+1]);
-                            }
-                            else{
-                                break;
-                            }
-                        }
-                        _sockets[socket].pending += n;
-                        _sockets[socket].remoteip = IPADR(a,b,c,d);
-                        _sockets[socket].remoteport = p;
+                        _sockets[socket].remoteip = IPADR(_token.field[2], _token.field[3], _token.field[4], _token.field[5]);
+                        _sockets[socket].remoteport = _token.field[6];
                     }
+                    // the payload follows in the pipe, _getLine moves it into the socket
+                    _dataSocket = socket;
                     // down file ---------------------------------
                     // IR_DOWNFILE:<result>
-                } else if ((sscanf(cmd, "IR_DOWNFILE:%d", &a) == 1)) {
+                } else if (_token.id == TOKEN_DOWNFILE) {
+                    a = _token.field[0];
                     //AT设计的有问题   下载中返回结果后面多了一个ok. 特殊处理  去掉后面的Ok
                     if(_downotafile_status == DEALSTATUS_DOING) {
                         char temp[16];
@@ -258,7 +285,8 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                     else
                         _downotafile_status = DEALSTATUS_FAIL;
                     // IR_DOWNFILE:<result>
-                } else if ((sscanf(cmd, "IR_NETDOWN:%d", &a) == 1)) {
+                } else if (_token.id == TOKEN_NETDOWN) {
+                    a = _token.field[0];
                     //AT设计的有问题   下载中返回结果后面多了一个ok. 特殊处理  去掉后面的Ok
                     if(_downnetfile_status == DEALSTATUS_DOING) {
                         char temp[16];
@@ -274,11 +302,9 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                 _smartconfig_status = DEALSTATUS_SUCCESS;
             }
             else if (type == TYPE_CONNECTCLOSTED) {
-                if ((sscanf(buf, "%d", &sk) == 1)) {
-                    socket = _findSocket(sk);
-                    if (socket != MDM_SOCKET_ERROR) {
-                        _sockets[socket].connected = 0;
-                    }
+                socket = _findSocket(_token.field[0]);
+                if (socket != MDM_SOCKET_ERROR) {
+                    _sockets[socket].connected = 0;
                 }
             }
             else if (type == TYPE_CONNECT) {
@@ -291,6 +317,9 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                 HAL_NET_notify_disconnected();
             }
             /*******************************************/
+            // a queued write goes on alongside, its responses are not for the caller
+            if (_txBlockSegs && _txResponse(type))
+                continue;
             if (cb) {
                 int len = LENGTH(ret);
                 int ret = cb(type, buf, len, param);
@@ -861,6 +890,7 @@ int MDMParser::socketCreate(IpProtocol ipproto, int port)
         _sockets[socket].connected  = false;
         _sockets[socket].pending    = 0;
         _sockets[socket].open       = true;
+        _sockets[socket].txFailed   = false;
         _sockets[socket].pipe = new Pipe<char>(MAX_SIZE);
     }
     //MDM_DEBUG_D("socketCreate(%s)", (ipproto?"UDP":"TCP"));
@@ -905,7 +935,7 @@ bool MDMParser::socketIsConnected(int socket)
 {
     bool ok = false;
     LOCK();
-    ok = ISSOCKET(socket) && _sockets[socket].connected;
+    ok = ISSOCKET(socket) && _sockets[socket].connected && !_socketTxFailed(socket);
     //MDM_DEBUG_D("socketIsConnected(%d) %s", socket, ok?"yes":"no");
     UNLOCK();
     return ok;
@@ -945,6 +975,7 @@ bool MDMParser::_socketFree(int socket)
             _sockets[socket].connected  = false;
             _sockets[socket].pending    = 0;
             _sockets[socket].open       = false;
+            _sockets[socket].txFailed   = false;
             if (_sockets[socket].pipe)
                 delete _sockets[socket].pipe;
         }
@@ -964,71 +995,200 @@ bool MDMParser::socketFree(int socket)
 int MDMParser::socketSend(int socket, const char * buf, int len)
 {
     //MDM_DEBUG_D("socketSend(%d,%d)", socket,len);
-    int cnt = len;
-    while (cnt > 0) {
-        int blk = USO_MAX_WRITE;
-        if (cnt < blk)
-            blk = cnt;
-        bool ok = false;
-        {
-            LOCK();
-            if (ISSOCKET(socket)) {
-                sendFormated("AT+CIPSEND=%d,%d\r\n",_sockets[socket].handle,blk);
-                if (RESP_OK == waitFinalResp()){
-                    if (RESP_PROMPT == waitFinalResp()) {
-                        send(buf, blk);
-                        if (RESP_OK == waitFinalResp())
-                            ok = true;
-                    }
-                }
-            }
-            UNLOCK();
-        }
-        if (!ok)
+    int cnt = 0;
+    while (cnt < len) {
+        // an earlier write of the socket failed after it was queued
+        if (_socketTxFailed(socket))
+            return MDM_SOCKET_ERROR;
+        int n = socketSendAsync(socket, buf + cnt, len - cnt);
+        if (n < 0)
             return MDM_SOCKET_ERROR;
-        buf += blk;
-        cnt -= blk;
+        cnt += n;
+        // the queue is full, let the block in progress go out
+        if (cnt < len)
+            waitFinalResp(NULL, NULL, 0);
     }
-    return (len - cnt);
+    return cnt;
 }
 
 int MDMParser::socketSendTo(int socket, MDM_IP ip, int port, const char * buf, int len)
 {
     //MDM_DEBUG_D("socketSendTo(%d," IPSTR ",%d,,%d)", socket,IPNUM(ip),port,len);
-    int cnt = len;
-    while (cnt > 0) {
-        int blk = USO_MAX_WRITE;
-        if (cnt < blk)
-            blk = cnt;
-        bool ok = false;
-        {
-            LOCK();
-            if (ISSOCKET(socket)) {
-                sendFormated("AT+CIPSEND=%d,%d,\"" IPSTR "\",%d\r\n",_sockets[socket].handle, blk, IPNUM(ip),port);
-                if (RESP_OK == waitFinalResp()){
-                    if (RESP_PROMPT == waitFinalResp()) {
-                        send(buf, blk);
-                        if (RESP_OK == waitFinalResp())
-                            ok = true;
-                    }
-                }
-            }
-            UNLOCK();
-        }
-        if (!ok)
+    int cnt = 0;
+    while (cnt < len) {
+        // an earlier write of the socket failed after it was queued
+        if (_socketTxFailed(socket))
+            return MDM_SOCKET_ERROR;
+        int n = socketSendToAsync(socket, ip, port, buf + cnt, len - cnt);
+        if (n < 0)
             return MDM_SOCKET_ERROR;
-        buf += blk;
-        cnt -= blk;
+        cnt += n;
+        if (cnt < len)
+            waitFinalResp(NULL, NULL, 0);
+    }
+    return cnt;
+}
+
+int MDMParser::socketSendAsync(int socket, const char * buf, int len,
+                               _SENDCBPTR cb /* = NULL*/, void* param /* = NULL*/)
+{
+    return _txQueue(socket, NOIP, 0, buf, len, cb, param);
+}
+
+int MDMParser::socketSendToAsync(int socket, MDM_IP ip, int port, const char * buf, int len,
+                                 _SENDCBPTR cb /* = NULL*/, void* param /* = NULL*/)
+{
+    return _txQueue(socket, ip, port, buf, len, cb, param);
+}
+
+int MDMParser::_txQueue(int socket, MDM_IP ip, int port, const char* buf, int len,
+                        _SENDCBPTR cb, void* param)
+{
+    int n = MDM_SOCKET_ERROR;
+    LOCK();
+    if (ISSOCKET(socket) && !_cancel_all_operations) {
+        _txPoll();
+        n = MDM_TX_SIZE - _txUsed;
+        if (len < n)
+            n = len;
+        TxSegment* s = _txSegs ? &_txSeg[_txSegs - 1] : NULL;
+        if (n <= 0) {
+            n = 0;
+        } else if (s && (_txSegs > _txBlockSegs) && !s->cb && !cb && (s->socket == socket)
+                && (s->ip == ip) && (s->port == port) && (s->len < USO_MAX_WRITE)) {
+            // small writes add up in the last segment not yet being written
+            if (n > USO_MAX_WRITE - s->len)
+                n = USO_MAX_WRITE - s->len;
+            s->len += n;
+        } else if (_txSegs < MDM_TX_SEGMENTS) {
+            if (n > USO_MAX_WRITE)
+                n = USO_MAX_WRITE;
+            s = &_txSeg[_txSegs ++];
+            s->socket = socket;
+            s->ip     = ip;
+            s->port   = port;
+            s->len    = n;
+            s->cb     = cb;
+            s->param  = param;
+        } else {
+            n = 0;
+        }
+        memcpy(_txBuf + _txUsed, buf, n);
+        _txUsed += n;
+        _txPoll();
+    }
+    UNLOCK();
+    return n;
+}
+
+void MDMParser::_txPoll(void)
+{
+    LOCK();
+    if (_txBlockSegs && (_cancel_all_operations || TIMEOUT(_txTime, USO_TX_TIMEOUT))) {
+        MDM_DEBUG_D("socket write of %d bytes failed\r\n", _txBlock);
+        _txDone(MDM_SOCKET_ERROR);
+    }
+    if (_cancel_all_operations && _txSegs) {
+        _txBlockSegs = _txSegs;
+        _txBlock = _txUsed;
+        _txDone(MDM_SOCKET_ERROR);
+    }
+    while (!_txBlockSegs && _txSegs) {
+        // one AT+CIPSEND takes the following segments with the same destination
+        const TxSegment& s = _txSeg[0];
+        _txBlockSegs = 1;
+        _txBlock = s.len;
+        while ((_txBlockSegs < _txSegs)
+                && (_txSeg[_txBlockSegs].socket == s.socket)
+                && (_txSeg[_txBlockSegs].ip == s.ip)
+                && (_txSeg[_txBlockSegs].port == s.port)
+                && (_txBlock + _txSeg[_txBlockSegs].len <= USO_MAX_WRITE)) {
+            _txBlock += _txSeg[_txBlockSegs ++].len;
+        }
+        if (!ISSOCKET(s.socket)) {
+            _txDone(MDM_SOCKET_ERROR);
+            continue;
+        }
+        char cmd[64];
+        int len;
+        if (s.ip == NOIP)
+            len = snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d,%d\r\n", _sockets[s.socket].handle, _txBlock);
+        else
+            len = snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d,%d,\"" IPSTR "\",%d\r\n",
+                    _sockets[s.socket].handle, _txBlock, IPNUM(s.ip), s.port);
+        _txState = TX_PROMPT;
+        _txTime = HAL_Timer_Get_Milli_Seconds();
+        send(cmd, len);
+    }
+    UNLOCK();
+}
+
+bool MDMParser::_txResponse(int type)
+{
+    if (type == TYPE_PROMPT) {
+        if (_txState != TX_PROMPT)
+            return false;
+        // the data follows the prompt at once, without waiting for the caller
+        send(_txBuf, _txBlock);
+        _txState = TX_SENDOK;
+        _txTime = HAL_Timer_Get_Milli_Seconds();
+        return true;
+    }
+    if (type == TYPE_OK) {
+        // AT+CIPSEND answers OK before the prompt
+        if (_txState == TX_PROMPT)
+            return true;
+        _txDone(_txBlock);
+    } else if ((type == TYPE_ERROR) || (type == TYPE_FAIL)) {
+        _txDone(MDM_SOCKET_ERROR);
+    } else {
+        return false;
     }
-    return (len - cnt);
+    _txPoll();
+    return true;
+}
+
+void MDMParser::_txDone(int sent)
+{
+    TxSegment done[MDM_TX_SEGMENTS];
+    int n = _txBlockSegs;
+    memcpy(done, _txSeg, n * sizeof(*_txSeg));
+    _txSegs -= n;
+    _txUsed -= _txBlock;
+    memmove(_txSeg, _txSeg + n, _txSegs * sizeof(*_txSeg));
+    memmove(_txBuf, _txBuf + _txBlock, _txUsed);
+    _txBlockSegs = 0;
+    _txBlock = 0;
+    _txState = TX_IDLE;
+    // report last, the callbacks may queue more data
+    for (int i = 0; i < n; i ++) {
+        if (done[i].cb)
+            done[i].cb(done[i].socket, (sent < 0) ? MDM_SOCKET_ERROR : done[i].len, done[i].param);
+        else if ((sent < 0) && ISSOCKET(done[i].socket))
+            _sockets[done[i].socket].txFailed = true;
+    }
+}
+
+void MDMParser::_txFlush(void)
+{
+    LOCK();
+    while (_txSegs && !_cancel_all_operations) {
+        _txPoll();
+        waitFinalResp(NULL, NULL, 0);
+    }
+    _txPoll();
+    UNLOCK();
 }
 
 int MDMParser::socketReadable(int socket)
 {
+    _txPoll();
     waitFinalResp(NULL, NULL, 0);
     int pending = MDM_SOCKET_ERROR;
     if (_cancel_all_operations)
         return MDM_SOCKET_ERROR;
+    if (_socketTxFailed(socket))
+        return MDM_SOCKET_ERROR;
 
     if (ISSOCKET(socket)) {
         // allow to receive unsolicited commands
@@ -1083,6 +1243,21 @@ int MDMParser::socketRecvFrom(int socket, MDM_IP* ip, int* port, char* buf, int
     return 0;
 }
 
+// Reports a write that failed after socketSend returned. A stream missing
+// some of its data stays failed, a datagram socket is reported once.
+bool MDMParser::_socketTxFailed(int socket)
+{
+    bool failed = false;
+    LOCK();
+    if (ISSOCKET(socket) && _sockets[socket].txFailed) {
+        failed = true;
+        if (_sockets[socket].ipproto == MDM_IPPROTO_UDP)
+            _sockets[socket].txFailed = false;
+    }
+    UNLOCK();
+    return failed;
+}
+
 int MDMParser::_findSocket(int handle) {
     for (int socket = 0; socket < NUMSOCKETS; socket ++) {
         if (_sockets[socket].handle == handle)
@@ -1225,7 +1400,7 @@ int MDMParser::_cbGetBootloaderPacket(int type, const char* buf, int len, uint8_
 
     if (type == TYPE_PLUS) {
         if (sscanf(buf, "+IR_GETFILEPACKET,%d\r\n", &size) == 1) {
-            char *s = strchr(buf, ':');
+            const char *s = strchr(buf, ':');
             for(int n=0; n < size; n++) {
                 memcpy(pdata, s+1, size);
             }
@@ -1265,144 +1440,255 @@ void MDMParser::dumpIp(MDM_IP ip)
 }
 
 // ----------------------------------------------------------------
-int MDMParser::_parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end)
-{
-    int o = 0;
-    if (sta) {
-        while (*sta) {
-            if (++o > len)                  return WAIT;
-            char ch = pipe->next();
-            if (*sta++ != ch)               return NOT_FOUND;
-        }
-    }
-    if (!end)                               return o; // no termination
-    // at least any char
-    if (++o > len)                      return WAIT;
-    pipe->next();
-    // check the end
-    int x = 0;
-    while (end[x]) {
-        if (++o > len)                      return WAIT;
-        char ch = pipe->next();
-        x = (end[x] == ch) ? x + 1 :
-            (end[0] == ch) ? 1 :
-            0;
-    }
-    return o;
-}
-
-int MDMParser::_parseFormated(Pipe<char>* pipe, int len, const char* fmt)
-{
-    int o = 0;
-    int num = 0;
-    if (fmt) {
-        while (*fmt) {
-            if (++o > len)                  return WAIT;
-            char ch = pipe->next();
-            if (*fmt == '%') {
-                fmt++;
-                if (*fmt == 'd') { // numeric
-                    fmt ++;
-                    while (ch >= '0' && ch <= '9') {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
+// response patterns, earlier entries win over later ones starting at the same byte
+// %d:表示正常数值   %n:表示数据长度   %c:表示数据
+// end: NULL if the format alone is the response, else the terminator following at least one more char
+static const struct {
+    const char* fmt;                                 const char* end;    int type;               int id;
+} mdmPatterns[] = {
+    { "%d,CLOSED\r\n",                               NULL,               TYPE_CONNECTCLOSTED,    TOKEN_NONE      },
+    { "+IPD,%d,%n," IPSTR ",%d:",                    NULL,               TYPE_PLUS,              TOKEN_IPD       },
+    { "+IR_GETFILEPACKET,%n:%c",                     NULL,               TYPE_PLUS,              TOKEN_NONE      },
+    { "+IR_DOWNFILE:%d\r\n",                         NULL,               TYPE_PLUS,              TOKEN_DOWNFILE  },
+    { "+IR_NETDOWN:%d\r\n",                          NULL,               TYPE_PLUS,              TOKEN_NETDOWN   },
+    { "\r\nOK\r\n",                                  NULL,               TYPE_OK,                TOKEN_NONE      },
+    { "\r\nERROR\r\n",                               NULL,               TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\nFAIL\r\n",                                NULL,               TYPE_FAIL,              TOKEN_NONE      },
+    { "\r\nALREAY CONNECT\r\n",                      NULL,               TYPE_CONNECT,           TOKEN_NONE      },
+    { "UNLINK\r\n",                                  NULL,               TYPE_UNLINK,            TOKEN_NONE      },
+    { "WIFI CONNECTED\r\n",                          NULL,               TYPE_CONNECT,           TOKEN_NONE      },
+    { "WIFI GOT IP\r\n",                             NULL,               TYPE_DHCP,              TOKEN_NONE      },
+    { "WIFI DISCONNECT\r\n",                         NULL,               TYPE_DISCONNECT,        TOKEN_NONE      },
+    { "\r\nbusy p...\r\n",                           NULL,               TYPE_BUSY,              TOKEN_NONE      },
+    { "smartconfig connected wifi\r\n",              NULL,               TYPE_SMARTCONFIG,       TOKEN_NONE      },
+    { "+",                                           "\r\n",             TYPE_PLUS,              TOKEN_NONE      },
+    { "> ",                                          NULL,               TYPE_PROMPT,            TOKEN_NONE      }, // Sockets
+    { "\r\nSEND OK\r\n",                             NULL,               TYPE_OK,                TOKEN_NONE      }, // Sockets
+    { "\r\nSEND FAIL\r\n",                           NULL,               TYPE_FAIL,              TOKEN_NONE      }, // Sockets
+    { "STATUS:",                                     "\r\nOK\r\n",       TYPE_OK,                TOKEN_NONE      }, // Sockets
+};
+
+bool MDMParser::_matchStep(MdmMatch& m, char ch)
+{
+    const char* fmt = mdmPatterns[m.pattern].fmt;
+    const char* end = mdmPatterns[m.pattern].end;
+    for (;;) {
+        switch (m.state) {
+            case MATCH_FMT:
+                if (fmt[m.pos] == '%') {
+                    if ((fmt[m.pos + 1] == 'd') || (fmt[m.pos + 1] == 'n')) { // numeric / data len
+                        m.num = 0;
+                        if ((ch == '-') && (m.pos > 0)) { // no pattern starts on a lone sign
+                            m.state = MATCH_NEGATIVE;
+                            return true;
+                        }
+                        m.state = MATCH_NUMBER;
+                        continue;
                     }
-                }
-                else if (*fmt == 'n') { // data len
-                    fmt ++;
-                    num = 0;
-                    while (ch >= '0' && ch <= '9') {
-                        num = num * 10 + (ch - '0');
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
+                    if (fmt[m.pos + 1] == 'c') { // char buffer (takes last %n as length)
+                        m.num = m.size ? m.field[m.size - 1] : 0;
+                        m.state = MATCH_DATA;
+                        continue;
                     }
                 }
-                else if (*fmt == 'c') { // char buffer (takes last numeric as length)
-                    fmt ++;
-                    while (--num) {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
-                    }
-                    continue;
+                if (fmt[m.pos] != ch)
+                    return false;
+                m.pos ++;
+                break;
+            case MATCH_NUMBER:
+            case MATCH_NEGATIVE:
+                if ((ch >= '0') && (ch <= '9')) {
+                    m.num = m.num * 10 + (ch - '0');
+                    return true;
                 }
-                else if (*fmt == 's') {
-                    fmt ++;
-                    if (ch != '\"')         return NOT_FOUND;
-                    do {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
-                    } while (ch != '\"');
-                    if (++o > len)          return WAIT;
-                    ch = pipe->next();
+                if (m.fields < MDM_TOKEN_FIELDS) {
+                    if (fmt[m.pos + 1] == 'n')
+                        m.size = m.fields + 1;
+                    m.field[m.fields ++] = (m.state == MATCH_NEGATIVE) ? -m.num : m.num;
                 }
-            }
-            if (*fmt++ != ch)               return NOT_FOUND;
+                m.pos += 2;
+                m.state = MATCH_FMT;
+                continue; // the byte after the number must match the format
+            case MATCH_DATA:
+                if ((m.num <= 0) || (-- m.num > 0))
+                    return true;
+                m.pos += 2;
+                m.state = MATCH_FMT;
+                break;
+            case MATCH_ANY: // at least any char
+                m.pos = 0;
+                m.state = MATCH_END;
+                return true;
+            case MATCH_END:
+                m.pos = (end[m.pos] == ch) ? m.pos + 1 :
+                        (end[0] == ch) ? 1 :
+                        0;
+                if (!end[m.pos])
+                    m.state = MATCH_DONE;
+                return true;
+            default:
+                return true;
         }
+        if (!fmt[m.pos])
+            m.state = end ? MATCH_ANY : MATCH_DONE;
+        return true;
+    }
+}
+
+void MDMParser::_matchReset(void)
+{
+    _matches = 0;
+    _scanned = 0;
+    _cut = -1;
+    _dataLeft = 0;
+}
+
+int MDMParser::_dataForward(Pipe<char>* pipe)
+{
+    int n = pipe->size();
+    if (n > _dataLeft)
+        n = _dataLeft;
+    _dataLeft -= n;
+    if (ISSOCKET(_dataSocket)) {
+        // what the socket has no room for is dropped
+        _sockets[_dataSocket].pending += pipe->move(_sockets[_dataSocket].pipe, n);
+    } else {
+        pipe->move(NULL, n);
+    }
+    return _dataLeft;
+}
+
+int MDMParser::_matchGet(Pipe<char>* pipe, char* buf, int len)
+{
+    len = pipe->get(buf, len);
+    int n = 0;
+    for (int i = 0; i < _matches; i ++) {
+        if (_match[i].start >= len) {
+            _match[n] = _match[i];
+            _match[n ++].start -= len;
+        }
+    }
+    _matches = n;
+    _scanned -= len;
+    if ((_cut < 0) || (_scanned == 0)) {
+        _cut = -1;
+        return len;
+    }
+    // candidates from the cut on may have been dropped, that is fine as long
+    // as a candidate that can not fail anymore still hides them, else scan again
+    _cut = (_cut > len) ? _cut - len : 0;
+    for (int i = 0; (i < _matches) && (_match[i].start <= _cut); i ++) {
+        if (_match[i].state >= MATCH_DATA)
+            return len;
     }
-    return o;
+    _matchReset();
+    return len;
 }
 
 int MDMParser::_getLine(Pipe<char>* pipe, char* buf, int len)
 {
-    int unkn = 0;
+    // the payload after a data header goes straight to its socket
+    if ((_dataLeft > 0) && (_dataForward(pipe) > 0))
+        return WAIT;
     int sz = pipe->size();
     int fr = pipe->free();
     if (len > sz)
         len = sz;
-    while (len > 0)
-    {
-        static struct {
-            const char* fmt;                              int type;
-        } lutF[] = {
-            { "%d,CLOSED\r\n",                       TYPE_CONNECTCLOSTED  },
-            // %d:表示正常数值   %n:表示数据长度   %c:表示数据
-            { "+IPD,%d,%n," IPSTR ",%d:%c",          TYPE_PLUS            },
-            { "+IR_GETFILEPACKET,%n:%c",             TYPE_PLUS            },
-        };
-        static struct {
-            const char* sta;          const char* end;    int type;
-        } lut[] = {
-            { "\r\nOK\r\n",                          NULL,               TYPE_OK            },
-            { "\r\nERROR\r\n",                       NULL,               TYPE_ERROR         },
-            { "\r\nFAIL\r\n",                        NULL,               TYPE_FAIL          },
-            { "\r\nALREAY CONNECT\r\n",              NULL,               TYPE_CONNECT       },
-            { "UNLINK\r\n",                          NULL,               TYPE_UNLINK        },
-            { "WIFI CONNECTED\r\n",                  NULL,               TYPE_CONNECT       },
-            { "WIFI GOT IP\r\n",                     NULL,               TYPE_DHCP          },
-            { "WIFI DISCONNECT\r\n",                 NULL,               TYPE_DISCONNECT    },
-            { "\r\nbusy p...\r\n",                   NULL,               TYPE_BUSY          },
-            { "smartconfig connected wifi\r\n",      NULL,               TYPE_SMARTCONFIG   },
-            { "+",                                   "\r\n",             TYPE_PLUS          },
-            { "> ",                                  NULL,               TYPE_PROMPT        }, // Sockets
-            { "\r\nSEND OK\r\n",                     NULL,               TYPE_OK            }, // Sockets
-            { "STATUS:",                             "\r\nOK\r\n",       TYPE_OK            }, // Sockets
-        };
-        for (int i = 0; i < (int)(sizeof(lutF)/sizeof(*lutF)); i ++) {
-            pipe->set(unkn);
-            int ln = _parseFormated(pipe, len, lutF[i].fmt);
-            if (ln == WAIT && fr)
-                return WAIT;
-            if ((ln != NOT_FOUND) && (unkn > 0))
-                return TYPE_UNKNOWN | pipe->get(buf, unkn);
-            if (ln > 0)
-                return lutF[i].type  | pipe->get(buf, ln);
+    _token.id = TOKEN_NONE;
+    // feed the bytes received since the last call, each one exactly once,
+    // reading them in place from the pipe
+    const char* span = NULL;
+    int spanLen = 0;
+    while ((_scanned < len) && ((_matches == 0) || (_match[0].state != MATCH_DONE))) {
+        if ((_matches == 1) && (_match[0].state == MATCH_DATA) && (_match[0].num > 1)) {
+            // nothing can start inside the data, skip all but its last byte
+            int skip = _match[0].num - 1;
+            if (skip > len - _scanned)
+                skip = len - _scanned;
+            if (_cut < 0)
+                _cut = _scanned;
+            _match[0].num -= skip;
+            _scanned += skip;
+            spanLen = 0;
+            continue;
+        }
+        if (spanLen == 0)
+            spanLen = pipe->peek(&span, _scanned);
+        char ch = *span ++;
+        spanLen --;
+        // a candidate that can no longer fail hides everything behind it
+        bool sure = false;
+        int n = 0;
+        for (int i = 0; i < _matches; i ++) {
+            MdmMatch& m = _match[i];
+            if (sure) {
+                if ((_cut < 0) || (m.start < _cut))
+                    _cut = m.start;
+                continue;
+            }
+            if (m.state != MATCH_DONE) {
+                if (!_matchStep(m, ch))
+                    continue;
+                if (m.state == MATCH_DONE)
+                    m.num = _scanned + 1 - m.start;
+            }
+            sure = (m.state >= MATCH_DATA);
+            if (n != i)
+                _match[n] = m;
+            n ++;
+        }
+        _matches = n;
+        for (int i = 0; (i < (int)(sizeof(mdmPatterns)/sizeof(*mdmPatterns))) && !(sure && (_cut >= 0)); i ++) {
+            MdmMatch m;
+            m.start = _scanned;
+            m.pattern = i;
+            m.state = MATCH_FMT;
+            m.pos = 0;
+            m.fields = 0;
+            m.size = 0;
+            if (!_matchStep(m, ch))
+                continue;
+            if (sure || (_matches == MDM_TOKEN_MATCHES)) {
+                // hidden or no room left, remember where it started
+                if ((_cut < 0) || (_scanned < _cut))
+                    _cut = _scanned;
+                break;
+            }
+            if (m.state == MATCH_DONE)
+                m.num = 1;
+            sure = (m.state >= MATCH_DATA);
+            _match[_matches ++] = m;
         }
-        for (int i = 0; i < (int)(sizeof(lut)/sizeof(*lut)); i ++) {
-            pipe->set(unkn);
-            int ln = _parseMatch(pipe, len, lut[i].sta, lut[i].end);
-            if (ln == WAIT && fr)
-                return WAIT;
-            if ((ln != NOT_FOUND) && (unkn > 0))
-                return TYPE_UNKNOWN | pipe->get(buf, unkn);
-            if (ln > 0)
-                return lut[i].type | pipe->get(buf, ln);
+        _scanned ++;
+    }
+    // the earliest candidate decides, in the order of the pattern table
+    while ((_matches > 0) && (_match[0].start < len)) {
+        const MdmMatch& m = _match[0];
+        bool done = (m.state == MATCH_DONE) && (m.start + m.num <= len);
+        if (!done && fr)
+            return WAIT;
+        if (m.start > 0)
+            return TYPE_UNKNOWN | _matchGet(pipe, buf, m.start);
+        if (done) {
+            int type = mdmPatterns[m.pattern].type;
+            int ln = m.num;
+            _token.id = mdmPatterns[m.pattern].id;
+            memcpy(_token.field, m.field, m.fields * sizeof(*m.field));
+            ln = _matchGet(pipe, buf, ln);
+            if (_token.id == TOKEN_IPD) {
+                // only the header is returned, _dataForward takes the payload
+                _matchReset();
+                _dataSocket = MDM_SOCKET_ERROR;
+                _dataLeft = _token.field[1];
+            }
+            return type | ln;
         }
-        // UNKNOWN
-        unkn ++;
-        len--;
+        // the pipe is full and this candidate can not complete, try the next
+        _matches --;
+        memmove(&_match[0], &_match[1], _matches * sizeof(*_match));
     }
-    return TYPE_UNKNOWN | pipe->get(buf, unkn); //应该返回TYPE_UNKNOWN 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直处理相同的数据  chenkaiyao  2016-01-09
-    //return WAIT;
+    len = (_scanned < len) ? _scanned : len;
+    return TYPE_UNKNOWN | _matchGet(pipe, buf, len); //应该返回TYPE_UNKNOWN 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直处理相同的数据  chenkaiyao  2016-01-09
 }
 
 // ----------------------------------------------------------------
@@ -23,9 +23,18 @@
 #include "usart_hal.h"
 #include "pinmap_impl.h"
 #include "sdkqueue.h"
+#include "interrupts_hal.h"
+
+
+#define USART_RX_DMA_BUFFER_SIZE        256
+#define USART_TX_QUEUE_SIZE             512
 
 UART_HandleTypeDef UartHandle_SERIAL1;
+DMA_HandleTypeDef DmaHandle_Rx_SERIAL1;
+DMA_HandleTypeDef DmaHandle_Tx_SERIAL1;
 SDK_QUEUE Usart_Rx_Queue_SERIAL1;
+SDK_QUEUE Usart_Tx_Queue_SERIAL1;
+static uint8_t Usart_Rx_Dma_Buffer_SERIAL1[USART_RX_DMA_BUFFER_SIZE];
 
 /* Private typedef -----------------------------------------------------------*/
 typedef enum USART_Num_Def {
@@ -41,13 +50,24 @@ typedef struct STM32_USART_Info {
     USART_TypeDef* usart_peripheral;
     uint32_t usart_alternate;
     int32_t usart_int_n;
+    DMA_Stream_TypeDef* usart_rx_dma_stream;
+    uint32_t usart_rx_dma_channel;
+    int32_t usart_rx_dma_int_n;
+    DMA_Stream_TypeDef* usart_tx_dma_stream;
+    uint32_t usart_tx_dma_channel;
+    int32_t usart_tx_dma_int_n;
     uint16_t usart_tx_pin;
     uint16_t usart_rx_pin;
 
     UART_HandleTypeDef *uart_handle;
+    DMA_HandleTypeDef *usart_rx_dma_handle;
+    DMA_HandleTypeDef *usart_tx_dma_handle;
     // Buffer pointers. These need to be global for IRQ handler access
     SDK_QUEUE *usart_tx_queue;
     SDK_QUEUE *usart_rx_queue;
+    uint8_t *usart_rx_dma_buffer;
+    uint16_t usart_rx_dma_tail;     // position in usart_rx_dma_buffer already moved to usart_rx_queue
+    uint16_t usart_tx_dma_len;      // bytes of usart_tx_queue the tx DMA is sending
 
     bool usart_enabled;
     bool usart_transmitting;
@@ -63,14 +83,21 @@ STM32_USART_Info USART_MAP[TOTAL_USARTS] =
      * gpio_peripheral (GPIOA, GPIOB, GPIOC or GPIOD)
      * Alternate;
      * interrupt number (USARTx_IRQn/UARTx_IRQn)
+     * RX DMA stream
+     * RX DMA channel
+     * RX DMA interrupt number (DMAx_Streamy_IRQn)
+     * TX DMA stream
+     * TX DMA channel
+     * TX DMA interrupt number (DMAx_Streamy_IRQn)
      * TX pin
      * RX pin
      * <tx_buffer pointer> used internally and does not appear below
      * <rx_buffer pointer> used internally and does not appear below
+     * <rx_dma_buffer pointer> used internally and does not appear below
      * <usart enabled> used internally and does not appear below
      * <usart transmitting> used internally and does not appear below
      */
-    { USART1, GPIO_AF7_USART1, USART1_IRQn, TX, RX },                                // USART 2
+    { USART1, GPIO_AF7_USART1, USART1_IRQn, DMA2_Stream2, DMA_CHANNEL_4, DMA2_Stream2_IRQn, DMA2_Stream7, DMA_CHANNEL_4, DMA2_Stream7_IRQn, TX, RX },                                // USART 2
 };
 
 static STM32_USART_Info *usartMap[TOTAL_USARTS]; // pointer to USART_MAP[] containing USART peripheral register locations (etc)
@@ -78,13 +105,150 @@ static STM32_USART_Info *usartMap[TOTAL_USARTS]; // pointer to USART_MAP[] conta
 /* Extern variables ----------------------------------------------------------*/
 
 /* Private function prototypes -----------------------------------------------*/
+/*
+ * Receive runs on a circular DMA into usart_rx_dma_buffer. Whatever the DMA has
+ * written since the last call is moved to the rx queue in at most two blocks,
+ * on the half transfer, transfer complete and line idle interrupts.
+ */
+static void HAL_USART_Rx_DMA_Drain(HAL_USART_Serial serial)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    uint16_t head = USART_RX_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(usart->usart_rx_dma_handle);
+    uint16_t tail = usart->usart_rx_dma_tail;
+
+    if(head == tail) {
+        return;
+    }
+    if(head > tail) {
+        sdkInsertQueue(usart->usart_rx_queue, &usart->usart_rx_dma_buffer[tail], head - tail);
+    } else {
+        sdkInsertQueue(usart->usart_rx_queue, &usart->usart_rx_dma_buffer[tail], USART_RX_DMA_BUFFER_SIZE - tail);
+        if(head) {
+            sdkInsertQueue(usart->usart_rx_queue, usart->usart_rx_dma_buffer, head);
+        }
+    }
+    usart->usart_rx_dma_tail = head;
+}
+
+static void HAL_USART_Rx_DMA_Start(HAL_USART_Serial serial, uint32_t priority)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    DMA_HandleTypeDef *hdma = usart->usart_rx_dma_handle;
+
+    hdma->Instance                 = usart->usart_rx_dma_stream;
+    hdma->Init.Channel             = usart->usart_rx_dma_channel;
+    hdma->Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma->Init.MemInc              = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma->Init.Mode                = DMA_CIRCULAR;
+    hdma->Init.Priority            = DMA_PRIORITY_HIGH;
+    hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_Init(hdma);
+    __HAL_LINKDMA(usart->uart_handle, hdmarx, *hdma);
+
+    // same priority as the USART interrupt so the two never preempt each other while draining
+    HAL_NVIC_SetPriority(usart->usart_rx_dma_int_n, priority, 0);
+    HAL_NVIC_EnableIRQ(usart->usart_rx_dma_int_n);
+
+    usart->usart_rx_dma_tail = 0;
+    HAL_UART_Receive_DMA(usart->uart_handle, usart->usart_rx_dma_buffer, USART_RX_DMA_BUFFER_SIZE);
+    __HAL_UART_ENABLE_IT(usart->uart_handle, UART_IT_IDLE);
+}
+
+static void HAL_USART_Rx_DMA_Stop(HAL_USART_Serial serial)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+
+    HAL_NVIC_DisableIRQ(usart->usart_rx_dma_int_n);
+    HAL_UART_DMAStop(usart->uart_handle);
+    HAL_DMA_DeInit(usart->usart_rx_dma_handle);
+}
+
+/*
+ * Transmit only copies into usart_tx_queue. The tx DMA sends the queue in
+ * place, one contiguous block at a time, and its transfer complete interrupt
+ * releases the block and starts the next one. Must run with the tx DMA
+ * interrupt masked or from that interrupt.
+ */
+static void HAL_USART_Tx_DMA_Next(HAL_USART_Serial serial)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    DMA_HandleTypeDef *hdma = usart->usart_tx_dma_handle;
+    uint8_t *data;
+    int32_t len;
+
+    if(usart->usart_transmitting) {
+        return;
+    }
+    len = sdkGetQueueSpan(usart->usart_tx_queue, &data);
+    if(len <= 0) {
+        return;
+    }
+    usart->usart_tx_dma_len = len;
+    usart->usart_transmitting = true;
+
+    __HAL_DMA_DISABLE(hdma);
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma)
+            | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_FE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma));
+    hdma->Instance->M0AR = (uint32_t)data;
+    hdma->Instance->NDTR = len;
+    __HAL_DMA_ENABLE(hdma);
+}
+
+static void HAL_USART_Tx_DMA_Start(HAL_USART_Serial serial, uint32_t priority)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    DMA_HandleTypeDef *hdma = usart->usart_tx_dma_handle;
+
+    hdma->Instance                 = usart->usart_tx_dma_stream;
+    hdma->Init.Channel             = usart->usart_tx_dma_channel;
+    hdma->Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma->Init.MemInc              = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma->Init.Mode                = DMA_NORMAL;
+    hdma->Init.Priority            = DMA_PRIORITY_MEDIUM;
+    hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_Init(hdma);
+    __HAL_LINKDMA(usart->uart_handle, hdmatx, *hdma);
+    hdma->Instance->PAR = (uint32_t)&usart->usart_peripheral->DR;
+    __HAL_DMA_ENABLE_IT(hdma, DMA_IT_TC | DMA_IT_TE);
+
+    HAL_NVIC_SetPriority(usart->usart_tx_dma_int_n, priority, 0);
+    HAL_NVIC_EnableIRQ(usart->usart_tx_dma_int_n);
+
+    usart->usart_transmitting = false;
+    sdkClearQueue(usart->usart_tx_queue);
+    SET_BIT(usart->usart_peripheral->CR3, USART_CR3_DMAT);
+}
+
+static void HAL_USART_Tx_DMA_Stop(HAL_USART_Serial serial)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+
+    HAL_NVIC_DisableIRQ(usart->usart_tx_dma_int_n);
+    CLEAR_BIT(usart->usart_peripheral->CR3, USART_CR3_DMAT);
+    __HAL_DMA_DISABLE(usart->usart_tx_dma_handle);
+    HAL_DMA_DeInit(usart->usart_tx_dma_handle);
+    usart->usart_transmitting = false;
+    sdkClearQueue(usart->usart_tx_queue);
+}
+
 void HAL_USART_Initial(HAL_USART_Serial serial)
 {
     if(serial == HAL_USART_SERIAL1) {
         usartMap[serial] = &USART_MAP[USART_SERIAL1];
         usartMap[serial]->uart_handle = &UartHandle_SERIAL1;
+        usartMap[serial]->usart_rx_dma_handle = &DmaHandle_Rx_SERIAL1;
+        usartMap[serial]->usart_tx_dma_handle = &DmaHandle_Tx_SERIAL1;
         usartMap[serial]->usart_rx_queue = &Usart_Rx_Queue_SERIAL1;
+        usartMap[serial]->usart_tx_queue = &Usart_Tx_Queue_SERIAL1;
+        usartMap[serial]->usart_rx_dma_buffer = Usart_Rx_Dma_Buffer_SERIAL1;
         sdkInitialQueue(usartMap[serial]->usart_rx_queue, SDK_MAX_QUEUE_SIZE);
+        sdkInitialQueue(usartMap[serial]->usart_tx_queue, USART_TX_QUEUE_SIZE);
     }
 
     usartMap[serial]->usart_enabled = false;
@@ -112,6 +276,7 @@ void HAL_USART_BeginConfig(HAL_USART_Serial serial, uint32_t baud, uint32_t conf
     if(HAL_USART_SERIAL1 == serial){
         __HAL_RCC_GPIOB_CLK_ENABLE();
         __HAL_RCC_USART1_CLK_ENABLE();
+        __HAL_RCC_DMA2_CLK_ENABLE();
     }
 
 	STM32_Pin_Info* PIN_MAP = HAL_Pin_Map();
@@ -169,7 +334,8 @@ void HAL_USART_BeginConfig(HAL_USART_Serial serial, uint32_t baud, uint32_t conf
     //Configure the NVIC for UART
     HAL_NVIC_SetPriority(usartMap[serial]->usart_int_n, USART1_IRQ_PRIORITY, 0);
     HAL_NVIC_EnableIRQ(usartMap[serial]->usart_int_n);
-    __HAL_UART_ENABLE_IT(usartMap[serial]->uart_handle, UART_IT_RXNE);
+    HAL_USART_Rx_DMA_Start(serial, USART1_IRQ_PRIORITY);
+    HAL_USART_Tx_DMA_Start(serial, USART1_IRQ_PRIORITY);
 
     usartMap[serial]->usart_enabled = true;
     usartMap[serial]->usart_transmitting = false;
@@ -177,6 +343,11 @@ void HAL_USART_BeginConfig(HAL_USART_Serial serial, uint32_t baud, uint32_t conf
 
 void HAL_USART_End(HAL_USART_Serial serial)
 {
+    if(usartMap[serial]->usart_enabled) {
+        HAL_USART_Flush_Data(serial);
+    }
+    HAL_USART_Tx_DMA_Stop(serial);
+    HAL_USART_Rx_DMA_Stop(serial);
     HAL_UART_DeInit(usartMap[serial]->uart_handle);
 
     if(HAL_USART_SERIAL1 == serial){
@@ -204,12 +375,45 @@ void HAL_USART_End(HAL_USART_Serial serial)
 
 uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data)
 {
-    HAL_UART_Transmit(usartMap[serial]->uart_handle, (uint8_t *)&data, 1, 100);//100ms  带操作系统待验证
-    return 1;
+    return HAL_USART_Write_Buffer(serial, &data, 1);
+}
+
+/*
+ * Queues the data for the tx DMA and returns once it is all queued, waiting
+ * only while the queue is full. From an interrupt, where the tx DMA interrupt
+ * may not get to run, it queues what fits and returns the count.
+ */
+int32_t HAL_USART_Write_Buffer(HAL_USART_Serial serial, const uint8_t *buffer, uint32_t size)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    uint32_t queued = 0;
+    int32_t len;
+
+    if(!usart->usart_enabled) {
+        return 0;
+    }
+    while(queued < size) {
+        len = sdkInsertQueue(usart->usart_tx_queue, buffer + queued, size - queued);
+        if(len < 0) {
+            break;
+        }
+        queued += len;
+
+        HAL_NVIC_DisableIRQ(usart->usart_tx_dma_int_n);
+        HAL_USART_Tx_DMA_Next(serial);
+        HAL_NVIC_EnableIRQ(usart->usart_tx_dma_int_n);
+
+        if(!len && HAL_IsISR()) {
+            break;
+        }
+    }
+    return queued;
 }
 
 uint32_t HAL_USART_Write_NineBitData(HAL_USART_Serial serial, uint16_t data)
 {
+    // nine bit words bypass the tx queue, so let it drain first
+    HAL_USART_Flush_Data(serial);
     HAL_UART_Transmit(usartMap[serial]->uart_handle, (uint8_t *)&data, 2, 100);//100ms
     return 1;
 }
@@ -221,7 +425,7 @@ int32_t HAL_USART_Available_Data(HAL_USART_Serial serial)
 
 int32_t HAL_USART_Available_Data_For_Write(HAL_USART_Serial serial)
 {
-    return 1;
+    return sdkGetQueueFreeLen(usartMap[serial]->usart_tx_queue);
 }
 
 int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
@@ -236,6 +440,11 @@ int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
     return -1;
 }
 
+int32_t HAL_USART_Read_Buffer(HAL_USART_Serial serial, uint8_t *buffer, uint32_t size)
+{
+    return sdkGetQueueBuffer(usartMap[serial]->usart_rx_queue, buffer, size);
+}
+
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 {
     uint8_t data;
@@ -250,7 +459,15 @@ int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 
 void HAL_USART_Flush_Data(HAL_USART_Serial serial)
 {
-    usartMap[serial]->usart_transmitting = false;
+    STM32_USART_Info *usart = usartMap[serial];
+
+    while(usart->usart_transmitting || !sdkIsQueueEmpty(usart->usart_tx_queue)) {
+        if(HAL_IsISR()) {
+            return;
+        }
+    }
+    // wait for the last byte to leave the shift register
+    while(!(usart->usart_peripheral->SR & USART_SR_TC));
 }
 
 bool HAL_USART_Is_Enabled(HAL_USART_Serial serial)
@@ -265,12 +482,38 @@ void HAL_USART_Half_Duplex(HAL_USART_Serial serial, bool Enable)
 
 static void HAL_USART_Handler(HAL_USART_Serial serial)
 {
-    if((__HAL_UART_GET_FLAG(usartMap[serial]->uart_handle, UART_FLAG_RXNE) != RESET) && (__HAL_UART_GET_IT_SOURCE(usartMap[serial]->uart_handle, UART_IT_RXNE) != RESET))
+    UART_HandleTypeDef *huart = usartMap[serial]->uart_handle;
+
+    if(huart->Instance->SR & (USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE))
     {
-        // Read byte from the receive data register
-        uint8_t c = (uint16_t)(usartMap[serial]->uart_handle->Instance->DR & (uint16_t)0x00FF);
-        sdkInsertQueue(usartMap[serial]->usart_rx_queue, &c, 1);
+        // The SR then DR read sequence clears the idle and error flags
+        __HAL_UART_CLEAR_PEFLAG(huart);
+        HAL_USART_Rx_DMA_Drain(serial);
+    }
+}
+
+static void HAL_USART_Rx_DMA_Handler(HAL_USART_Serial serial)
+{
+    DMA_HandleTypeDef *hdma = usartMap[serial]->usart_rx_dma_handle;
+
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma)
+            | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_FE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma));
+    HAL_USART_Rx_DMA_Drain(serial);
+}
+
+static void HAL_USART_Tx_DMA_Handler(HAL_USART_Serial serial)
+{
+    STM32_USART_Info *usart = usartMap[serial];
+    DMA_HandleTypeDef *hdma = usart->usart_tx_dma_handle;
+
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma)
+            | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_FE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma));
+    if(usart->usart_transmitting) {
+        // on an error the block is dropped rather than retried
+        sdkSetQueueHead(usart->usart_tx_queue, sdkGetQueueHead(usart->usart_tx_queue) + usart->usart_tx_dma_len);
+        usart->usart_transmitting = false;
     }
+    HAL_USART_Tx_DMA_Next(serial);
 }
 
 // Serial2 interrupt handler
@@ -278,3 +521,15 @@ void USART1_IRQHandler(void)
 {
     HAL_USART_Handler(HAL_USART_SERIAL1);
 }
+
+// USART1 rx DMA interrupt handler
+void DMA2_Stream2_IRQHandler(void)
+{
+    HAL_USART_Rx_DMA_Handler(HAL_USART_SERIAL1);
+}
+
+// USART1 tx DMA interrupt handler
+void DMA2_Stream7_IRQHandler(void)
+{
+    HAL_USART_Tx_DMA_Handler(HAL_USART_SERIAL1);
+}
@@ -34,6 +34,9 @@
 /* Include for debug capabilty */
 //#define MDM_DEBUG
 
+#define MDM_TOKEN_FIELDS         2    //!< max numbers parsed from a formatted response
+#define MDM_TOKEN_MATCHES        32   //!< max candidate matches tracked by the line parser
+
 #undef putc
 #undef getc
 
@@ -433,6 +436,8 @@ protected:
     virtual int _send(const void* buf, int len) = 0;
 
     /** Helper: Parse a line from the receiving buffered pipe
+        Every byte is fed once to the candidate matches of the response
+        patterns, the numeric fields of a formatted response are left in _token.
         \param pipe the receiving buffer pipe
         \param buf the parsed line
         \param len the size of the parsed line
@@ -440,24 +445,43 @@ protected:
                 WAIT if not enough data is available
                 NOT_FOUND if nothing was found
     */
-    static int _getLine(Pipe<char>* pipe, char* buffer, int length);
+    int _getLine(Pipe<char>* pipe, char* buffer, int length);
 
-    /** Helper: Parse a match from the pipe
-        \param pipe the buffered pipe
-        \param number of bytes to parse at maximum,
-        \param sta the starting string, NULL if none
-        \param end the terminating string, NULL if none
-        \return size of parsed match
+    //! candidate match of a response pattern in the receiving pipe
+    typedef struct {
+        int start;                      //!< offset of its first byte in the pipe
+        int num;                        //!< number being parsed, data left or length when done
+        uint8_t pattern;                //!< index into the pattern table
+        uint8_t state;                  //!< parsing state
+        uint8_t pos;                    //!< position in the format or the end string
+        uint8_t fields;                 //!< numbers parsed so far
+        uint8_t size;                   //!< field holding the data length + 1, 0 if none
+        int field[MDM_TOKEN_FIELDS];    //!< parsed numbers
+    } MdmMatch;
+
+    /** Helper: Advance a candidate match by one byte
+        \param m the candidate
+        \param ch the next byte
+        \return false if the candidate can no longer match
+    */
+    static bool _matchStep(MdmMatch& m, char ch);
+
+    /** Helper: Take bytes from the pipe and rebase the candidate matches
+        \param pipe the receiving buffer pipe
+        \param buf the buffer to store them
+        \param len the number of bytes
+        \return bytes taken
     */
-    static int _parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end);
+    int _matchGet(Pipe<char>* pipe, char* buf, int len);
 
-    /** Helper: Parse a match from the pipe
-        \param pipe the buffered pipe
-        \param number of bytes to parse at maximum,
-        \param fmt the formating string (%d any number, %c any char of last %d len)
-        \return size of parsed match
+    //! Helper: Forget the parser state, needed when the pipe is cleared
+    void _matchReset(void);
+
+    /** Helper: Move the payload following a +RECEIVE header into its socket
+        \param pipe the receiving buffer pipe
+        \return payload bytes still expected
     */
-    static int _parseFormated(Pipe<char>* pipe, int len, const char* fmt);
+    int _dataForward(Pipe<char>* pipe);
 
     /** Helper: Send SMS received index to callback
         \param index the index of the received SMS
@@ -546,6 +570,19 @@ protected:
     bool _attached;
     bool _attached_urc;
     volatile bool _cancel_all_operations;
+
+    // incremental state of _getLine
+    MdmMatch _match[MDM_TOKEN_MATCHES];
+    int _matches;   //!< live candidates, ordered by start and pattern
+    int _scanned;   //!< bytes of the pipe fed to the candidates
+    int _cut;       //!< candidates from here on may have been dropped, -1 if none
+    //! the formatted response last returned by _getLine
+    struct {
+        int id;
+        int field[MDM_TOKEN_FIELDS];
+    } _token;
+    int _dataSocket;    //!< socket taking the payload of the last data header
+    int _dataLeft;      //!< payload bytes still to take from the pipe
 #ifdef MDM_DEBUG
     int _debugLevel;
     system_tick_t _debugTime;
@@ -583,6 +620,7 @@ public:
     {
         while (readable())
             getc();
+        _matchReset();
     }
 
     void pause();
@@ -47,6 +47,23 @@ extern "C"
 
 /* Private typedef ----------------------------------------------------------*/
 
+// ids of the responses whose parsed fields are used, see _token
+enum {
+    TOKEN_NONE = 0,
+    TOKEN_RECEIVE,
+};
+
+// states of a candidate match in _getLine, those from MATCH_DATA on can no longer fail
+enum {
+    MATCH_FMT = 0,
+    MATCH_NUMBER,
+    MATCH_NEGATIVE,
+    MATCH_DATA,
+    MATCH_ANY,
+    MATCH_END,
+    MATCH_DONE,
+};
+
 /* Private define -----------------------------------------------------------*/
 /* Private macro ------------------------------------------------------------*/
 #define ESP8266_EN_GPIO_PIN              GPIO_PIN_9
@@ -205,6 +222,8 @@ MDMParser::MDMParser(void)
                            // used to notify system of prolonged GPRS detach.
     _cancel_all_operations = false;
     sms_cb = NULL;
+    memset(&_token, 0, sizeof(_token));
+    _matchReset();
     memset(_sockets, 0, sizeof(_sockets));
     for (int socket = 0; socket < NUMSOCKETS; socket ++)
         _sockets[socket].handle = MDM_SOCKET_ERROR;
@@ -286,13 +305,11 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
         if ((ret != WAIT) && (ret != NOT_FOUND))
         {
             int type = TYPE(ret);
-            int sk, socket;
+            int socket;
             // handle unsolicited commands here
             if (type == TYPE_PLUS) {
                 const char* cmd = buf+3;
                 int a, b, c, d, r;
-                int n;
-                char *p;
                 char s[32];
 
                 // SMS Command ---------------------------------
@@ -311,21 +328,9 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                     }
                 // Socket Specific Command ---------------------------------
                 // +RECEIVE,<socket>,<length>:
-                } else if ((sscanf(cmd, "RECEIVE,%d,%d", &a, &b) == 2)) {
-                    socket = _findSocket(a);
-                    //DEBUG_D("Socket %d: handle %d has %d bytes pending!\r\n", socket, a, b);
-                    if (socket != MDM_SOCKET_ERROR) {
-                        p = strchr(buf, ':');
-                        for(n=0; n < b; n++) {
-                            if (_sockets[socket].pipe->writeable()) {
-                                _sockets[socket].pipe->putc(p[n+3]);
-                            }
-                            else{
-                                break;
-                            }
-                        }
-                        _sockets[socket].pending += n;
-                    }
+                } else if (_token.id == TOKEN_RECEIVE) {
+                    // the payload follows in the pipe, _getLine moves it into the socket
+                    _dataSocket = _findSocket(_token.field[0]);
                 }
                 // GSM/UMTS Specific -------------------------------------------
                 // +UUPSDD: <profile_id>
@@ -374,11 +379,9 @@ int MDMParser::waitFinalResp(_CALLBACKPTR cb /* = NULL*/,
                 }
             } // end ==TYPE_PLUS
             else if (type == TYPE_CONNECTCLOSTED) {
-                if ((sscanf(buf, "%d", &sk) == 1)) {
-                    socket = _findSocket(sk);
-                    if (socket != MDM_SOCKET_ERROR) {
-                        _sockets[socket].connected = 0;
-                    }
+                socket = _findSocket(_token.field[0]);
+                if (socket != MDM_SOCKET_ERROR) {
+                    _sockets[socket].connected = 0;
                 }
             }
             if (cb) {
@@ -1953,161 +1956,263 @@ void MDMParser::dumpIp(MDM_IP ip)
 }
 
 // ----------------------------------------------------------------
-int MDMParser::_parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end)
-{
-    int o = 0;
-    if (sta) {
-        while (*sta) {
-            if (++o > len)                  return WAIT;
-            char ch = pipe->next();
-            if (*sta++ != ch)               return NOT_FOUND;
-        }
-    }
-    if (!end)                               return o; // no termination
-    // at least any char
-    if (++o > len)                      return WAIT;
-    pipe->next();
-    // check the end
-    int x = 0;
-    while (end[x]) {
-        if (++o > len)                      return WAIT;
-        char ch = pipe->next();
-        x = (end[x] == ch) ? x + 1 :
-            (end[0] == ch) ? 1 :
-            0;
-    }
-    return o;
-}
-
-int MDMParser::_parseFormated(Pipe<char>* pipe, int len, const char* fmt)
-{
-    int o = 0;
-    int num = 0;
-    if (fmt) {
-        while (*fmt) {
-            if (++o > len)                  return WAIT;
-            char ch = pipe->next();
-            if (*fmt == '%') {
-                fmt++;
-                if (*fmt == 'd') { // numeric
-                    fmt ++;
-                    while (ch >= '0' && ch <= '9') {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
+// response patterns, earlier entries win over later ones starting at the same byte
+// %d any number, %n the data length, %c any char of the last %n length
+// end: NULL if the format alone is the response, else the terminator following at least one more char
+static const struct {
+    const char* fmt;                const char* end;    int type;               int id;
+} mdmPatterns[] = {
+    { "\r\n%d, CLOSED\r\n",         NULL,               TYPE_CONNECTCLOSTED,    TOKEN_NONE      },
+    { "\r\n%d, CONNECT OK\r\n",     NULL,               TYPE_OK,                TOKEN_NONE      },
+    { "\r\n%d, CONNECT FAIL\r\n",   NULL,               TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\n%d, ALREADY CONNECT\r\n", NULL,              TYPE_OK,                TOKEN_NONE      },
+    { "\r\n%d, SEND OK\r\n",        NULL,               TYPE_OK,                TOKEN_NONE      },
+    { "\r\n%d, SEND FAIL\r\n",      NULL,               TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\n%d, CLOSE OK\r\n",       NULL,               TYPE_OK,                TOKEN_NONE      },
+    { "\r\n+RECEIVE,%d,%n:\r\n",    NULL,               TYPE_PLUS,              TOKEN_RECEIVE   },
+    { "\r\nOK\r\n",                 NULL,               TYPE_OK,                TOKEN_NONE      },
+    { "\r\nERROR\r\n",              NULL,               TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\n+CME ERROR:",            "\r\n",             TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\n+CMS ERROR:",            "\r\n",             TYPE_ERROR,             TOKEN_NONE      },
+    { "\r\n+CDNSGIP:",              "\r\n",             TYPE_PLUS,              TOKEN_NONE      },
+    { "\r\nRING\r\n",               NULL,               TYPE_RING,              TOKEN_NONE      },
+    { "\r\nCONNECT\r\n",            NULL,               TYPE_CONNECT,           TOKEN_NONE      },
+    { "\r\nNO CARRIER\r\n",         NULL,               TYPE_NOCARRIER,         TOKEN_NONE      },
+    { "\r\nNO DIALTONE\r\n",        NULL,               TYPE_NODIALTONE,        TOKEN_NONE      },
+    { "\r\nBUSY\r\n",               NULL,               TYPE_BUSY,              TOKEN_NONE      },
+    { "\r\nNO ANSWER\r\n",          NULL,               TYPE_NOANSWER,          TOKEN_NONE      },
+    { "\r\nSHUT OK\r\n",            NULL,               TYPE_IPSHUT,            TOKEN_NONE      },
+    { "\r\n+",                      "\r\n",             TYPE_PLUS,              TOKEN_NONE      },
+    { "\r\n@",                      NULL,               TYPE_PROMPT,            TOKEN_NONE      }, // Sockets
+    { "\r\n>",                      NULL,               TYPE_PROMPT,            TOKEN_NONE      }, // Sockets
+    { "\n>",                        NULL,               TYPE_PROMPT,            TOKEN_NONE      }, // File
+    { "\r\nABORTED\r\n",            NULL,               TYPE_ABORTED,           TOKEN_NONE      }, // Current command aborted
+    { "\r\nSTATE:",                 "\r\n",             TYPE_STATUS,            TOKEN_NONE      }, // ip status
+    { "\r\n\r\n",                   "\r\n",             TYPE_DBLNEWLINE,        TOKEN_NONE      }, // Double CRLF detected
+    { "\r\n",                       "\r\n",             TYPE_UNKNOWN,           TOKEN_NONE      }, // If all else fails, break up generic strings
+};
+
+bool MDMParser::_matchStep(MdmMatch& m, char ch)
+{
+    const char* fmt = mdmPatterns[m.pattern].fmt;
+    const char* end = mdmPatterns[m.pattern].end;
+    for (;;) {
+        switch (m.state) {
+            case MATCH_FMT:
+                if (fmt[m.pos] == '%') {
+                    if ((fmt[m.pos + 1] == 'd') || (fmt[m.pos + 1] == 'n')) { // numeric / data len
+                        m.num = 0;
+                        if ((ch == '-') && (m.pos > 0)) { // no pattern starts on a lone sign
+                            m.state = MATCH_NEGATIVE;
+                            return true;
+                        }
+                        m.state = MATCH_NUMBER;
+                        continue;
                     }
-                }
-                else if (*fmt == 'n') { // data len
-                    fmt ++;
-                    num = 0;
-                    while (ch >= '0' && ch <= '9') {
-                        num = num * 10 + (ch - '0');
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
+                    if (fmt[m.pos + 1] == 'c') { // char buffer (takes last %n as length)
+                        m.num = m.size ? m.field[m.size - 1] : 0;
+                        m.state = MATCH_DATA;
+                        continue;
                     }
                 }
-                else if (*fmt == 'c') { // char buffer (takes last numeric as length)
-                    fmt ++;
-                    while (--num) {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
-                    }
-                    continue;
+                if (fmt[m.pos] != ch)
+                    return false;
+                m.pos ++;
+                break;
+            case MATCH_NUMBER:
+            case MATCH_NEGATIVE:
+                if ((ch >= '0') && (ch <= '9')) {
+                    m.num = m.num * 10 + (ch - '0');
+                    return true;
                 }
-                else if (*fmt == 's') {
-                    fmt ++;
-                    if (ch != '\"')         return NOT_FOUND;
-                    do {
-                        if (++o > len)      return WAIT;
-                        ch = pipe->next();
-                    } while (ch != '\"');
-                    if (++o > len)          return WAIT;
-                    ch = pipe->next();
+                if (m.fields < MDM_TOKEN_FIELDS) {
+                    if (fmt[m.pos + 1] == 'n')
+                        m.size = m.fields + 1;
+                    m.field[m.fields ++] = (m.state == MATCH_NEGATIVE) ? -m.num : m.num;
                 }
-            }
-            if (*fmt++ != ch)               return NOT_FOUND;
+                m.pos += 2;
+                m.state = MATCH_FMT;
+                continue; // the byte after the number must match the format
+            case MATCH_DATA:
+                if ((m.num <= 0) || (-- m.num > 0))
+                    return true;
+                m.pos += 2;
+                m.state = MATCH_FMT;
+                break;
+            case MATCH_ANY: // at least any char
+                m.pos = 0;
+                m.state = MATCH_END;
+                return true;
+            case MATCH_END:
+                m.pos = (end[m.pos] == ch) ? m.pos + 1 :
+                        (end[0] == ch) ? 1 :
+                        0;
+                if (!end[m.pos])
+                    m.state = MATCH_DONE;
+                return true;
+            default:
+                return true;
+        }
+        if (!fmt[m.pos])
+            m.state = end ? MATCH_ANY : MATCH_DONE;
+        return true;
+    }
+}
+
+void MDMParser::_matchReset(void)
+{
+    _matches = 0;
+    _scanned = 0;
+    _cut = -1;
+    _dataLeft = 0;
+}
+
+int MDMParser::_dataForward(Pipe<char>* pipe)
+{
+    int n = pipe->size();
+    if (n > _dataLeft)
+        n = _dataLeft;
+    _dataLeft -= n;
+    if (ISSOCKET(_dataSocket)) {
+        // what the socket has no room for is dropped
+        _sockets[_dataSocket].pending += pipe->move(_sockets[_dataSocket].pipe, n);
+    } else {
+        pipe->move(NULL, n);
+    }
+    return _dataLeft;
+}
+
+int MDMParser::_matchGet(Pipe<char>* pipe, char* buf, int len)
+{
+    len = pipe->get(buf, len);
+    int n = 0;
+    for (int i = 0; i < _matches; i ++) {
+        if (_match[i].start >= len) {
+            _match[n] = _match[i];
+            _match[n ++].start -= len;
         }
     }
-    return o;
+    _matches = n;
+    _scanned -= len;
+    if ((_cut < 0) || (_scanned == 0)) {
+        _cut = -1;
+        return len;
+    }
+    // candidates from the cut on may have been dropped, that is fine as long
+    // as a candidate that can not fail anymore still hides them, else scan again
+    _cut = (_cut > len) ? _cut - len : 0;
+    for (int i = 0; (i < _matches) && (_match[i].start <= _cut); i ++) {
+        if (_match[i].state >= MATCH_DATA)
+            return len;
+    }
+    _matchReset();
+    return len;
 }
 
 int MDMParser::_getLine(Pipe<char>* pipe, char* buf, int len)
 {
-    int unkn = 0;
+    // the payload after a data header goes straight to its socket
+    if ((_dataLeft > 0) && (_dataForward(pipe) > 0))
+        return WAIT;
     int sz = pipe->size();
     int fr = pipe->free();
     if (len > sz)
         len = sz;
-    while (len > 0)
-    {
-        static struct {
-            const char* fmt;                              int type;
-        } lutF[] = {
-            { "\r\n%d, CLOSED\r\n",                         TYPE_CONNECTCLOSTED  },
-            { "\r\n%d, CONNECT OK\r\n",                     TYPE_OK         },
-            { "\r\n%d, CONNECT FAIL\r\n",                   TYPE_ERROR      },
-            { "\r\n%d, ALREADY CONNECT\r\n",                TYPE_OK         },
-            { "\r\n%d, SEND OK\r\n",                        TYPE_OK         },
-            { "\r\n%d, SEND FAIL\r\n",                      TYPE_ERROR      },
-            { "\r\n%d, CLOSE OK\r\n",                       TYPE_OK         },
-            { "\r\n+RECEIVE,%d,%n:\r\n%c",                  TYPE_PLUS       },
-        };
-        static struct {
-            const char* sta;          const char* end;    int type;
-        } lut[] = {
-            { "\r\nOK\r\n",             NULL,               TYPE_OK         },
-            { "\r\nERROR\r\n",          NULL,               TYPE_ERROR      },
-            { "\r\n+CME ERROR:",        "\r\n",             TYPE_ERROR      },
-            { "\r\n+CMS ERROR:",        "\r\n",             TYPE_ERROR      },
-            { "\r\n+CDNSGIP:",          "\r\n",             TYPE_PLUS       },
-            { "\r\nRING\r\n",           NULL,               TYPE_RING       },
-            { "\r\nCONNECT\r\n",        NULL,               TYPE_CONNECT    },
-            { "\r\nNO CARRIER\r\n",     NULL,               TYPE_NOCARRIER  },
-            { "\r\nNO DIALTONE\r\n",    NULL,               TYPE_NODIALTONE },
-            { "\r\nBUSY\r\n",           NULL,               TYPE_BUSY       },
-            { "\r\nNO ANSWER\r\n",      NULL,               TYPE_NOANSWER   },
-            { "\r\nSHUT OK\r\n",        NULL,               TYPE_IPSHUT     },
-            { "\r\n+",                  "\r\n",             TYPE_PLUS       },
-            { "\r\n@",                  NULL,               TYPE_PROMPT     }, // Sockets
-            { "\r\n>",                  NULL,               TYPE_PROMPT     }, // Sockets
-            { "\n>",                    NULL,               TYPE_PROMPT     }, // File
-            { "\r\nABORTED\r\n",        NULL,               TYPE_ABORTED    }, // Current command aborted
-            { "\r\nSTATE:",             "\r\n",             TYPE_STATUS     }, // ip status
-            { "\r\n\r\n",               "\r\n",             TYPE_DBLNEWLINE }, // Double CRLF detected
-            { "\r\n",                   "\r\n",             TYPE_UNKNOWN    }, // If all else fails, break up generic strings
-        };
-        for (int i = 0; i < (int)(sizeof(lutF)/sizeof(*lutF)); i ++) {
-            pipe->set(unkn);
-            int ln = _parseFormated(pipe, len, lutF[i].fmt);
-            if (ln == WAIT && fr)
-                return WAIT;
-            if ((ln != NOT_FOUND) && (unkn > 0))
-                return TYPE_UNKNOWN | pipe->get(buf, unkn);
-            if (ln > 0)
-                return lutF[i].type  | pipe->get(buf, ln);
+    _token.id = TOKEN_NONE;
+    // feed the bytes received since the last call, each one exactly once
+    pipe->set(_scanned);
+    while ((_scanned < len) && ((_matches == 0) || (_match[0].state != MATCH_DONE))) {
+        if ((_matches == 1) && (_match[0].state == MATCH_DATA) && (_match[0].num > 1)) {
+            // nothing can start inside the data, skip all but its last byte
+            int skip = _match[0].num - 1;
+            if (skip > len - _scanned)
+                skip = len - _scanned;
+            if (_cut < 0)
+                _cut = _scanned;
+            _match[0].num -= skip;
+            _scanned += skip;
+            pipe->set(_scanned);
+            continue;
         }
-        for (int i = 0; i < (int)(sizeof(lut)/sizeof(*lut)); i ++) {
-            pipe->set(unkn);
-            int ln = _parseMatch(pipe, len, lut[i].sta, lut[i].end);
-            if (ln == WAIT && fr)
-                return WAIT;
-
+        char ch = pipe->next();
+        // a candidate that can no longer fail hides everything behind it
+        bool sure = false;
+        int n = 0;
+        for (int i = 0; i < _matches; i ++) {
+            MdmMatch& m = _match[i];
+            if (sure) {
+                if ((_cut < 0) || (m.start < _cut))
+                    _cut = m.start;
+                continue;
+            }
+            if (m.state != MATCH_DONE) {
+                if (!_matchStep(m, ch))
+                    continue;
+                if (m.state == MATCH_DONE)
+                    m.num = _scanned + 1 - m.start;
+            }
+            sure = (m.state >= MATCH_DATA);
+            if (n != i)
+                _match[n] = m;
+            n ++;
+        }
+        _matches = n;
+        for (int i = 0; (i < (int)(sizeof(mdmPatterns)/sizeof(*mdmPatterns))) && !(sure && (_cut >= 0)); i ++) {
+            MdmMatch m;
+            m.start = _scanned;
+            m.pattern = i;
+            m.state = MATCH_FMT;
+            m.pos = 0;
+            m.fields = 0;
+            m.size = 0;
+            if (!_matchStep(m, ch))
+                continue;
+            if (sure || (_matches == MDM_TOKEN_MATCHES)) {
+                // hidden or no room left, remember where it started
+                if ((_cut < 0) || (_scanned < _cut))
+                    _cut = _scanned;
+                break;
+            }
+            if (m.state == MATCH_DONE)
+                m.num = 1;
+            sure = (m.state >= MATCH_DATA);
+            _match[_matches ++] = m;
+        }
+        _scanned ++;
+    }
+    // the earliest candidate decides, in the order of the pattern table
+    while ((_matches > 0) && (_match[0].start < len)) {
+        const MdmMatch& m = _match[0];
+        bool done = (m.state == MATCH_DONE) && (m.start + m.num <= len);
+        if (!done && fr)
+            return WAIT;
+        if (m.start > 0)
+            return TYPE_UNKNOWN | _matchGet(pipe, buf, m.start);
+        if (done) {
+            int type = mdmPatterns[m.pattern].type;
+            int ln = m.num;
             // Double CRLF detected, discard it.
             // This resolves a case on G350 where "\r\n" is generated after +USORF response, but missing
             // on U260/U270, which would otherwise generate "\r\n\r\nOK\r\n" which is not parseable.
-            if ((ln > 0) && (lut[i].type == TYPE_DBLNEWLINE) && (unkn == 0)) {
-                return TYPE_UNKNOWN | pipe->get(buf, 2);
+            if (type == TYPE_DBLNEWLINE)
+                return TYPE_UNKNOWN | _matchGet(pipe, buf, 2);
+            _token.id = mdmPatterns[m.pattern].id;
+            memcpy(_token.field, m.field, m.fields * sizeof(*m.field));
+            ln = _matchGet(pipe, buf, ln);
+            if (_token.id == TOKEN_RECEIVE) {
+                // only the header is returned, _dataForward takes the payload
+                _matchReset();
+                _dataSocket = MDM_SOCKET_ERROR;
+                _dataLeft = _token.field[1];
             }
-            if ((ln != NOT_FOUND) && (unkn > 0))
-                return TYPE_UNKNOWN | pipe->get(buf, unkn);
-            if (ln > 0)
-                return lut[i].type | pipe->get(buf, ln);
+            return type | ln;
         }
-        // UNKNOWN
-        unkn ++;
-        len--;
+        // the pipe is full and this candidate can not complete, try the next
+        _matches --;
+        memmove(&_match[0], &_match[1], _matches * sizeof(*_match));
     }
-    return TYPE_UNKNOWN | pipe->get(buf, unkn); //应该返回TYPE_UNKNOWN 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直处理相同的数据  chenkaiyao  2016-01-09
-    //return WAIT;
+    len = (_scanned < len) ? _scanned : len;
+    return TYPE_UNKNOWN | _matchGet(pipe, buf, len); //应该返回TYPE_UNKNOWN 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直接受到相同的数据 并且应该从缓存里面清掉。否则会一直处理相同的数据  chenkaiyao  2016-01-09
 }
 
 // ----------------------------------------------------------------
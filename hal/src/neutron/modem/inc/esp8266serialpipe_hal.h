@@ -53,13 +53,13 @@ public:
     */
     int writeable(void);
 
-    /** send a character (blocking)
+    /** queue a character for the tx DMA (blocking while the buffer is full)
         \param c the character to send
         \return c
     */
     int putc(int c);
 
-    /** send a buffer
+    /** queue a buffer for the tx DMA
         \param buffer the buffer to send
         \param length the size of the buffer to send
         \param blocking, if true this function will block
@@ -89,11 +89,11 @@ public:
     */
     int get(void* buffer, int length, bool blocking);
 
-    /** receive interrupt routine
+    /** receive interrupt routine, moves the data of the rx DMA to the pipe
     */
     void rxIrqBuf(void);
 
-    /** transmit interrupt routine
+    /** transmit interrupt routine, releases the block sent by the tx DMA
     */
     void txIrqBuf(void);
 
@@ -104,6 +104,8 @@ protected:
     void txCopy(void);
     Pipe<char> _pipeRx; //!< receive pipe
     Pipe<char> _pipeTx; //!< transmit pipe
+    volatile int _rxTail; //!< position in the rx DMA buffer already moved to _pipeRx
+    volatile int _txLen;  //!< bytes of _pipeTx the tx DMA is sending, 0 when idle
 };
 
 #endif
@@ -36,6 +36,12 @@
 
 #define MDM_ESP8266_RESET_DELAY  4000
 
+#define MDM_TOKEN_FIELDS         7    //!< max numbers parsed from a formatted response
+#define MDM_TOKEN_MATCHES        16   //!< max candidate matches tracked by the line parser
+
+#define MDM_TX_SIZE              2048 //!< bytes of socket data queued for writing
+#define MDM_TX_SEGMENTS          8    //!< max socket writes queued
+
 #undef putc
 #undef getc
 
@@ -155,15 +161,35 @@ public:
     */
     bool socketIsConnected(int socket);
 
-    /** Write socket data
+    /** Write socket data, waits only while the send queue is full
         \param socket the socket handle
         \param buf the buffer to write
         \param len the size of the buffer to write
-        \return the size written or SOCKET_ERROR on failure
+        \return the size queued for writing or SOCKET_ERROR on failure
     */
     int socketSend(int socket, const char * buf, int len);
     int socketSendTo(int socket, MDM_IP ip, int port, const char * buf, int len);
 
+    /** callback function reporting the end of a queued socket write
+        \param socket the socket handle
+        \param sent the bytes taken by the module or SOCKET_ERROR on failure
+        \param param the optional argument passed to #socketSendAsync
+    */
+    typedef void (*_SENDCBPTR)(int socket, int sent, void* param);
+
+    /** Queue socket data, it is written while the modem is polled
+        \param socket the socket handle
+        \param buf the buffer to write
+        \param len the size of the buffer to write
+        \param cb the optional callback called once the data is written
+        \param param the optional callback parameter
+        \return the size queued, 0 if the queue is full, or SOCKET_ERROR on failure
+    */
+    int socketSendAsync(int socket, const char * buf, int len,
+                        _SENDCBPTR cb = NULL, void* param = NULL);
+    int socketSendToAsync(int socket, MDM_IP ip, int port, const char * buf, int len,
+                          _SENDCBPTR cb = NULL, void* param = NULL);
+
     /** Get the number of bytes pending for reading for this socket
         \param socket the socket handle
         \return the number of bytes pending or SOCKET_ERROR on failure
@@ -321,6 +347,8 @@ protected:
     virtual int _send(const void* buf, int len) = 0;
 
     /** Helper: Parse a line from the receiving buffered pipe
+        Every byte is fed once to the candidate matches of the response
+        patterns, the numeric fields of a formatted response are left in _token.
         \param pipe the receiving buffer pipe
         \param buf the parsed line
         \param len the size of the parsed line
@@ -328,24 +356,68 @@ protected:
                 WAIT if not enough data is available
                 NOT_FOUND if nothing was found
     */
-    static int _getLine(Pipe<char>* pipe, char* buffer, int length);
+    int _getLine(Pipe<char>* pipe, char* buffer, int length);
+
+    //! candidate match of a response pattern in the receiving pipe
+    typedef struct {
+        int start;                      //!< offset of its first byte in the pipe
+        int num;                        //!< number being parsed, data left or length when done
+        uint8_t pattern;                //!< index into the pattern table
+        uint8_t state;                  //!< parsing state
+        uint8_t pos;                    //!< position in the format or the end string
+        uint8_t fields;                 //!< numbers parsed so far
+        uint8_t size;                   //!< field holding the data length + 1, 0 if none
+        int field[MDM_TOKEN_FIELDS];    //!< parsed numbers
+    } MdmMatch;
+
+    /** Helper: Advance a candidate match by one byte
+        \param m the candidate
+        \param ch the next byte
+        \return false if the candidate can no longer match
+    */
+    static bool _matchStep(MdmMatch& m, char ch);
 
-    /** Helper: Parse a match from the pipe
-        \param pipe the buffered pipe
-        \param number of bytes to parse at maximum,
-        \param sta the starting string, NULL if none
-        \param end the terminating string, NULL if none
-        \return size of parsed match
+    /** Helper: Take bytes from the pipe and rebase the candidate matches
+        \param pipe the receiving buffer pipe
+        \param buf the buffer to store them
+        \param len the number of bytes
+        \return bytes taken
     */
-    static int _parseMatch(Pipe<char>* pipe, int len, const char* sta, const char* end);
+    int _matchGet(Pipe<char>* pipe, char* buf, int len);
+
+    //! Helper: Forget the parser state, needed when the pipe is cleared
+    void _matchReset(void);
 
-    /** Helper: Parse a match from the pipe
-        \param pipe the buffered pipe
-        \param number of bytes to parse at maximum,
-        \param fmt the formating string (%d any number, %c any char of last %d len)
-        \return size of parsed match
+    /** Helper: Move the payload following a +IPD header into its socket
+        \param pipe the receiving buffer pipe
+        \return payload bytes still expected
     */
-    static int _parseFormated(Pipe<char>* pipe, int len, const char* fmt);
+    int _dataForward(Pipe<char>* pipe);
+
+    /** Helper: Queue a socket write
+        \param ip the destination of a datagram, NOIP on a connected socket
+        \return the size queued, 0 if the queue is full, or SOCKET_ERROR on failure
+        \sa socketSendToAsync
+    */
+    int _txQueue(int socket, MDM_IP ip, int port, const char* buf, int len,
+                 _SENDCBPTR cb, void* param);
+
+    //! Helper: Start the next queued write or give up the one the module stopped answering
+    void _txPoll(void);
+
+    /** Helper: Pass a final response to the queued write in progress
+        \param type the response type
+        \return true if the response belongs to the write
+    */
+    bool _txResponse(int type);
+
+    /** Helper: Complete the queued write in progress and report it
+        \param sent the bytes written or SOCKET_ERROR on failure
+    */
+    void _txDone(int sent);
+
+    //! Helper: Write out the queue, AT commands must not interleave with a write
+    void _txFlush(void);
 
 protected:
     // for rtos over riding by useing Rtos<MDMxx>
@@ -384,6 +456,7 @@ protected:
         volatile bool connected;
         volatile int pending;
         volatile bool open;
+        volatile bool txFailed;     //!< a queued write failed, not reported yet
         Pipe<char>* pipe;
     } SockCtrl;
     // LISA-C has 6 TCP and 6 UDP sockets
@@ -391,6 +464,7 @@ protected:
     SockCtrl _sockets[7];
     int _findSocket(int handle = MDM_SOCKET_ERROR/* = CREATE*/);
     bool _socketFree(int socket);
+    bool _socketTxFailed(int socket);
 
     static MDMParser* inst;
     bool _init;
@@ -403,6 +477,36 @@ protected:
     static int _aplistindex;
 
     volatile bool _cancel_all_operations;
+
+    // incremental state of _getLine
+    MdmMatch _match[MDM_TOKEN_MATCHES];
+    int _matches;   //!< live candidates, ordered by start and pattern
+    int _scanned;   //!< bytes of the pipe fed to the candidates
+    int _cut;       //!< candidates from here on may have been dropped, -1 if none
+    //! the formatted response last returned by _getLine
+    struct {
+        int id;
+        int field[MDM_TOKEN_FIELDS];
+    } _token;
+    int _dataSocket;    //!< socket taking the payload of the last data header
+    int _dataLeft;      //!< payload bytes still to take from the pipe
+    // queued socket writes, the block being written first
+    typedef struct {
+        int socket;
+        MDM_IP ip;          //!< destination of a datagram, NOIP if connected
+        int port;
+        int len;            //!< bytes in _txBuf
+        _SENDCBPTR cb;
+        void* param;
+    } TxSegment;
+    TxSegment _txSeg[MDM_TX_SEGMENTS];
+    int _txSegs;        //!< queued segments
+    int _txUsed;        //!< bytes of _txBuf held by the segments
+    int _txBlockSegs;   //!< segments written by one AT+CIPSEND, 0 if idle
+    int _txBlock;       //!< bytes written by that AT+CIPSEND
+    int _txState;
+    system_tick_t _txTime;
+    char _txBuf[MDM_TX_SIZE];
 #ifdef MODEM_DEBUG
     int _debugLevel;
     system_tick_t _debugTime;
@@ -422,7 +526,7 @@ public:
         \param rxSize the size of the serial rx buffer
         \param txSize the size of the serial tx buffer
     */
-    MDMEsp8266Serial( int rxSize = 2048, int txSize = 10 );
+    MDMEsp8266Serial( int rxSize = 2048, int txSize = 512 );
     //! Destructor
     virtual ~MDMEsp8266Serial(void);
 
@@ -440,6 +544,7 @@ public:
     {
         while (readable())
             getc();
+        _matchReset();
     }
 protected:
     /** Write bytes to the physical interface.
@@ -30,17 +30,34 @@
 #endif
 
 
+#define ESP8266_RX_DMA_BUFFER_SIZE      256
+
 UART_HandleTypeDef UartHandle_ESP8266;
+static DMA_HandleTypeDef DmaHandle_Rx_ESP8266;     // USART1_RX DMA2_Stream2
+static DMA_HandleTypeDef DmaHandle_Tx_ESP8266;     // USART1_TX DMA2_Stream7
+static uint8_t Esp8266_Rx_Dma_Buffer[ESP8266_RX_DMA_BUFFER_SIZE];
+
+#define ESP8266_DMA_CLEAR_FLAGS(hdma) \
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma) \
+            | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_FE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma))
 
 Esp8266SerialPipe::Esp8266SerialPipe(int rxSize, int txSize) :
     _pipeRx( rxSize ),
-    _pipeTx( txSize )
+    _pipeTx( txSize ),
+    _rxTail( 0 ),
+    _txLen( 0 )
 {
     HAL_NVIC_DisableIRQ(USART1_IRQn);
 }
 
 Esp8266SerialPipe::~Esp8266SerialPipe(void)
 {
+    HAL_NVIC_DisableIRQ(DMA2_Stream2_IRQn);
+    HAL_NVIC_DisableIRQ(DMA2_Stream7_IRQn);
+    HAL_UART_DMAStop(&UartHandle_ESP8266);
+    HAL_DMA_DeInit(&DmaHandle_Rx_ESP8266);
+    HAL_DMA_DeInit(&DmaHandle_Tx_ESP8266);
+
     // wait for transmission of outgoing data
     __HAL_RCC_USART1_FORCE_RESET();
     __HAL_RCC_USART1_RELEASE_RESET();
@@ -55,6 +72,7 @@ void Esp8266SerialPipe::begin(unsigned int baud)
 {
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_USART1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
 
     GPIO_InitTypeDef  GPIO_InitStruct;
     /* UART TX GPIO pin configuration  */
@@ -69,6 +87,9 @@ void Esp8266SerialPipe::begin(unsigned int baud)
     GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    HAL_NVIC_DisableIRQ(DMA2_Stream2_IRQn);
+    HAL_NVIC_DisableIRQ(DMA2_Stream7_IRQn);
+
     UartHandle_ESP8266.Instance          = USART1;
     UartHandle_ESP8266.Init.BaudRate     = baud;
     UartHandle_ESP8266.Init.WordLength   = UART_WORDLENGTH_8B;
@@ -80,35 +101,125 @@ void Esp8266SerialPipe::begin(unsigned int baud)
     HAL_UART_DeInit(&UartHandle_ESP8266);
     HAL_UART_Init(&UartHandle_ESP8266);
 
-    //Configure the NVIC for UART
+    // rx: circular DMA into Esp8266_Rx_Dma_Buffer
+    DmaHandle_Rx_ESP8266.Instance                 = DMA2_Stream2;
+    DmaHandle_Rx_ESP8266.Init.Channel             = DMA_CHANNEL_4;
+    DmaHandle_Rx_ESP8266.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    DmaHandle_Rx_ESP8266.Init.PeriphInc           = DMA_PINC_DISABLE;
+    DmaHandle_Rx_ESP8266.Init.MemInc              = DMA_MINC_ENABLE;
+    DmaHandle_Rx_ESP8266.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    DmaHandle_Rx_ESP8266.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    DmaHandle_Rx_ESP8266.Init.Mode                = DMA_CIRCULAR;
+    DmaHandle_Rx_ESP8266.Init.Priority            = DMA_PRIORITY_HIGH;
+    DmaHandle_Rx_ESP8266.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_Init(&DmaHandle_Rx_ESP8266);
+    __HAL_LINKDMA(&UartHandle_ESP8266, hdmarx, DmaHandle_Rx_ESP8266);
+
+    // tx: one block of _pipeTx at a time, sent in place
+    DmaHandle_Tx_ESP8266.Instance                 = DMA2_Stream7;
+    DmaHandle_Tx_ESP8266.Init.Channel             = DMA_CHANNEL_4;
+    DmaHandle_Tx_ESP8266.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    DmaHandle_Tx_ESP8266.Init.PeriphInc           = DMA_PINC_DISABLE;
+    DmaHandle_Tx_ESP8266.Init.MemInc              = DMA_MINC_ENABLE;
+    DmaHandle_Tx_ESP8266.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    DmaHandle_Tx_ESP8266.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    DmaHandle_Tx_ESP8266.Init.Mode                = DMA_NORMAL;
+    DmaHandle_Tx_ESP8266.Init.Priority            = DMA_PRIORITY_MEDIUM;
+    DmaHandle_Tx_ESP8266.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+    HAL_DMA_Init(&DmaHandle_Tx_ESP8266);
+    __HAL_LINKDMA(&UartHandle_ESP8266, hdmatx, DmaHandle_Tx_ESP8266);
+    DmaHandle_Tx_ESP8266.Instance->PAR = (uint32_t)&USART1->DR;
+    __HAL_DMA_ENABLE_IT(&DmaHandle_Tx_ESP8266, DMA_IT_TC | DMA_IT_TE);
+
+    // data queued before a restart of the link is dropped
+    _txLen = 0;
+    _pipeTx.skip(_pipeTx.size());
+    _rxTail = 0;
+
+    //Configure the NVIC for UART, the DMA interrupts share its priority so none preempts another
     HAL_NVIC_SetPriority(USART1_IRQn, USART1_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, USART1_IRQ_PRIORITY, 0);
+    HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, USART1_IRQ_PRIORITY, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
-    __HAL_UART_ENABLE_IT(&UartHandle_ESP8266, UART_IT_RXNE);
+    HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+    HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+
+    HAL_UART_Receive_DMA(&UartHandle_ESP8266, Esp8266_Rx_Dma_Buffer, ESP8266_RX_DMA_BUFFER_SIZE);
+    __HAL_UART_ENABLE_IT(&UartHandle_ESP8266, UART_IT_IDLE);
+    SET_BIT(USART1->CR3, USART_CR3_DMAT);
 }
 
 // tx channel
 int Esp8266SerialPipe::writeable(void)
 {
-    return 1;
+    return _pipeTx.free();
 }
 
 int Esp8266SerialPipe::putc(int c)
 {
-    uint8_t data = c;
-    HAL_UART_Transmit(&UartHandle_ESP8266, &data, 1, 1000);//1s  带操作系统待验证
+    char data = c;
+    put(&data, 1, true);
     return c;
 }
 
+/*
+ * Only copies into _pipeTx. The tx DMA sends the pipe in place and its
+ * transfer complete interrupt starts the next block.
+ */
 int Esp8266SerialPipe::put(const void* buffer, int length, bool blocking)
 {
-    int n;
     const char* ptr = (const char*)buffer;
+    int n = 0;
 
-    for(n=0; n<length; n++)
-    {
-        putc(ptr[n]);
+    while (n < length) {
+        int k = _pipeTx.put(ptr + n, length - n, false);
+        n += k;
+        txStart();
+        if (!k && !blocking) {
+            break;
+        }
+    }
+    return n;
+}
+
+void Esp8266SerialPipe::txStart(void)
+{
+    HAL_NVIC_DisableIRQ(DMA2_Stream7_IRQn);
+    txCopy();
+    HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+}
+
+// must run with the tx DMA interrupt masked or from that interrupt
+void Esp8266SerialPipe::txCopy(void)
+{
+    DMA_HandleTypeDef *hdma = &DmaHandle_Tx_ESP8266;
+    const char* data;
+
+    if (_txLen) {
+        return;
+    }
+    int len = _pipeTx.peek(&data);
+    if (len <= 0) {
+        return;
     }
-    return length;
+    _txLen = len;
+
+    __HAL_DMA_DISABLE(hdma);
+    ESP8266_DMA_CLEAR_FLAGS(hdma);
+    hdma->Instance->M0AR = (uint32_t)data;
+    hdma->Instance->NDTR = len;
+    __HAL_DMA_ENABLE(hdma);
+}
+
+void Esp8266SerialPipe::txIrqBuf(void)
+{
+    ESP8266_DMA_CLEAR_FLAGS(&DmaHandle_Tx_ESP8266);
+    if (_txLen) {
+        // on an error the block is dropped rather than retried
+        _pipeTx.skip(_txLen);
+        _txLen = 0;
+    }
+    txCopy();
 }
 
 // rx channel
@@ -129,22 +240,37 @@ int Esp8266SerialPipe::get(void* buffer, int length, bool blocking)
     return _pipeRx.get((char*)buffer,length,blocking);
 }
 
+/*
+ * Moves whatever the rx DMA has written since the last call to _pipeRx, on
+ * the half transfer, transfer complete and line idle interrupts.
+ */
 void Esp8266SerialPipe::rxIrqBuf(void)
 {
-    uint8_t c = (uint16_t)(UartHandle_ESP8266.Instance->DR & (uint16_t)0x00FF);
-    if (_pipeRx.writeable())
-        _pipeRx.putc(c);
-    else
-        /* overflow */;
+    int head = ESP8266_RX_DMA_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(&DmaHandle_Rx_ESP8266);
+    int tail = _rxTail;
+
+    if (head == tail) {
+        return;
+    }
+    // what does not fit into _pipeRx is dropped (overflow)
+    if (head < tail) {
+        _pipeRx.put((const char*)&Esp8266_Rx_Dma_Buffer[tail], ESP8266_RX_DMA_BUFFER_SIZE - tail);
+        tail = 0;
+    }
+    if (head > tail) {
+        _pipeRx.put((const char*)&Esp8266_Rx_Dma_Buffer[tail], head - tail);
+    }
+    _rxTail = head;
 }
 
 extern "C"
 {
     void HAL_USART1_Handler(UART_HandleTypeDef *huart)
     {
-        if((__HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE) != RESET)
-                && (__HAL_UART_GET_IT_SOURCE(huart, UART_IT_RXNE) != RESET))
+        if(huart->Instance->SR & (USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE))
         {
+            // The SR then DR read sequence clears the idle and error flags
+            __HAL_UART_CLEAR_PEFLAG(huart);
             esp8266MDM.rxIrqBuf();
         }
     }
@@ -154,4 +280,17 @@ extern "C"
     {
         HAL_USART1_Handler(&UartHandle_ESP8266);
     }
+
+    // USART1 rx DMA interrupt handler
+    void DMA2_Stream2_IRQHandler(void)
+    {
+        ESP8266_DMA_CLEAR_FLAGS(&DmaHandle_Rx_ESP8266);
+        esp8266MDM.rxIrqBuf();
+    }
+
+    // USART1 tx DMA interrupt handler
+    void DMA2_Stream7_IRQHandler(void)
+    {
+        esp8266MDM.txIrqBuf();
+    }
 }
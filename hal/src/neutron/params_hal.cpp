@@ -28,9 +28,11 @@
 #include "intorobot_def.h"
 
 #define EEPROM_BOOT_PARAMS_MAX_SIZE                        (512)    //参数区大小
+#define EEPROM_LEGACY_BOOT_PARAMS_ADDR                      (4096 - EEPROM_BOOT_PARAMS_MAX_SIZE)    //旧版4096字节EEPROM中的参数区地址
 
 hal_boot_params_t intorobot_boot_params;         //bootloader参数
 hal_system_params_t intorobot_system_params;     //设备参数
+bool intorobot_boot_params_legacy = false;       //参数区仍在旧地址 bootloader为旧版
 
 
 /*初始化bootloader参数区*/
@@ -75,12 +77,23 @@ void init_fac_system_params(hal_system_params_t *psystem_params) {
 }
 
 void save_boot_params(hal_boot_params_t *pboot_params);
+/*
+ * bootloader参数区地址
+ * 旧版bootloader只读旧地址 在bootloader更新并迁移参数区之前沿用旧地址
+ * */
+uint32_t boot_params_address(void) {
+    if(intorobot_boot_params_legacy) {
+        return EEPROM_LEGACY_BOOT_PARAMS_ADDR;
+    }
+    return HAL_EEPROM_Length() - EEPROM_BOOT_PARAMS_MAX_SIZE;
+}
+
 /*
  * 读取bootloader参数区
  * */
 void read_boot_params(hal_boot_params_t *pboot_params) {
     uint32_t len = sizeof(hal_boot_params_t);
-    uint32_t address = HAL_EEPROM_Length() - EEPROM_BOOT_PARAMS_MAX_SIZE;
+    uint32_t address = boot_params_address();
     uint8_t *pboot = (uint8_t *)pboot_params;
 
     memset(pboot, 0, len);
@@ -88,9 +101,7 @@ void read_boot_params(hal_boot_params_t *pboot_params) {
         return;
     }
 
-    for (int num = 0; num<len; num++) {
-        pboot[num] = HAL_EEPROM_Read(address+num);
-    }
+    HAL_EEPROM_Get(address, pboot, len);
 }
 
 /*
@@ -98,16 +109,24 @@ void read_boot_params(hal_boot_params_t *pboot_params) {
  * */
 void save_boot_params(hal_boot_params_t *pboot_params) {
     uint32_t len = sizeof(hal_boot_params_t);
-    uint32_t address = HAL_EEPROM_Length() - EEPROM_BOOT_PARAMS_MAX_SIZE;
+    uint32_t address = boot_params_address();
     uint8_t *pboot = (uint8_t *)pboot_params;
 
     if(len > EEPROM_BOOT_PARAMS_MAX_SIZE) {
         return;
     }
 
-    for (int num = 0; num<len; num++) {
-        HAL_EEPROM_Write(address+num, pboot[num]);
-    }
+    //整块写入 复位时不会留下一半新一半旧的参数
+    HAL_EEPROM_Put(address, pboot, len);
+}
+
+/*
+ * 读取旧版EEPROM中的bootloader参数区
+ * 旧版按4096个虚拟地址存储 记录格式与现在相同 超出容量的记录仍然可读
+ * */
+bool read_legacy_boot_params(hal_boot_params_t *pboot_params) {
+    HAL_EEPROM_Get(EEPROM_LEGACY_BOOT_PARAMS_ADDR, pboot_params, sizeof(hal_boot_params_t));
+    return BOOT_PARAMS_HEADER == pboot_params->header;
 }
 
 void save_system_params(hal_system_params_t *psystem_params);
@@ -170,6 +189,12 @@ void HAL_PARAMS_Init_Boot_Params(void) {
 void HAL_PARAMS_Load_Boot_Params(void) {
     read_boot_params(&intorobot_boot_params);
     if( BOOT_PARAMS_HEADER != intorobot_boot_params.header ) {
+        //新版bootloader启动时已迁移参数区 未迁移说明bootloader仍为旧版
+        //继续使用旧地址 否则bootloader读不到应用写入的参数
+        if(read_legacy_boot_params(&intorobot_boot_params)) {
+            intorobot_boot_params_legacy = true;
+            return;
+        }
         //擦除eeprom区域 并初始化
         InternalFlashStore flashStore;
         flashStore.eraseSector(EEPROM_START_ADDR);
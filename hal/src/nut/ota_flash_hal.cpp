@@ -186,6 +186,16 @@ uint32_t HAL_OTA_FlashLength()
     return CACHE_ONLINE_APP_SEC_NUM * SPI_FLASH_SEC_SIZE;
 }
 
+uint32_t HAL_APP_FlashAddress()
+{
+    return 0;
+}
+
+uint32_t HAL_APP_FlashLength()
+{
+    return 0;
+}
+
 uint16_t HAL_OTA_ChunkSize()
 {
     return OTA_CHUNK_SIZE;
@@ -201,8 +211,23 @@ int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length,
     return 0;
 }
 
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length)
+{
+    return -1;
+}
+
 hal_update_complete_t HAL_FLASH_End(void)
 {
     return HAL_UPDATE_ERROR;
 }
 
+bool HAL_OTA_Get_Checkpoint(void* data, uint32_t length)
+{
+    return false;
+}
+
+bool HAL_OTA_Set_Checkpoint(const void* data, uint32_t length)
+{
+    return false;
+}
+
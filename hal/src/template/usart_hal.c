@@ -49,6 +49,11 @@ uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data)
   return 0;
 }
 
+int32_t HAL_USART_Write_Buffer(HAL_USART_Serial serial, const uint8_t *buffer, uint32_t size)
+{
+  return 0;
+}
+
 uint32_t HAL_USART_Write_NineBitData(HAL_USART_Serial serial, uint16_t data)
 {
     return 1;
@@ -69,6 +74,11 @@ int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
     return 0;
 }
 
+int32_t HAL_USART_Read_Buffer(HAL_USART_Serial serial, uint8_t *buffer, uint32_t size)
+{
+    return 0;
+}
+
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 {
     return 0;
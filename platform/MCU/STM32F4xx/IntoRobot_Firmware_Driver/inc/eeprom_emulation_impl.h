@@ -26,7 +26,12 @@ constexpr uintptr_t EEPROM_SectorBase2 = 0x0800C000;
 constexpr size_t EEPROM_SectorSize1 = 16*1024;
 constexpr size_t EEPROM_SectorSize2 = 16*1024;
 
-using FlashEEPROM = EEPROMEmulation<InternalFlashStore, EEPROM_SectorBase1, EEPROM_SectorSize1, EEPROM_SectorBase2, EEPROM_SectorSize2>;
+// Indexes above the capacity that an older emulation used, see EEPROMEmulation
+#ifndef EEPROM_LEGACY_CAPACITY
+#define EEPROM_LEGACY_CAPACITY 0
+#endif
+
+using FlashEEPROM = EEPROMEmulation<InternalFlashStore, EEPROM_SectorBase1, EEPROM_SectorSize1, EEPROM_SectorBase2, EEPROM_SectorSize2, 0, EEPROM_LEGACY_CAPACITY>;
 
 FlashEEPROM flashEEPROM;
 
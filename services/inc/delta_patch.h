@@ -0,0 +1,53 @@
+#ifndef DELTA_PATCH_H__
+#define DELTA_PATCH_H__
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * A patch is a list of operations building the new image front to back,
+ * numbers are little endian:
+ *   COPY   01 offset:u32 length:u32           length bytes of the base at offset
+ *   ADD    02 offset:u32 length:u32 diff...   base bytes at offset plus length diff bytes
+ *   INSERT 03 length:u32 data...              length new bytes
+ */
+#define DELTA_OP_COPY               0x01
+#define DELTA_OP_ADD                0x02
+#define DELTA_OP_INSERT             0x03
+
+// reads length bytes of the base image at offset, returns 0 on success
+typedef int (*delta_read_t)(void *context, uint32_t offset, uint8_t *buffer, uint32_t length);
+
+/*
+ * Streaming patch applier: input and output may be split anywhere, the base
+ * is read through readBase straight into the output buffer so no RAM is
+ * needed besides this struct.
+ */
+typedef struct
+{
+    delta_read_t readBase;
+    void *context;
+    uint32_t baseSize;
+    uint8_t op;                 // operation being applied, 0 between operations
+    uint8_t fieldLen;           // bytes of field collected
+    uint8_t field[9];           // op followed by its numbers
+    uint32_t offset;            // base offset of the rest of the operation
+    uint32_t length;            // bytes of the operation still to produce
+    bool error;
+}DELTA_PATCH;
+
+
+extern void deltaInitialPatch(DELTA_PATCH * const pstPatch, delta_read_t readBase, void *context, uint32_t uiBaseSize);
+extern uint32_t deltaApply(DELTA_PATCH * const pstPatch, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiUsed, uint8_t *pheOut, uint32_t uiOutLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* DELTA_PATCH_H__ */
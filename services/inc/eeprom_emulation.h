@@ -20,6 +20,7 @@
  ******************************************************************************
  */
 
+#include <array>
 #include <cstring>
 #include <memory>
 #include <vector>
@@ -89,9 +90,23 @@
  * not call performPendingErase() before the next page swap, the
  * alternate page will be erased just before the page swap.
  *
+ * Optionally, the latest value of the first CacheSize indexes and the
+ * address of the first empty record are kept in RAM. Reads and writes
+ * of ranges inside the cache then cost O(length) instead of a walk
+ * through the whole page. The cache uses CacheSize bytes of RAM and is
+ * rebuilt from Flash after init() and after each page swap. Ranges that
+ * go past the cache use the page walk.
+ *
+ * Optionally, the indexes from the capacity up to LegacyCapacity can be
+ * written too. They hold the data an older emulation with a larger
+ * capacity kept at the top of its range, where code built for it still
+ * looks. Writing 0xFF to them frees their records at the next page swap.
+ * Only a few of them should hold data, as a page swap copies them along
+ * with the records below the capacity.
+ *
  */
 
-template <typename Store, uintptr_t PageBase1, size_t PageSize1, uintptr_t PageBase2, size_t PageSize2>
+template <typename Store, uintptr_t PageBase1, size_t PageSize1, uintptr_t PageBase2, size_t PageSize2, size_t CacheSize = 0, size_t LegacyCapacity = 0>
 class EEPROMEmulation
 {
 public:
@@ -179,6 +194,8 @@ public:
         {
             clear();
         }
+
+        updateCache();
     }
 
     // Read the latest value of a byte of EEPROM in data or 0xFF if the
@@ -306,6 +323,9 @@ public:
             activePage = LogicalPage::NoPage;
             alternatePage = LogicalPage::NoPage;
         }
+
+        // The records moved, read them again on the next access
+        cacheValid = false;
     }
 
     // Which page should currently be read from/written to
@@ -337,6 +357,12 @@ public:
     // Iterate through a page to extract the latest value of each address
     void readRange(Index indexBegin, Data *data, uint16_t length)
     {
+        if(isCached(indexBegin, length))
+        {
+            std::memcpy(data, &cache[indexBegin], length);
+            return;
+        }
+
         std::memset(data, FLASH_ERASED, length);
 
         Index indexEnd = indexBegin + length;
@@ -354,8 +380,14 @@ public:
     {
         // don't write anything if index is out of range
         Index indexEnd = indexBegin + length;
-        if(indexEnd > capacity())
+        if(indexEnd > capacity() && indexEnd > LegacyCapacity)
+        {
+            return;
+        }
+
+        if(isCached(indexBegin, length))
         {
+            writeRangeCached(indexBegin, data, length);
             return;
         }
 
@@ -384,6 +416,68 @@ public:
         {
             swapPagesAndWrite(indexBegin, data, length);
         }
+
+        // The empty record moved and the range may overlap the cache
+        cacheValid = false;
+    }
+
+    // Same as writeRange with the existing values and the empty record
+    // taken from the cache
+    void writeRangeCached(Index indexBegin, const Data *data, uint16_t length)
+    {
+        Data *existingData = &cache[indexBegin];
+
+        uint16_t changedCount = 0;
+        for(uint16_t i = 0; i < length; i++)
+        {
+            if(existingData[i] != data[i])
+            {
+                changedCount++;
+            }
+        }
+
+        bool success = !cacheHasInvalidRecords &&
+            writeRangeChanged(cacheEmptyAddress, indexBegin, data, existingData, length);
+
+        if(success)
+        {
+            cacheEmptyAddress += changedCount * sizeof(Record);
+            std::memcpy(existingData, data, length);
+        }
+        else
+        {
+            swapPagesAndWrite(indexBegin, data, length);
+            cacheValid = false;
+        }
+    }
+
+    // Whether a range can be read and written through the cache,
+    // rebuilding the cache first if needed
+    bool isCached(Index indexBegin, uint16_t length)
+    {
+        if(CacheSize == 0 || (size_t)indexBegin + length > CacheSize)
+        {
+            return false;
+        }
+
+        if(!cacheValid)
+        {
+            updateCache();
+        }
+        return cacheValid;
+    }
+
+    // Rebuild the cache from the active page in a single walk
+    void updateCache()
+    {
+        if(CacheSize == 0 || getActivePage() == LogicalPage::NoPage)
+        {
+            return;
+        }
+
+        cacheHasInvalidRecords = !readRangeAndFindEmpty(getActivePage(),
+                cache.data(), 0, CacheSize, cacheEmptyAddress);
+        cacheValid = true;
     }
 
     // Read values and find the address where to write new records
@@ -758,4 +852,14 @@ public:
 protected:
     LogicalPage activePage;
     LogicalPage alternatePage;
+
+    static_assert(CacheSize <= SmallestPageSize / sizeof(Record) / 2,
+        "CacheSize can't be larger than the capacity");
+
+    // Latest value of each index below CacheSize and the first empty
+    // record of the active page, valid only when cacheValid is set
+    std::array<Data, CacheSize> cache;
+    Address cacheEmptyAddress = 0;
+    bool cacheHasInvalidRecords = false;
+    bool cacheValid = false;
 };
@@ -0,0 +1,743 @@
+/**
+ ******************************************************************************
+ * @file    eeprom_ring_emulation.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <limits>
+
+/* EEPROM Emulation using a ring of Flash pages
+ *
+ * Same API and record format as EEPROMEmulation, but instead of two
+ * pages that are swapped in full, PageCount equal pages are used as a
+ * log. Each page must be erasable on its own, so a page is one sector
+ * of the Store (or a sub-sector on parts with small erase units).
+ *
+ * Each page starts with a header holding a sequence number and a
+ * status. The active pages, ordered by sequence number, form the log:
+ * the oldest is the tail and the newest is the head. Records are only
+ * appended to the head, and the latest valid record of an index across
+ * the log is its value.
+ *
+ * When the head is full (or has invalid records after a reset), the
+ * next erased page of the ring is opened as the new head. One page is
+ * kept in reserve: before using the last free page but one, the tail is
+ * compacted by copying the records that no newer page overrides to the
+ * head, then the tail is marked inactive. Compaction moves at most one
+ * page of records at a time and only writes, so a write never waits for
+ * more than a single small page erase.
+ *
+ * Inactive pages are erased just before they are reused, or earlier
+ * through hasPendingErase() and performPendingErase(), which erase one
+ * page per call. Since the pages are used in turn, erases are spread
+ * evenly over the whole ring.
+ *
+ * Writes of multiple bytes are atomic as in EEPROMEmulation: records are
+ * written backwards in a single page, followed by an empty record. A
+ * reset during a compaction leaves duplicates of the same values in the
+ * head and the tail is compacted again. If the compaction had already
+ * opened the reserve page, init() drops that page since it only holds
+ * copies of records of the tail.
+ *
+ * The capacity is the smaller of one page of records (so an atomic
+ * write always fits in the head) and half of the records of the pages
+ * outside of the head and the reserve.
+ *
+ */
+
+template <typename Store, uintptr_t PageBase, size_t PageSize, uint8_t PageCount>
+class EEPROMRingEmulation
+{
+public:
+    using Address = uintptr_t;
+    using Index = uint16_t;
+    using Data = uint8_t;
+    using Page = uint8_t;
+
+    static const uint8_t FLASH_ERASED = 0xFF;
+
+    // Stores the order and status of a page of the ring
+    //
+    // WARNING: Do not change the size of struct or order of elements since
+    // instances of this struct are persisted in the flash memory
+    struct __attribute__((packed)) PageHeader
+    {
+        // Same values as the EEPROMEmulation page statuses
+        static const uint32_t ERASED   = 0xFFFFFFFF;
+        static const uint32_t ACTIVE   = 0xFFFF0000;
+        static const uint32_t INACTIVE = 0xCCCC0000;
+
+        uint32_t sequence;
+        uint32_t status;
+
+        PageHeader(uint32_t sequence = ERASED, uint32_t status = ERASED)
+            : sequence(sequence), status(status)
+        {
+        }
+    };
+
+    // A record stores the value of 1 byte in the emulated EEPROM
+    //
+    // WARNING: Do not change the size of struct or order of elements since
+    // instances of this struct are persisted in the flash memory
+    struct __attribute__((packed)) Record
+    {
+        static const Index EMPTY_INDEX = 0xFFFF;
+        static const uint8_t VALID = 0;
+
+        Data data;
+        uint8_t status;
+        Index index;
+
+        Record(Address index, Data data)
+            : data(data), status(VALID), index(index)
+        {
+        }
+
+        Record()
+            : data(FLASH_ERASED), status(FLASH_ERASED), index(EMPTY_INDEX)
+        {
+        }
+
+        bool empty() const
+        {
+            return index == EMPTY_INDEX &&
+                status == FLASH_ERASED &&
+                data == FLASH_ERASED;
+        }
+
+        bool valid() const
+        {
+            return index != EMPTY_INDEX && status == VALID;
+        }
+    };
+
+    static constexpr size_t RecordsPerPage = (PageSize - sizeof(PageHeader)) / sizeof(Record);
+
+    // Free pages kept so a compaction always has somewhere to copy to
+    static const uint8_t ReservePages = 1;
+
+    /* Public API */
+
+    // Initialize the EEPROM pages
+    // Call at boot
+    void init()
+    {
+        updateLog();
+
+        if(logLength == 0)
+        {
+            clear();
+        }
+        else if(getFreePageCount() == 0)
+        {
+            // A reset interrupted a compaction after it took the reserve
+            dropHead();
+        }
+    }
+
+    // Read the latest value of a byte of EEPROM in data or 0xFF if the
+    // value was not programmed
+    void get(Index index, Data &data)
+    {
+        readRange(index, &data, sizeof(data));
+    }
+
+    // Reads the latest valid values of a block of EEPROM into data.
+    // Fills data with 0xFF for values that were not programmed
+    void get(Index index, void *data, uint16_t length)
+    {
+        readRange(index, (Data *)data, length);
+    }
+
+    // Writes a new value for a byte of EEPROM
+    void put(Index index, Data data)
+    {
+        writeRange(index, &data, sizeof(data));
+    }
+
+    // Writes new values for a block of EEPROM
+    // The write will be atomic (all or nothing) even if a reset occurs
+    // during the write
+    void put(Index index, const void *data, uint16_t length)
+    {
+        writeRange(index, (Data *)data, length);
+    }
+
+    // Destroys all the data 💣
+    void clear()
+    {
+        for(Page page = 0; page < PageCount; page++)
+        {
+            erasePage(page);
+        }
+
+        logLength = 0;
+        nextSequence = 0;
+        openPage(0);
+    }
+
+    // Returns number of bytes that can be stored in EEPROM
+    constexpr size_t capacity()
+    {
+        return ((PageCount - 1 - ReservePages) * RecordsPerPage / 2 < RecordsPerPage) ?
+            (PageCount - 1 - ReservePages) * RecordsPerPage / 2 : RecordsPerPage;
+    }
+
+    // Check if an old page needs to be erased
+    bool hasPendingErase()
+    {
+        return getPendingErasePage() < PageCount;
+    }
+
+    // Erases one old page, the next one the ring will use
+    // Let the user application call this when convenient since erasing
+    // Flash freezes the application
+    void performPendingErase()
+    {
+        Page page = getPendingErasePage();
+        if(page < PageCount)
+        {
+            erasePage(page);
+        }
+    }
+
+    /* Implementation */
+
+    // Start address of the page
+    Address getPageBegin(Page page)
+    {
+        return PageBase + page * PageSize;
+    }
+
+    // End address (1 past the end) of the page
+    Address getPageEnd(Page page)
+    {
+        return getPageBegin(page) + PageSize;
+    }
+
+    const PageHeader &readPageHeader(Page page)
+    {
+        return *(const PageHeader *) store.dataAt(getPageBegin(page));
+    }
+
+    // Update the status of a page
+    bool writePageStatus(Page page, uint32_t status)
+    {
+        return store.write(getPageBegin(page) + offsetof(PageHeader, status),
+                &status, sizeof(status)) == 0;
+    }
+
+    // Rebuild the log from the active pages, oldest first, and find
+    // where the head can be written to
+    void updateLog()
+    {
+        logLength = 0;
+        nextSequence = 0;
+
+        for(Page page = 0; page < PageCount; page++)
+        {
+            const PageHeader &header = readPageHeader(page);
+            if(header.status != PageHeader::ACTIVE)
+            {
+                continue;
+            }
+
+            // Insertion sort by sequence number
+            Page position = logLength++;
+            while(position > 0 && readPageHeader(log[position - 1]).sequence > header.sequence)
+            {
+                log[position] = log[position - 1];
+                position--;
+            }
+            log[position] = page;
+
+            if(header.sequence >= nextSequence)
+            {
+                nextSequence = header.sequence + 1;
+            }
+        }
+
+        if(logLength > 0)
+        {
+            updateHead();
+        }
+    }
+
+    // Find the first empty record of the head. The head can't be
+    // written to if there are invalid records before it
+    void updateHead()
+    {
+        Page head = getHeadPage();
+        headEmptyAddress = getPageEnd(head);
+        headWritable = true;
+
+        forEachRecord(head, [&](Address address, const Record &record) -> bool
+        {
+            if(record.empty())
+            {
+                headEmptyAddress = address;
+                return true;
+            }
+            else if(record.valid())
+            {
+                return false;
+            }
+            else
+            {
+                headWritable = false;
+                return true;
+            }
+        });
+    }
+
+    Page getHeadPage()
+    {
+        return log[logLength - 1];
+    }
+
+    Page getTailPage()
+    {
+        return log[0];
+    }
+
+    bool isInLog(Page page)
+    {
+        for(Page i = 0; i < logLength; i++)
+        {
+            if(log[i] == page)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Page getFreePageCount()
+    {
+        return PageCount - logLength;
+    }
+
+    // The page after the head in the ring that is not in the log, or
+    // PageCount if all pages are in use
+    Page getNextFreePage()
+    {
+        Page page = (logLength > 0) ? getHeadPage() : PageCount - 1;
+        for(Page i = 0; i < PageCount; i++)
+        {
+            page = (page + 1) % PageCount;
+            if(!isInLog(page))
+            {
+                return page;
+            }
+        }
+        return PageCount;
+    }
+
+    // The next free page of the ring that was not erased yet, or
+    // PageCount if there is none
+    Page getPendingErasePage()
+    {
+        Page page = (logLength > 0) ? getHeadPage() : PageCount - 1;
+        for(Page i = 0; i < PageCount; i++)
+        {
+            page = (page + 1) % PageCount;
+            if(!isInLog(page))
+            {
+                const PageHeader &header = readPageHeader(page);
+                if(header.sequence != PageHeader::ERASED || header.status != PageHeader::ERASED)
+                {
+                    return page;
+                }
+            }
+        }
+        return PageCount;
+    }
+
+    // Make a free page the new head of the log. Erase it first if it
+    // is not already erased
+    bool openPage(Page page)
+    {
+        if(page >= PageCount)
+        {
+            return false;
+        }
+
+        // loop protects against marginal erase like the page swap of
+        // EEPROMEmulation
+        for(int tries = 0; tries < 2; tries++)
+        {
+            if(tries > 0 || !verifyPage(page))
+            {
+                erasePage(page);
+            }
+
+            PageHeader header(nextSequence, PageHeader::ACTIVE);
+            if(store.write(getPageBegin(page), &header, sizeof(header)) == 0)
+            {
+                nextSequence++;
+                log[logLength++] = page;
+                headEmptyAddress = getPageBegin(page) + sizeof(PageHeader);
+                headWritable = true;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Drop a head opened by a compaction that did not complete. It only
+    // holds copies of records that are still in the tail
+    void dropHead()
+    {
+        writePageStatus(getHeadPage(), PageHeader::INACTIVE);
+        logLength--;
+        updateHead();
+    }
+
+    // Open a new head for a write, compacting the tail first as long as
+    // that would leave fewer free pages than the reserve
+    bool openNewHead()
+    {
+        for(int tries = 0; getFreePageCount() <= ReservePages; tries++)
+        {
+            if(tries >= 2 * PageCount || !compactTail())
+            {
+                return false;
+            }
+        }
+
+        return openPage(getNextFreePage());
+    }
+
+    // Copy the records of the tail that are still current to the head
+    // and drop the tail from the log. The page will be erased later
+    bool compactTail()
+    {
+        if(logLength < 2)
+        {
+            return false;
+        }
+
+        Page tail = getTailPage();
+        bool success = true;
+
+        forEachCurrentRecord(tail, [&](const Record &record)
+        {
+            Data data = record.data;
+            Data erased = FLASH_ERASED;
+
+            // Records are copied one by one since they already are the
+            // latest values: a reset can't tear a multi-byte write
+            if(success && !writeRangeChanged(record.index, &data, &erased, 1))
+            {
+                success = openPage(getNextFreePage()) &&
+                    writeRangeChanged(record.index, &data, &erased, 1);
+            }
+        });
+
+        // The tail only stops counting once everything is copied
+        success = success && writePageStatus(tail, PageHeader::INACTIVE);
+
+        if(success)
+        {
+            logLength--;
+            std::memmove(&log[0], &log[1], logLength * sizeof(log[0]));
+        }
+        else if(getFreePageCount() == 0)
+        {
+            // Give the reserve back
+            dropHead();
+        }
+
+        return success;
+    }
+
+    void readRange(Index indexBegin, Data *data, uint16_t length)
+    {
+        std::memset(data, FLASH_ERASED, length);
+
+        // Walk the log oldest first so the latest records win
+        Index indexEnd = indexBegin + length;
+        for(Page i = 0; i < logLength; i++)
+        {
+            forEachValidRecord(log[i], [=](Address address, const Record &record)
+            {
+                if(record.index >= indexBegin && record.index < indexEnd)
+                {
+                    data[record.index - indexBegin] = record.data;
+                }
+            });
+        }
+    }
+
+    // Write each byte in the range if its value has changed.
+    void writeRange(Index indexBegin, const Data *data, uint16_t length)
+    {
+        // don't write anything if index is out of range
+        Index indexEnd = indexBegin + length;
+        if(indexEnd > capacity() || logLength == 0)
+        {
+            return;
+        }
+
+        // Read existing values for range
+        std::unique_ptr<Data[]> existingData(new Data[length]);
+        // don't write anything if memory is full
+        if(!existingData)
+        {
+            return;
+        }
+
+        readRange(indexBegin, existingData.get(), length);
+
+        // If the head is full, has invalid records or a write failed
+        // verification, write all the records to a new head
+        if(!writeRangeChanged(indexBegin, data, existingData.get(), length))
+        {
+            if(openNewHead())
+            {
+                writeRangeChanged(indexBegin, data, existingData.get(), length);
+            }
+        }
+    }
+
+    // Write new records backwards in the head. This ensures data
+    // consistency if writeRange is interrupted by a reset since reads
+    // stop at the first non-valid record.
+    bool writeRangeChanged(Index indexBegin, const Data *data, const Data *existingData, uint16_t length)
+    {
+        // Count changed values
+        uint16_t changedCount = 0;
+        for(uint16_t i = 0; i < length; i++)
+        {
+            if(existingData[i] != data[i])
+            {
+                changedCount++;
+            }
+        }
+
+        if(changedCount == 0)
+        {
+            return true;
+        }
+
+        if(!headWritable)
+        {
+            return false;
+        }
+
+        Address writeAddress = headEmptyAddress + changedCount * sizeof(Record);
+        Address endAddress = getPageEnd(getHeadPage());
+        if(writeAddress > endAddress)
+        {
+            return false;
+        }
+
+        // There must be an empty record after the last record as a
+        // separator for the valid record detection to work
+        bool success = true;
+        if(writeAddress < endAddress)
+        {
+            Record separatorRecord;
+            store.read(writeAddress, &separatorRecord, sizeof(separatorRecord));
+
+            success = separatorRecord.empty();
+        }
+
+        for(uint16_t i = 0; i < length && success; i++)
+        {
+            if(existingData[i] != data[i])
+            {
+                Record record(indexBegin + i, data[i]);
+                writeAddress -= sizeof(Record);
+                success = store.write(writeAddress, &record, sizeof(record)) >= 0;
+            }
+        }
+
+        if(success)
+        {
+            headEmptyAddress += changedCount * sizeof(Record);
+        }
+        else
+        {
+            headWritable = false;
+        }
+        return success;
+    }
+
+    // Iterate through a page and yield each record, including valid
+    // and invalid records, and the empty record at the end (if there is
+    // room)
+    template <typename Func>
+    void forEachRecord(Page page, Func f)
+    {
+        Address address = getPageBegin(page) + sizeof(PageHeader);
+        Address endAddress = getPageEnd(page);
+
+        while(address + sizeof(Record) <= endAddress)
+        {
+            const Record &record = *(const Record *) store.dataAt(address);
+
+            // Yield record and potentially break early
+            if(f(address, record))
+            {
+                return;
+            }
+
+            address += sizeof(record);
+        }
+    }
+
+    // Iterate through a page and yield each valid record,
+    // ignoring any records after the first invalid one
+    template <typename Func>
+    void forEachValidRecord(Page page, Func f)
+    {
+        forEachRecord(page, [=](Address address, const Record &record) -> bool
+        {
+            if(record.valid())
+            {
+                f(address, record);
+                return false;
+            }
+            else
+            {
+                return true;
+            }
+        });
+    }
+
+    // Iterate through a page of the log and yield the latest record of
+    // each index that no newer page overrides, skipping 0xFF values
+    template <typename Func>
+    void forEachCurrentRecord(Page page, Func f)
+    {
+        // Batch the indexes like EEPROMEmulation::forEachUniqueValidRecord,
+        // keeping only address offsets to save heap space
+        using AddressOffset = uint16_t;
+        static_assert(PageSize <= std::numeric_limits<AddressOffset>::max() + 1,
+            "PageSize doesn't fit in AddressOffset. "
+            "Make pages smaller or AddressOffset a larger data type");
+
+        const uint32_t BatchSize = 128;
+        std::vector<AddressOffset> recordAddresses;
+
+        Address baseAddress = getPageBegin(page);
+        uint32_t firstIndex = 0;
+        const uint32_t NoIndex = std::numeric_limits<uint32_t>::max();
+
+        while(firstIndex != NoIndex)
+        {
+            recordAddresses.assign(BatchSize, 0);
+            uint32_t lastIndex = firstIndex + BatchSize;
+
+            // The next batch starts at the next index in use, skipping
+            // over gaps such as the high indexes of torn records
+            uint32_t nextIndex = NoIndex;
+
+            forEachValidRecord(page, [&](Address address, const Record &record)
+            {
+                if(record.index >= firstIndex && record.index < lastIndex)
+                {
+                    recordAddresses[record.index - firstIndex] = address - baseAddress;
+                }
+                else if(record.index >= lastIndex && record.index < nextIndex)
+                {
+                    nextIndex = record.index;
+                }
+            });
+
+            // Drop the indexes written again in a newer page
+            bool newer = false;
+            for(Page i = 0; i < logLength; i++)
+            {
+                if(newer)
+                {
+                    forEachValidRecord(log[i], [&](Address address, const Record &record)
+                    {
+                        if(record.index >= firstIndex && record.index < lastIndex)
+                        {
+                            recordAddresses[record.index - firstIndex] = 0;
+                        }
+                    });
+                }
+                newer = newer || log[i] == page;
+            }
+
+            for(auto addressOffset: recordAddresses)
+            {
+                if(addressOffset != 0)
+                {
+                    const Record &record = *(const Record *) store.dataAt(baseAddress + addressOffset);
+                    if(record.data != FLASH_ERASED)
+                    {
+                        f(record);
+                    }
+                }
+            }
+
+            firstIndex = nextIndex;
+        }
+    }
+
+    // Verify that the entire page is erased to protect against resets
+    // during page erase
+    bool verifyPage(Page page)
+    {
+        const uint8_t *begin = store.dataAt(getPageBegin(page));
+        const uint8_t *end = store.dataAt(getPageEnd(page));
+        while(begin < end)
+        {
+            if(*begin++ != FLASH_ERASED)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Reset entire page to 0xFF
+    void erasePage(Page page)
+    {
+        store.eraseSector(getPageBegin(page));
+    }
+
+    // Hardware-dependent interface to read, erase and program memory
+    Store store;
+
+protected:
+    static_assert(PageCount >= 3 && PageCount <= 255,
+        "The ring needs a head, a reserve and at least one more page");
+    static_assert(RecordsPerPage > 1, "PageSize is too small");
+
+    // Pages of the log, oldest first
+    Page log[PageCount];
+    Page logLength = 0;
+    uint32_t nextSequence = 0;
+
+    // Where the next record goes in the head page
+    Address headEmptyAddress = 0;
+    bool headWritable = false;
+};
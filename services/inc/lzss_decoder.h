@@ -0,0 +1,50 @@
+#ifndef LZSS_DECODER_H__
+#define LZSS_DECODER_H__
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define LZSS_MIN_WINDOW_BITS        4
+#define LZSS_MAX_WINDOW_BITS        15
+#define LZSS_MIN_LOOKAHEAD_BITS     3
+
+/*
+ * Streaming LZSS decoder using the heatshrink bit stream: a 1 bit is followed
+ * by an 8 bit literal, a 0 bit by a windowBits wide back-reference offset - 1
+ * and a lookaheadBits wide length - 1, all most significant bit first. Input
+ * and output may be split anywhere, the only RAM used is the window of
+ * 2^windowBits bytes. The stream has no end marker, the caller stops once it
+ * has the number of bytes it expects.
+ */
+typedef struct
+{
+    uint8_t *window;            // the last 2^windowBits bytes produced
+    uint16_t mask;
+    uint16_t head;              // next write position in window
+    uint8_t windowBits;
+    uint8_t lookaheadBits;
+    uint8_t state;
+    uint8_t current;            // input byte being read
+    uint8_t bitMask;            // next bit of current, 0 when it is used up
+    uint8_t bitCount;           // bits collected in bits
+    uint16_t bits;
+    uint16_t offset;            // back-reference being copied
+    uint16_t count;
+}LZSS_DECODER;
+
+
+extern bool lzssInitialDecoder(LZSS_DECODER * const pstDecoder, uint8_t ucWindowBits, uint8_t ucLookaheadBits);
+extern void lzssReleaseDecoder(LZSS_DECODER * const pstDecoder);
+extern uint32_t lzssDecode(LZSS_DECODER * const pstDecoder, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiUsed, uint8_t *pheOut, uint32_t uiOutLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* LZSS_DECODER_H__ */
@@ -41,6 +41,8 @@ public:
     void addHexString(String data){ addHexString(data.c_str()); }
     bool addStream(Stream & stream, const size_t maxLen);
     void calculate(void);
+    void getContext(struct MD5Context * context){ *context = _ctx; }
+    void setContext(const struct MD5Context * context){ _ctx = *context; }
     void getBytes(uint8_t * output);
     void getChars(char * output);
     String toString(void);
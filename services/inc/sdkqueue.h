@@ -17,11 +17,18 @@ extern "C"{
 
 #define SDK_MAX_QUEUE_SIZE             1024
 
+/*
+ * Byte ring buffer shared by one producer and one consumer, typically an ISR
+ * and a thread. The capacity is a power of two (sdkInitialQueue() rejects
+ * any other size) and head/tail run freely, so the producer only ever writes
+ * siTail and the consumer only ever writes siHead and neither side needs
+ * interrupts disabled.
+ */
 typedef struct
 {
-    int32_t siHead;
-    int32_t siTail;
-    uint32_t uiSize;
+    volatile uint32_t siHead;   // read position, advanced by the consumer
+    volatile uint32_t siTail;   // write position, advanced by the producer
+    uint32_t uiSize;            // capacity, a power of two
     uint8_t *heData;
 }SDK_QUEUE;
 
@@ -35,7 +42,10 @@ extern bool sdkIsQueueFull(SDK_QUEUE const * const pstQueue);
 extern bool sdkTryQueueData(const SDK_QUEUE *pstQueue , int32_t siHead , uint8_t *pucOut);
 extern int32_t sdkSetQueueHead(SDK_QUEUE * const pstQueue , int32_t siHead);
 extern bool sdkGetQueueData(SDK_QUEUE * const pstQueue, uint8_t *pucOut);
+extern int32_t sdkGetQueueBuffer(SDK_QUEUE * const pstQueue, uint8_t *pucOut, uint32_t uiLen);
+extern int32_t sdkGetQueueSpan(SDK_QUEUE * const pstQueue, uint8_t **ppucData);
 extern int32_t sdkGetQueueDataLen(SDK_QUEUE * const pstQueue);
+extern int32_t sdkGetQueueFreeLen(SDK_QUEUE * const pstQueue);
 extern int32_t sdkReleaseQueue(SDK_QUEUE * const pstQueue);
 
 #ifdef __cplusplus
@@ -0,0 +1,131 @@
+/**
+ ******************************************************************************
+ Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+#include <string.h>
+#include "delta_patch.h"
+
+void deltaInitialPatch(DELTA_PATCH * const pstPatch, delta_read_t readBase, void *context, uint32_t uiBaseSize)
+{
+    memset(pstPatch, 0, sizeof(DELTA_PATCH));
+    pstPatch->readBase = readBase;
+    pstPatch->context = context;
+    pstPatch->baseSize = uiBaseSize;
+}
+
+static inline uint32_t deltaGetU32(const uint8_t *pheField)
+{
+    return pheField[0] | (pheField[1] << 8) | (pheField[2] << 16) | ((uint32_t)pheField[3] << 24);
+}
+
+/*
+ * Collects the header of the next operation, carrying a partly read header
+ * over to the next call. Returns false while it is incomplete or invalid.
+ */
+static bool deltaGetOp(DELTA_PATCH * const pstPatch, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiPos)
+{
+    uint8_t ucNeed;
+
+    do {
+        if(*puiPos == uiInLen) {
+            return false;
+        }
+        pstPatch->field[pstPatch->fieldLen++] = pheIn[(*puiPos)++];
+        switch(pstPatch->field[0]) {
+            case DELTA_OP_COPY:
+            case DELTA_OP_ADD:
+                ucNeed = 9;
+                break;
+            case DELTA_OP_INSERT:
+                ucNeed = 5;
+                break;
+            default:
+                pstPatch->error = true;
+                return false;
+        }
+    } while(pstPatch->fieldLen < ucNeed);
+
+    if(DELTA_OP_INSERT == pstPatch->field[0]) {
+        pstPatch->offset = 0;
+        pstPatch->length = deltaGetU32(&pstPatch->field[1]);
+    } else {
+        pstPatch->offset = deltaGetU32(&pstPatch->field[1]);
+        pstPatch->length = deltaGetU32(&pstPatch->field[5]);
+        if((pstPatch->offset > pstPatch->baseSize) || (pstPatch->length > pstPatch->baseSize - pstPatch->offset)) {
+            pstPatch->error = true;
+            return false;
+        }
+    }
+    pstPatch->op = pstPatch->field[0];
+    pstPatch->fieldLen = 0;
+    return true;
+}
+
+/*
+ * Applies pheIn until it is used up or uiOutLen bytes are produced. *puiUsed
+ * is set to the input consumed, the bytes produced are returned. Once
+ * pstPatch->error is set the patch is corrupt or the base could not be read
+ * and nothing more is produced.
+ */
+uint32_t deltaApply(DELTA_PATCH * const pstPatch, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiUsed, uint8_t *pheOut, uint32_t uiOutLen)
+{
+    uint32_t uiInPos = 0, uiOutPos = 0, uiLen, i;
+
+    while(!pstPatch->error && (uiOutPos < uiOutLen)) {
+        if(0 == pstPatch->length) {
+            pstPatch->op = 0;
+            if(!deltaGetOp(pstPatch, pheIn, uiInLen, &uiInPos)) {
+                break;
+            }
+            continue;
+        }
+
+        uiLen = uiOutLen - uiOutPos;
+        if(uiLen > pstPatch->length) {
+            uiLen = pstPatch->length;
+        }
+        if(DELTA_OP_COPY != pstPatch->op) {
+            if(uiLen > uiInLen - uiInPos) {
+                uiLen = uiInLen - uiInPos;
+            }
+            if(0 == uiLen) {
+                break;
+            }
+        }
+
+        if(DELTA_OP_INSERT == pstPatch->op) {
+            memcpy(pheOut + uiOutPos, pheIn + uiInPos, uiLen);
+            uiInPos += uiLen;
+        } else {
+            if(0 != pstPatch->readBase(pstPatch->context, pstPatch->offset, pheOut + uiOutPos, uiLen)) {
+                pstPatch->error = true;
+                break;
+            }
+            if(DELTA_OP_ADD == pstPatch->op) {
+                for(i = 0; i < uiLen; i++) {
+                    pheOut[uiOutPos + i] += pheIn[uiInPos + i];
+                }
+                uiInPos += uiLen;
+            }
+            pstPatch->offset += uiLen;
+        }
+        pstPatch->length -= uiLen;
+        uiOutPos += uiLen;
+    }
+    *puiUsed = uiInPos;
+    return uiOutPos;
+}
@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation, either
+ version 3 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "lzss_decoder.h"
+
+enum {
+    LZSS_STATE_TAG,
+    LZSS_STATE_LITERAL,
+    LZSS_STATE_OFFSET,
+    LZSS_STATE_COUNT,
+};
+
+bool lzssInitialDecoder(LZSS_DECODER * const pstDecoder, uint8_t ucWindowBits, uint8_t ucLookaheadBits)
+{
+    if((ucWindowBits < LZSS_MIN_WINDOW_BITS) || (ucWindowBits > LZSS_MAX_WINDOW_BITS)
+            || (ucLookaheadBits < LZSS_MIN_LOOKAHEAD_BITS) || (ucLookaheadBits >= ucWindowBits)) {
+        return false;
+    }
+
+    memset(pstDecoder, 0, sizeof(LZSS_DECODER));
+    // the window starts out as zeros, as it does for the encoder
+    pstDecoder->window = (uint8_t *)calloc(1, 1 << ucWindowBits);
+    if(NULL == pstDecoder->window) {
+        return false;
+    }
+    pstDecoder->mask = (1 << ucWindowBits) - 1;
+    pstDecoder->windowBits = ucWindowBits;
+    pstDecoder->lookaheadBits = ucLookaheadBits;
+    pstDecoder->state = LZSS_STATE_TAG;
+    return true;
+}
+
+void lzssReleaseDecoder(LZSS_DECODER * const pstDecoder)
+{
+    free(pstDecoder->window);
+    pstDecoder->window = NULL;
+}
+
+/*
+ * Collects ucCount bits, carrying a partly read field over to the next call.
+ * Returns -1 when the input runs out first.
+ */
+static int32_t lzssGetBits(LZSS_DECODER * const pstDecoder, uint8_t ucCount, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiPos)
+{
+    int32_t siBits;
+
+    while(pstDecoder->bitCount < ucCount) {
+        if(0 == pstDecoder->bitMask) {
+            if(*puiPos == uiInLen) {
+                return -1;
+            }
+            pstDecoder->current = pheIn[(*puiPos)++];
+            pstDecoder->bitMask = 0x80;
+        }
+        pstDecoder->bits <<= 1;
+        if(pstDecoder->current & pstDecoder->bitMask) {
+            pstDecoder->bits |= 1;
+        }
+        pstDecoder->bitMask >>= 1;
+        pstDecoder->bitCount++;
+    }
+    siBits = pstDecoder->bits;
+    pstDecoder->bits = 0;
+    pstDecoder->bitCount = 0;
+    return siBits;
+}
+
+static inline void lzssEmit(LZSS_DECODER * const pstDecoder, uint8_t ucByte, uint8_t *pheOut, uint32_t *puiPos)
+{
+    pheOut[(*puiPos)++] = ucByte;
+    pstDecoder->window[pstDecoder->head++ & pstDecoder->mask] = ucByte;
+}
+
+/*
+ * Decodes from pheIn until it is used up or uiOutLen bytes are produced.
+ * *puiUsed is set to the input consumed, the bytes produced are returned.
+ */
+uint32_t lzssDecode(LZSS_DECODER * const pstDecoder, const uint8_t *pheIn, uint32_t uiInLen, uint32_t *puiUsed, uint8_t *pheOut, uint32_t uiOutLen)
+{
+    uint32_t uiInPos = 0, uiOutPos = 0;
+    int32_t siBits;
+
+    while(uiOutPos < uiOutLen) {
+        if(pstDecoder->count) {
+            lzssEmit(pstDecoder, pstDecoder->window[(pstDecoder->head - pstDecoder->offset) & pstDecoder->mask], pheOut, &uiOutPos);
+            pstDecoder->count--;
+            continue;
+        }
+
+        switch(pstDecoder->state) {
+            case LZSS_STATE_TAG:
+                siBits = lzssGetBits(pstDecoder, 1, pheIn, uiInLen, &uiInPos);
+                if(siBits >= 0) {
+                    pstDecoder->state = siBits ? LZSS_STATE_LITERAL : LZSS_STATE_OFFSET;
+                }
+                break;
+            case LZSS_STATE_LITERAL:
+                siBits = lzssGetBits(pstDecoder, 8, pheIn, uiInLen, &uiInPos);
+                if(siBits >= 0) {
+                    lzssEmit(pstDecoder, siBits, pheOut, &uiOutPos);
+                    pstDecoder->state = LZSS_STATE_TAG;
+                }
+                break;
+            case LZSS_STATE_OFFSET:
+                siBits = lzssGetBits(pstDecoder, pstDecoder->windowBits, pheIn, uiInLen, &uiInPos);
+                if(siBits >= 0) {
+                    pstDecoder->offset = siBits + 1;
+                    pstDecoder->state = LZSS_STATE_COUNT;
+                }
+                break;
+            default:
+                siBits = lzssGetBits(pstDecoder, pstDecoder->lookaheadBits, pheIn, uiInLen, &uiInPos);
+                if(siBits >= 0) {
+                    pstDecoder->count = siBits + 1;
+                    pstDecoder->state = LZSS_STATE_TAG;
+                }
+                break;
+        }
+        if(siBits < 0) {
+            break;
+        }
+    }
+    *puiUsed = uiInPos;
+    return uiOutPos;
+}
@@ -20,31 +20,41 @@
 #include <string.h>
 #include "sdkqueue.h"
 
+// orders the data copy against the index update seen by the other side
+#define SDK_QUEUE_BARRIER()     __sync_synchronize()
+
+/*
+ * The size must be a power of two, other sizes are rejected rather than
+ * rounded so a queue never takes more memory than its caller asked for.
+ */
 int32_t sdkInitialQueue(SDK_QUEUE * const pstQueue, uint32_t uiQueueSize)
 {
-    if((pstQueue == NULL)||(uiQueueSize == 0)) {
+    if(pstQueue == NULL) {
         return SDK_PARA_ERR;
     }
     memset(pstQueue , 0 , sizeof(*pstQueue));
+    if((uiQueueSize == 0) || (uiQueueSize & (uiQueueSize - 1))) {
+        return SDK_PARA_ERR;
+    }
     pstQueue->uiSize = uiQueueSize;
-    pstQueue->heData = malloc(uiQueueSize);
+    pstQueue->heData = malloc(pstQueue->uiSize);
     if(pstQueue->heData == NULL) {
+        pstQueue->uiSize = 0;
         return SDK_PARA_ERR;
     } else {
         return SDK_OK;
     }
 }
 
+/*
+ * Drops all queued data. Called from the consumer side.
+ */
 int32_t sdkClearQueue(SDK_QUEUE * const pstQueue)
 {
     if(pstQueue == NULL) {
         return SDK_PARA_ERR;
     }
-    pstQueue->siHead = 0;
-    pstQueue->siTail = 0;
-    if(pstQueue->heData != NULL) {
-        memset(pstQueue->heData , 0 , pstQueue->uiSize);
-    }
+    pstQueue->siHead = pstQueue->siTail;
     return SDK_OK;
 }
 
@@ -63,60 +73,60 @@ bool sdkIsQueueFull(SDK_QUEUE const * const pstQueue)
         //Assert(0);
         return true;
     }
-
-    if(pstQueue->siHead == ((pstQueue->siTail + 1) % pstQueue->uiSize)) {
-        return true;
-    } else {
-        return false;
-    }
+    return ((pstQueue->siTail - pstQueue->siHead) == pstQueue->uiSize);
 }
 
+/*
+ * Copies as much of phe as fits, in at most two blocks. Called from the
+ * producer side. Returns the number of bytes queued.
+ */
 int32_t sdkInsertQueue(SDK_QUEUE *  pstQueue ,const uint8_t *phe , uint32_t siLen)
 {
-    int32_t uii;
+    uint32_t uiTail, uiOffset, uiFirst, uiFree;
 
-    if(pstQueue == NULL || phe == NULL || siLen <= 0 ) {
+    if(pstQueue == NULL || phe == NULL || pstQueue->heData == NULL) {
         return SDK_PARA_ERR;
     }
 
-    for(uii = 0; uii < siLen; uii++) {
-        if( !sdkIsQueueFull(pstQueue) ) {
-            pstQueue->heData[pstQueue->siTail] = phe[uii];
-            pstQueue->siTail = (pstQueue->siTail + 1) % pstQueue->uiSize;
-        } else {
-            //Assert(0);
-            break;
-        }
+    if(siLen == 0) {
+        return 0;
+    }
+
+    uiTail = pstQueue->siTail;
+    uiFree = pstQueue->uiSize - (uiTail - pstQueue->siHead);
+    if(siLen > uiFree) {
+        siLen = uiFree;
     }
-    return uii;
+
+    uiOffset = uiTail & (pstQueue->uiSize - 1);
+    uiFirst = pstQueue->uiSize - uiOffset;
+    if(uiFirst > siLen) {
+        uiFirst = siLen;
+    }
+    memcpy(&pstQueue->heData[uiOffset], phe, uiFirst);
+    memcpy(pstQueue->heData, phe + uiFirst, siLen - uiFirst);
+
+    SDK_QUEUE_BARRIER();
+    pstQueue->siTail = uiTail + siLen;
+    return siLen;
 }
 
+/*
+ * Moves the read position to siHead, which must lie between the current
+ * head and tail. Called from the consumer side.
+ */
 int32_t sdkSetQueueHead(SDK_QUEUE * const pstQueue , int32_t siHead)
 {
-    if(siHead >= pstQueue->uiSize || NULL == pstQueue || siHead < 0 ) {
+    if(NULL == pstQueue) {
         //Assert(0);
         return SDK_PARA_ERR;
     }
 
-    siHead =  siHead % pstQueue->uiSize;  //lint !e539
-
-    if( !sdkIsQueueEmpty(pstQueue) ) {
-        if(pstQueue->siHead < pstQueue->siTail) {
-            if(siHead >= pstQueue->siHead &&  siHead <= pstQueue->siTail) {
-                pstQueue->siHead = siHead;
-            } else {
-                sdkClearQueue(pstQueue);
-                return SDK_ERR;
-            }
-        } else {
-            if(siHead >= pstQueue->siHead || siHead <= pstQueue->siTail) {
-                pstQueue->siHead = siHead;
-            } else {
-                sdkClearQueue(pstQueue);
-                return SDK_ERR;
-            }
-        }
+    if(((uint32_t)siHead - pstQueue->siHead) > (pstQueue->siTail - pstQueue->siHead)) {
+        sdkClearQueue(pstQueue);
+        return SDK_ERR;
     }
+    pstQueue->siHead = siHead;
     return SDK_OK;
 }
 
@@ -127,47 +137,86 @@ int32_t sdkGetQueueHead(SDK_QUEUE const* const pstQueue)
 
 bool sdkTryQueueData(const SDK_QUEUE *pstQueue , int32_t siHead , uint8_t *pucOut)
 {
-    siHead = siHead % pstQueue->uiSize;
-
-    if( !sdkIsQueueEmpty(pstQueue) ) {
-        if(pstQueue->siHead < pstQueue->siTail) {
-            if(siHead >= pstQueue->siHead &&  siHead < pstQueue->siTail) {
-                *pucOut = pstQueue->heData[siHead];
-                return true;
-            }
-        } else {
-            if(siHead >= pstQueue->siHead || siHead < pstQueue->siTail) {
-                *pucOut = pstQueue->heData[siHead];
-                return true;
-            }
-        }
+    if(((uint32_t)siHead - pstQueue->siHead) < (pstQueue->siTail - pstQueue->siHead)) {
+        *pucOut = pstQueue->heData[(uint32_t)siHead & (pstQueue->uiSize - 1)];
+        return true;
     }
     return false;
 }
 
 bool sdkGetQueueData(SDK_QUEUE * const pstQueue, uint8_t *pucOut)
 {
-    if( !sdkIsQueueEmpty(pstQueue) ) {
-        *pucOut = pstQueue->heData[pstQueue->siHead];
-        pstQueue->siHead = (pstQueue->siHead + 1) % pstQueue->uiSize;
-        return true;
+    return sdkGetQueueBuffer(pstQueue, pucOut, 1) == 1;
+}
+
+/*
+ * Copies up to uiLen queued bytes to pucOut, in at most two blocks. Called
+ * from the consumer side. Returns the number of bytes read.
+ */
+int32_t sdkGetQueueBuffer(SDK_QUEUE * const pstQueue, uint8_t *pucOut, uint32_t uiLen)
+{
+    uint32_t uiHead, uiOffset, uiFirst, uiUsed;
+
+    if(pstQueue == NULL || pucOut == NULL) {
+        return 0;
     }
-    return false;
+
+    uiHead = pstQueue->siHead;
+    uiUsed = pstQueue->siTail - uiHead;
+    if(uiLen > uiUsed) {
+        uiLen = uiUsed;
+    }
+    if(uiLen == 0) {
+        return 0;
+    }
+    SDK_QUEUE_BARRIER();
+
+    uiOffset = uiHead & (pstQueue->uiSize - 1);
+    uiFirst = pstQueue->uiSize - uiOffset;
+    if(uiFirst > uiLen) {
+        uiFirst = uiLen;
+    }
+    memcpy(pucOut, &pstQueue->heData[uiOffset], uiFirst);
+    memcpy(pucOut + uiFirst, pstQueue->heData, uiLen - uiFirst);
+
+    SDK_QUEUE_BARRIER();
+    pstQueue->siHead = uiHead + uiLen;
+    return uiLen;
 }
 
-int32_t sdkGetQueueDataLen(SDK_QUEUE * const pstQueue)
+/*
+ * Points *ppucData at the oldest queued byte and returns how many bytes follow
+ * it without wrapping, so a consumer such as a DMA can read them in place and
+ * release them afterwards with sdkSetQueueHead. Called from the consumer side.
+ */
+int32_t sdkGetQueueSpan(SDK_QUEUE * const pstQueue, uint8_t **ppucData)
 {
-    int32_t uii;
+    uint32_t uiHead, uiOffset, uiUsed;
 
-    if( !sdkIsQueueEmpty(pstQueue) ) {
-        if(pstQueue->siHead < pstQueue->siTail) {
-            uii = pstQueue->siTail - pstQueue->siHead;
-        } else {
-            uii = pstQueue->siTail + SDK_MAX_QUEUE_SIZE - pstQueue->siHead;
-        }
-        return uii;
+    if(pstQueue == NULL || ppucData == NULL || pstQueue->heData == NULL) {
+        return 0;
     }
-    return 0;
+
+    uiHead = pstQueue->siHead;
+    uiUsed = pstQueue->siTail - uiHead;
+    SDK_QUEUE_BARRIER();
+
+    uiOffset = uiHead & (pstQueue->uiSize - 1);
+    if(uiUsed > pstQueue->uiSize - uiOffset) {
+        uiUsed = pstQueue->uiSize - uiOffset;
+    }
+    *ppucData = &pstQueue->heData[uiOffset];
+    return uiUsed;
+}
+
+int32_t sdkGetQueueDataLen(SDK_QUEUE * const pstQueue)
+{
+    return pstQueue->siTail - pstQueue->siHead;
+}
+
+int32_t sdkGetQueueFreeLen(SDK_QUEUE * const pstQueue)
+{
+    return pstQueue->uiSize - (pstQueue->siTail - pstQueue->siHead);
 }
 
 int32_t sdkReleaseQueue(SDK_QUEUE * const pstQueue)
@@ -181,4 +230,3 @@ int32_t sdkReleaseQueue(SDK_QUEUE * const pstQueue)
     memset(pstQueue , 0 , sizeof(*pstQueue));
     return SDK_OK;
 }
-
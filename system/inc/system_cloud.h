@@ -125,6 +125,7 @@ String intorobot_deviceID(void);
 void intorobot_process(void);
 bool intorobot_sync_time(void);
 bool intorobot_device_register(char *prodcut_id, time_t utc_time, char *signature);
+void intorobot_http_session_stop(void);
 bool intorobot_get_version(String &body);
 void cloud_disconnect(bool controlRGB=true);
 
@@ -15,6 +15,7 @@ typedef void(*sysTick_handler)(void);
 extern sysTick_handler _sysTickHandler; //system tick 回调
 
 void system_process_loop(void);
+void system_perform_pending_erase(uint8_t max_pages);
 void ui_process_loop(void);
 
 uint32_t HAL_NET_SetNetWatchDog(uint32_t timeOutInuS);
@@ -52,6 +53,7 @@ void system_delay_ms(unsigned long ms, bool force_no_background_loop);
 void SetSysTickHandler(sysTick_handler handler);
 
 #define INTOROBOT_LOOP_DELAY_MILLIS                 1000    //1sec
+#define SYSTEM_SLEEP_ERASE_MAX_PAGES                16      //休眠前最多擦除的页数
 
 #ifdef __cplusplus
 }
@@ -4,6 +4,8 @@
 
 #include "intorobot_config.h"
 #include "md5_builder.h"
+#include "lzss_decoder.h"
+#include "delta_patch.h"
 #include "wiring_ticks.h"
 #include "wiring_httpclient.h"
 
@@ -33,9 +35,55 @@ void system_lineCodingBitRateHandler(uint32_t bitrate);
 #define UPDATE_ERROR_SIZE               (5)
 #define UPDATE_ERROR_STREAM             (6)
 #define UPDATE_ERROR_MD5                (7)
+#define UPDATE_ERROR_COMPRESS           (8)
+#define UPDATE_ERROR_BASE               (9)
+#define UPDATE_ERROR_PATCH              (10)
 
 
 #define UPDATE_SECTOR_SIZE              0x1000
+#define UPDATE_CHECKPOINT_SECTORS       8       // save a checkpoint every 8 sectors
+#define UPDATE_CHECKPOINT_MAGIC         0x5aa5c0de
+
+/*
+  Progress of an interrupted update, kept by the HAL across resets
+*/
+typedef struct {
+    uint32_t magic;
+    uint32_t startAddress;
+    uint32_t size;
+    uint32_t offset;            // bytes programmed, all of them in ctx
+    char md5[33];               // expected MD5 of the whole image
+    struct MD5Context ctx;      // running MD5 of the first offset bytes
+} update_checkpoint_t;
+
+#define UPDATE_INPUT_SIZE               256     // compressed bytes read from the stream at a time
+#define UPDATE_COMPRESS_MAGIC           0x5a4f5249  // "IROZ"
+#define UPDATE_COMPRESS_LZSS            1
+
+/*
+  Header in front of a compressed image, made by tools/ota_compress.py
+*/
+typedef struct {
+    uint32_t magic;
+    uint8_t algorithm;
+    uint8_t windowBits;
+    uint8_t lookaheadBits;
+    uint8_t reserved;
+    uint32_t size;              // size of the image once decompressed
+    uint8_t md5[16];            // MD5 of the image once decompressed
+} update_compress_header_t;
+
+#define UPDATE_DELTA_MAGIC              0x444f5249  // "IROD"
+
+/*
+  Header in front of a patch against the running application, made by
+  tools/ota_delta.py. The operations that follow are compressed as image says
+*/
+typedef struct {
+    update_compress_header_t image;     // size and MD5 of the patched image
+    uint32_t baseSize;                  // size of the image the patch applies to
+    uint8_t baseMd5[16];                // MD5 of that image
+} update_delta_header_t;
 
 typedef void (*progressCb)(uint8_t);
 
@@ -60,6 +108,8 @@ public:
       Returns the bytes written
       Should be equal to the remaining bytes when called
       Usable for slow streams like Serial
+      Data is received into one sector buffer while the other full
+      sector waits to be programmed when the stream has nothing to read
     */
     size_t writeStream(Stream &data);
 
@@ -75,6 +125,24 @@ public:
     */
     bool end(bool evenIfRemaining = false);
 
+    /*
+      Returns the offset an interrupted update of the image at startAddress
+      can continue from and fills in its size and expected MD5
+      Returns 0 if there is nothing to resume
+    */
+    size_t checkpoint(uint32_t startAddress, size_t *size, char *md5);
+
+    /*
+      Call after begin() and setMD5() with the values from checkpoint()
+      to skip the first offset bytes that are already in flash
+    */
+    bool resume(size_t offset);
+
+    /*
+      Drops the checkpoint so the next update starts from byte 0
+    */
+    void clearCheckpoint();
+
     /*
       Prints the last error to an output stream
     */
@@ -85,6 +153,23 @@ public:
     */
     bool setMD5(const char * expected_md5);
 
+    /*
+      Call after begin() with the decompressed size when the data that
+      follows is a compressed image, it is then decompressed by write()
+      and writeStream() on its way to the flash
+      Also sets the expected MD5 from the header
+    */
+    bool setCompression(const update_compress_header_t *header);
+
+    /*
+      Like setCompression() for a patch against the running application
+      Fails with UPDATE_ERROR_BASE when the application is not the one
+      the patch was made for, then the full image is needed instead
+      The patch is applied by write() and writeStream() reading the
+      unchanged parts from the application region
+    */
+    bool setDelta(const update_delta_header_t *header);
+
     /*
       sets the the progress display call back for the update
     */
@@ -115,11 +200,12 @@ public:
       available() and read(uint8_t*, size_t) methods
       faster than the writeStream method
       writes only what is available
+      Raw images only
     */
     template<typename T>
     size_t write(T &data){
         size_t written = 0;
-        if (hasError() || !isRunning())
+        if (hasError() || !isRunning() || _decoder)
             return 0;
 
         size_t available = data.available();
@@ -130,12 +216,14 @@ public:
             if(_bufferLen + available > UPDATE_SECTOR_SIZE) {
                 size_t toBuff = UPDATE_SECTOR_SIZE - _bufferLen;
                 data.read(_buffer + _bufferLen, toBuff);
+                _md5.add(_buffer + _bufferLen, toBuff);
                 _bufferLen += toBuff;
                 if(!_writeBuffer())
                     return written;
                 written += toBuff;
             } else {
                 data.read(_buffer + _bufferLen, available);
+                _md5.add(_buffer + _bufferLen, available);
                 _bufferLen += available;
                 written += available;
                 if(_bufferLen == remaining()) {
@@ -155,13 +243,21 @@ public:
 private:
     void _reset();
     bool _writeBuffer();
+    bool _queueBuffer();
+    bool _flushBuffer();
+    bool _loadCheckpoint(update_checkpoint_t *checkpoint);
+    size_t _decode(const uint8_t *data, size_t len);
+    bool _setDecoder(const update_compress_header_t *header);
+    bool _verifyBase(uint32_t size, const uint8_t *md5);
 
     bool _verifyHeader(uint8_t data);
     bool _verifyEnd();
 
     uint8_t _error;
-    uint8_t *_buffer;
+    uint8_t *_buffer;       // sector being received
     size_t _bufferLen;
+    uint8_t *_flashBuffer;  // full sector waiting to be programmed
+    size_t _flashLen;
     size_t _size;
     uint32_t _startAddress;
     uint32_t _currentAddress;
@@ -170,6 +266,13 @@ private:
     String _target_md5;
     MD5Builder _md5;
     progressCb _progressCb;
+    update_checkpoint_t *_checkpoint;   // taken when a sector is queued, saved once it is programmed
+    LZSS_DECODER *_decoder;             // set for compressed images
+    uint8_t *_input;
+    DELTA_PATCH *_delta;                // set for patches, fed from _decoder
+    uint8_t *_patch;                    // decompressed patch not yet applied
+    size_t _patchPos;
+    size_t _patchLen;
 };
 
 extern UpdaterClass Update;
@@ -183,6 +286,9 @@ extern UpdaterClass Update;
 #define HTTP_UE_SERVER_FAULTY_MD5           (-105)
 #define HTTP_UE_BIN_VERIFY_HEADER_FAILED    (-106)
 #define HTTP_UE_BIN_FOR_WRONG_FLASH         (-107)
+#define HTTP_UE_RESUME_FAILED               (-108)
+
+#define HTTP_UPDATE_RETRIES                 3       // resume attempts after the link drops
 
 enum HTTPUpdateResult {
     HTTP_UPDATE_FAILED,
@@ -212,7 +318,8 @@ public:
 
 protected:
     t_httpUpdate_return handleUpdate(HTTPClient& http, const String& currentVersion);
-    bool runUpdate(Stream& in, uint32_t size, String md5);
+    t_httpUpdate_return requestUpdate(HTTPClient& http, const String& currentVersion);
+    bool runUpdate(Stream& in, uint32_t size, String md5, size_t offset = 0);
 
     uint32_t _startAddress;
     uint32_t _maxSize;
@@ -221,6 +328,7 @@ protected:
 
     int _lastError;
     bool _rebootOnUpdate = true;
+    bool _acceptDelta = false;          // the server may answer with a patch
 };
 
 #endif
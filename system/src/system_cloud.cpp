@@ -87,6 +87,7 @@ uint16_t g_keepAlive = 0;
 
 TCPClient g_mqtt_tcp_client;
 MqttClientClass g_mqtt_client;
+HTTPClient g_http_client;   //平台http请求共用一个keep-alive连接
 RGBLEDState led_state;
 
 
@@ -156,39 +157,45 @@ typedef enum {
 /***********************v2版本控制回调函数***********************/
 static void send_upgrade_status(const upgrade_reply_t upgrade_reply, const uint8_t progress)
 {
-    String status = "{\"status\":\"";
+    const char *status;
     switch(upgrade_reply)
     {
-        case UPGRADE_REPLY_PROGRESS:
-            status += String(INTOROBOT_MQTT_REPLY_READY_PROGRESS) + "\",\"progress\":" + String(progress) + "}";
-            break;
         case UPGRADE_REPLY_DOWN_FAIL:
-            status += String(INTOROBOT_MQTT_REPLY_DOWN_FAIL) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_DOWN_FAIL;
             break;
         case UPGRADE_REPLY_DOWN_SUCC:
-            status += String(INTOROBOT_MQTT_REPLY_DOWN_SUCC) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_DOWN_SUCC;
             break;
         case UPGRADE_REPLY_UPDATE_FAIL:
-            status += String(INTOROBOT_MQTT_REPLY_UPDATE_FAIL) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_UPDATE_FAIL;
             break;
         case UPGRADE_REPLY_UPDATE_SUCC:
-            status += String(INTOROBOT_MQTT_REPLY_UPDATE_SUCC) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_UPDATE_SUCC;
             break;
         case UPGRADE_REPLY_DOWN_SUCC_EXIT:
-            status += String(INTOROBOT_MQTT_REPLY_DOWN_SUCC_EXIT) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_DOWN_SUCC_EXIT;
             break;
         case UPGRADE_REPLY_TYPEEEOR:
-            status += String(INTOROBOT_MQTT_REPLY_TYPEEEOR) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_TYPEEEOR;
             break;
         case UPGRADE_REPLY_REBOOT_READY:
-            status += String(INTOROBOT_MQTT_REPLY_REBOOT_READY) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_REBOOT_READY;
             break;
+        case UPGRADE_REPLY_PROGRESS:
         case UPGRADE_REPLY_READY:
         default:
-            status += String(INTOROBOT_MQTT_REPLY_READY_PROGRESS) + "\"}";
+            status = INTOROBOT_MQTT_REPLY_READY_PROGRESS;
             break;
     }
-    intorobot_publish(TOPIC_VERSION_V2, INTOROBOT_MQTT_REPLY_TOPIC, (uint8_t*)status.c_str(), status.length(), 0, false);
+
+    char buffer[40];
+    aJsonWriter json(buffer, sizeof(buffer));
+    json.beginObject().add("status", status);
+    if(UPGRADE_REPLY_PROGRESS == upgrade_reply) {
+        json.add("progress", progress);
+    }
+    json.endObject();
+    intorobot_publish(TOPIC_VERSION_V2, INTOROBOT_MQTT_REPLY_TOPIC, (uint8_t*)buffer, json.length(), 0, false);
 }
 
 void intorobot_send_upgrade_progress(uint8_t progress)
@@ -362,7 +369,10 @@ void cloud_action_callback(uint8_t *payload, uint32_t len)
 {
     SCLOUD_DEBUG("v2 :cloud_action_callback!\r\n");
 
-    aJsonClass aJson;
+    //指令很短，解析树放在栈上，放不下的部分才申请堆
+    uint8_t arenaBuffer[256];
+    aJsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    aJsonClass aJson(&arena);
     String s_payload;
     aJsonObject *root = NULL, *boardObject = NULL, *cmdObject = NULL, *dtokenObject = NULL, *versionObject = NULL;
 
@@ -946,32 +956,36 @@ int intorobot_cloud_connect(void)
         SCLOUD_DEBUG("nwkskey -> ");
         SCLOUD_DEBUG_DUMP(g_mqtt_nwkskey, 16);
         if(System.featureEnabled(SYSTEM_FEATURE_SEND_INFO_ENABLED)) {
-            aJsonClass aJson;
             char buffer[33] = {0};
-
-            aJsonObject *root = aJson.createObject();
-            if (root == NULL) {
+            //每项最长32字节，放得下整条信息
+            const size_t infoSize = 320;
+            char *info = (char *)malloc(infoSize);
+            if (info == NULL) {
                 return -1;
             }
+            aJsonWriter json(info, infoSize);
+
+            json.beginObject();
             system_get_board_id(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "board", buffer);
+            json.add("board", buffer);
             system_get_product_id(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "productId", buffer);
-            aJson.addStringToObject(root, "mode", "master");
+            json.add("productId", buffer);
+            json.add("mode", "master");
             system_get_product_software_version(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "swVer", buffer);
+            json.add("swVer", buffer);
             system_get_product_hardware_version(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "hwVer", buffer);
+            json.add("hwVer", buffer);
             HAL_PARAMS_Get_System_fwlib_ver(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "libVer", buffer);
+            json.add("libVer", buffer);
             HAL_PARAMS_Get_System_subsys_ver(buffer, sizeof(buffer));
-            aJson.addStringToObject(root, "subsysVer", buffer);
-            aJson.addBooleanToObject(root, "online", true);
-            char *string = aJson.print(root);
-            SCLOUD_DEBUG("info = %s\r\n", string);
-            intorobot_publish(TOPIC_VERSION_V2, INTOROBOT_MQTT_WILL_TOPIC, (uint8_t*)string, strlen(string), 0, true);
-            free(string);
-            aJson.deleteItem(root);
+            json.add("subsysVer", buffer);
+            json.add("online", true);
+            json.endObject();
+            SCLOUD_DEBUG("info = %s\r\n", info);
+            if(!json.overflow()) {
+                intorobot_publish(TOPIC_VERSION_V2, INTOROBOT_MQTT_WILL_TOPIC, (uint8_t*)info, json.length(), 0, true);
+            }
+            free(info);
         }
         //重新订阅
         SCLOUD_DEBUG("---------mqtt resubscribe--------\r\n");
@@ -997,28 +1011,43 @@ void intorobot_cloud_keepalive(uint16_t sec)
     g_keepAlive = sec;
 }
 
+/*
+ * 平台http请求(同步时间, 注册设备)共用一个连接, 服务器关闭了连接时自动重连
+ */
+static HTTPClient &intorobot_http_session(const char *uri)
+{
+    char http_domain[32] = {0};
+    HAL_PARAMS_Get_System_http_domain(http_domain, sizeof(http_domain));
+    int http_port = HAL_PARAMS_Get_System_http_port();
+
+    g_http_client.begin(http_domain, http_port, uri);
+    g_http_client.setReuse(true);
+    g_http_client.setUserAgent(F("User-Agent: Mozilla/5.0 (Windows NT 5.1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/30.0.1599.101 Safari/537.36"));
+    return g_http_client;
+}
+
+void intorobot_http_session_stop(void)
+{
+    g_http_client.setReuse(false);
+    g_http_client.end();
+}
+
 bool intorobot_sync_time(void)
 {
     SCLOUD_DEBUG("---------device syncTime begin---------\r\n");
     time_t utc_time = 0;
     bool flag = false;
-    HTTPClient http;
     aJsonClass aJson;
     String payload = "";
 
-    char http_domain[32] = {0};
-    HAL_PARAMS_Get_System_http_domain(http_domain, sizeof(http_domain));
-    int http_port = HAL_PARAMS_Get_System_http_port();
-
-    http.begin(http_domain, http_port, "/v1/device?act=getts");
-    http.setUserAgent(F("User-Agent: Mozilla/5.0 (Windows NT 5.1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/30.0.1599.101 Safari/537.36"));
+    HTTPClient &http = intorobot_http_session("/v1/device?act=getts");
     int httpCode = http.POST(payload);
     if(httpCode == HTTP_CODE_OK) {
-        payload = http.getString();
-        //SCLOUD_DEBUG("payload    : %s\r\n", (char *)payload.c_str());
-        aJsonObject* root = aJson.parse((char *)payload.c_str());
+        char *filter[] = {(char *)"ts", NULL};
+        aJsonClientStream body(&http);
+        aJsonObject* root = aJson.parse(&body, filter);
         if (root == NULL)
-        {return false;}
+        {http.end(); return false;}
 
         aJsonObject *tsObject = aJson.getObjectItem(root, "ts");
         if (tsObject != NULL) {
@@ -1047,35 +1076,26 @@ bool intorobot_device_register(char *prodcut_id, time_t utc_time, char *signatur
 {
     SCLOUD_DEBUG("---------device register begin---------\r\n");
 
-    HTTPClient http;
     aJsonClass aJson;
+    aJsonObject* root = NULL;
     bool flag = false;
 
-    aJsonObject* root = aJson.createObject();
-    if (root == NULL)
-    {return false;}
-
     //获取product id
-    aJson.addStringToObject(root, "productId", prodcut_id);
-    aJson.addStringToObject(root, "timestamp", String(utc_time).c_str());
-    aJson.addStringToObject(root, "signature", signature);
-    char* string = aJson.print(root);
-    String payload = string;
-    free(string);
-    aJson.deleteItem(root);
-
-    char http_domain[32] = {0};
-    HAL_PARAMS_Get_System_http_domain(http_domain, sizeof(http_domain));
-    int http_port = HAL_PARAMS_Get_System_http_port();
+    char timestamp[12], payload[192];
+    sprintf(timestamp, "%lu", (unsigned long)utc_time);
+    aJsonWriter json(payload, sizeof(payload));
+    json.beginObject().add("productId", prodcut_id).add("timestamp", timestamp).add("signature", signature).endObject();
+    if (json.overflow())
+    {return false;}
 
-    http.begin(http_domain, http_port, "/v1/device?act=register");
-    http.setUserAgent(F("User-Agent: Mozilla/5.0 (Windows NT 5.1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/30.0.1599.101 Safari/537.36"));
-    int httpCode = http.POST(payload);
+    HTTPClient &http = intorobot_http_session("/v1/device?act=register");
+    int httpCode = http.POST((uint8_t *)payload, json.length());
     if(httpCode == HTTP_CODE_OK) {
-        payload = http.getString();
-        root = aJson.parse((char *)payload.c_str());
+        char *filter[] = {(char *)"deviceId", (char *)"token", NULL};
+        aJsonClientStream body(&http);
+        root = aJson.parse(&body, filter);
         if (root == NULL)
-        {return false;}
+        {http.end(); return false;}
 
         //device_id  and access_token
         aJsonObject *deviceIdObject = aJson.getObjectItem(root, "deviceId");
@@ -208,61 +208,54 @@ bool DeviceConfig::process(void)
 
 void DeviceConfig::sendComfirm(int status)
 {
-    aJsonObject* root = aJson.createObject();
-    if (root == NULL) {return;}
+    char buffer[24];
+    aJsonWriter json(buffer, sizeof(buffer));
 
-    aJson.addNumberToObject(root, "status", status);
-    char* string = aJson.print(root);
-    if(NULL != string) {
-        write((unsigned char *)string, strlen(string));
-        free(string);
-    }
-    aJson.deleteItem(root);
+    json.beginObject().add("status", status).endObject();
+    write((unsigned char *)buffer, json.length());
 }
 
 void DeviceConfig::dealHello(void)
 {
-    aJsonObject* root = aJson.createObject();
-    if (root == NULL) {return;}
+    char buffer[160];
+    aJsonWriter json(buffer, sizeof(buffer));
 
-    aJson.addNumberToObject(root, "status", 200);
-    aJson.addNumberToObject(root, "version", 2);  //v2版本配置协议
+    json.beginObject();
+    json.add("status", 200);
+    json.add("version", 2);  //v2版本配置协议
     char device_id[32]="", board[32]="";
     system_get_board_id(board, sizeof(board));
-    aJson.addStringToObject(root, "board", (char *)board);
+    json.add("board", board);
     if (AT_MODE_FLAG_NONE != HAL_PARAMS_Get_System_at_mode()) {
         HAL_PARAMS_Get_System_device_id(device_id, sizeof(device_id));
-        aJson.addStringToObject(root, "device_id", (char *)device_id);
+        json.add("device_id", device_id);
     }
-    aJson.addNumberToObject(root, "at_mode", HAL_PARAMS_Get_System_at_mode());
-    char* string = aJson.print(root);
-    if(NULL != string) {
-        write((unsigned char *)string, strlen(string));
-        free(string);
+    json.add("at_mode", HAL_PARAMS_Get_System_at_mode());
+    json.endObject();
+    if(!json.overflow()) {
+        write((unsigned char *)buffer, json.length());
     }
-    aJson.deleteItem(root);
 }
 
 void DeviceConfig::dealCheckWifi(void)
 {
 #ifdef configWIRING_WIFI_ENABLE
-    aJsonObject* root = aJson.createObject();
-    if (root == NULL) {return;}
+    char buffer[96];
+    aJsonWriter json(buffer, sizeof(buffer));
 
+    json.beginObject();
     if(WiFi.ready()) {
         manage_ip_config();
-        aJson.addNumberToObject(root, "status", 200);
-        aJson.addStringToObject(root, "ssid", WiFi.SSID());
-        aJson.addNumberToObject(root, "rssi", WiFi.RSSI());
+        json.add("status", 200);
+        json.add("ssid", WiFi.SSID());
+        json.add("rssi", WiFi.RSSI());
     } else {
-        aJson.addNumberToObject(root, "status", 201);
+        json.add("status", 201);
     }
-    char* string = aJson.print(root);
-    if(NULL != string) {
-        write((unsigned char *)string, strlen(string));
-        free(string);
+    json.endObject();
+    if(!json.overflow()) {
+        write((unsigned char *)buffer, json.length());
     }
-    aJson.deleteItem(root);
 #elif (defined configWIRING_CELLULAR_ENABLE) || (defined configWIRING_LORA_ENABLE)
     sendComfirm(200);
 #endif
@@ -279,6 +272,26 @@ void DeviceConfig::dealGetNetworkStatus(void)
 #endif
 }
 
+#ifdef configWIRING_WIFI_ENABLE
+static void write_wifi_list(aJsonWriter &json, WiFiAccessPoint *ap, int found)
+{
+    json.beginObject();
+    json.add("status", 200);
+    json.add("listnum", found);
+    json.beginArray("ssidlist");
+    for(int n = 0; n < found; n++)
+    {
+        json.beginObject();
+        json.add("ssid", ap[n].ssid);
+        json.add("entype", (int)ap[n].security);
+        json.add("signal", ap[n].rssi);
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
+#endif
+
 void DeviceConfig::dealGetWifiList(void)
 {
 #ifdef configWIRING_WIFI_ENABLE
@@ -289,35 +302,17 @@ void DeviceConfig::dealGetWifiList(void)
     if(found < 1) {
         sendComfirm(201);
     } else {
-        aJsonObject* root = aJson.createObject();
-        if (root == NULL) {return;}
-        aJson.addNumberToObject(root, "status",200);
-        aJson.addNumberToObject(root, "listnum",found);
-        aJsonObject* ssidlistarray = aJson.createArray();
-        if (ssidlistarray == NULL) {
-            aJson.deleteItem(root);
-            return;
-        }
-        aJson.addItemToObject(root, "ssidlist", ssidlistarray);
-
-        for(int n = 0; n < found; n++)
-        {
-            aJsonObject* ssid_object = aJson.createObject();
-            if (ssid_object == NULL) {
-                aJson.deleteItem(root);
-                return;
-            }
-            aJson.addItemToArray(ssidlistarray, ssid_object);
-            aJson.addStringToObject(ssid_object, "ssid", ap[n].ssid);
-            aJson.addNumberToObject(ssid_object, "entype", ap[n].security);
-            aJson.addNumberToObject(ssid_object, "signal", ap[n].rssi);
-        }
-        char* string = aJson.print(root);
+        //先空写一遍得到长度, 再按实际长度申请内存
+        aJsonWriter measure(NULL, 0);
+        write_wifi_list(measure, ap, found);
+        size_t size = measure.length() + 1;
+        char* string = (char *)malloc(size);
         if(NULL != string) {
-            write((unsigned char *)string, strlen(string));
+            aJsonWriter json(string, size);
+            write_wifi_list(json, ap, found);
+            write((unsigned char *)string, json.length());
             free(string);
         }
-        aJson.deleteItem(root);
     }
     wlan_Imlink_start();
 #elif (defined configWIRING_CELLULAR_ENABLE) || (defined configWIRING_LORA_ENABLE)
@@ -328,36 +323,38 @@ void DeviceConfig::dealGetWifiList(void)
 void DeviceConfig::dealGetInfo(void)
 {
     DEBUG("dealGetInfo = %d\r\n", System.freeMemory());
-    aJsonObject* root = aJson.createObject();
-    if (root == NULL) {return;}
+    const size_t infoSize = 512;
+    char* string = (char *)malloc(infoSize);
+    if (string == NULL) {return;}
 
-    aJson.addNumberToObject(root, "status", 200);
-    aJsonObject* value_Object = aJson.createObject();
-    if (value_Object == NULL) {return;}
+    aJsonWriter json(string, infoSize);
+    json.beginObject();
+    json.add("status", 200);
+    json.beginObject("value");
 
     char device_id[32]="",board[32]="";
     system_get_board_id(board, sizeof(board));
-    aJson.addStringToObject(value_Object, "board", board);
+    json.add("board", board);
     HAL_PARAMS_Get_System_device_id(device_id, sizeof(device_id));
-    aJson.addStringToObject(value_Object, "device_id", device_id);
-    aJson.addNumberToObject(value_Object, "at_mode", HAL_PARAMS_Get_System_at_mode());
+    json.add("device_id", device_id);
+    json.add("at_mode", HAL_PARAMS_Get_System_at_mode());
 
-    aJson.addNumberToObject(value_Object, "zone", HAL_PARAMS_Get_System_zone());
+    json.add("zone", HAL_PARAMS_Get_System_zone());
 
 #if (defined configWIRING_WIFI_ENABLE) || (defined configWIRING_CELLULAR_ENABLE)
     char domain[50] = {0};
     HAL_PARAMS_Get_System_sv_domain(domain, sizeof(domain));
-    aJson.addStringToObject(value_Object, "sv_domain", domain);
-    aJson.addNumberToObject(value_Object, "sv_port", HAL_PARAMS_Get_System_sv_port());
+    json.add("sv_domain", domain);
+    json.add("sv_port", HAL_PARAMS_Get_System_sv_port());
 
     memset(domain, 0, sizeof(domain));
     HAL_PARAMS_Get_System_http_domain(domain, sizeof(domain));
-    aJson.addStringToObject(value_Object, "http_domain", domain);
-    aJson.addNumberToObject(value_Object, "http_port", HAL_PARAMS_Get_System_http_port());
+    json.add("http_domain", domain);
+    json.add("http_port", HAL_PARAMS_Get_System_http_port());
 
     memset(domain, 0, sizeof(domain));
     HAL_PARAMS_Get_System_dw_domain(domain, sizeof(domain));
-    aJson.addStringToObject(value_Object, "dw_domain", domain);
+    json.add("dw_domain", domain);
 
 #ifdef configWIRING_WIFI_ENABLE
     uint8_t stamac[6] = {0}, apmac[6] = {0};
@@ -366,23 +363,22 @@ void DeviceConfig::dealGetInfo(void)
     wlan_get_macaddr(stamac, apmac);
     memset(macStr, 0, sizeof(macStr));
     sprintf(macStr, "%02X:%02X:%02X:%02X:%02X:%02X", stamac[0], stamac[1], stamac[2], stamac[3], stamac[4], stamac[5]);
-    aJson.addStringToObject(value_Object, "stamac", macStr);
+    json.add("stamac", macStr);
     memset(macStr, 0, sizeof(macStr));
     sprintf(macStr, "%02X:%02X:%02X:%02X:%02X:%02X", apmac[0], apmac[1], apmac[2], apmac[3], apmac[4], apmac[5]);
-    aJson.addStringToObject(value_Object, "apmac", macStr);
+    json.add("apmac", macStr);
 #endif
 #elif defined configWIRING_LORA_ENABLE
     char devaddr[12];
     HAL_PARAMS_Get_System_devaddr(devaddr, sizeof(devaddr));
-    aJson.addStringToObject(value_Object, "devaddr", devaddr);
+    json.add("devaddr", devaddr);
 #endif
-    aJson.addItemToObject(root, "value", value_Object);
-    char* string = aJson.print(root);
-    if(NULL != string) {
-        write((unsigned char *)string, strlen(string));
-        free(string);
+    json.endObject();
+    json.endObject();
+    if(!json.overflow()) {
+        write((unsigned char *)string, json.length());
     }
-    aJson.deleteItem(root);
+    free(string);
 }
 
 void DeviceConfig::dealSetNetworkCredentials(aJsonObject* root)
@@ -19,9 +19,27 @@
 
 #include "system_event.h"
 #include "system_threading.h"
+#include "wiring_interrupts.h"
 #include <stdint.h>
-#include <vector>
+#include <string.h>
+#include <new>
 
+#ifndef SYSTEM_EVENT_SUBSCRIPTIONS_MAX
+#define SYSTEM_EVENT_SUBSCRIPTIONS_MAX      16
+#endif
+
+#define SYSTEM_EVENT_TYPES_MAX              64      // one slot per bit of system_event_t
+
+#ifndef SYSTEM_EVENT_DATA_POOL_SIZE
+#define SYSTEM_EVENT_DATA_POOL_SIZE         4
+#endif
+
+#ifndef SYSTEM_EVENT_DATA_BLOCK_SIZE
+#define SYSTEM_EVENT_DATA_BLOCK_SIZE        128
+#endif
+
+static_assert(SYSTEM_EVENT_SUBSCRIPTIONS_MAX <= 32, "subscriber index is a 32-bit mask");
+static_assert(SYSTEM_EVENT_DATA_POOL_SIZE <= 32, "data pool usage is a 32-bit mask");
 
 struct SystemEventSubscription {
 
@@ -32,6 +50,11 @@ struct SystemEventSubscription {
     SystemEventSubscription(system_event_t e, system_event_handler_t* h) :
     events(e), handler(h) {}
 
+    inline bool isFree() const
+    {
+        return handler==nullptr;
+    }
+
     inline bool matchesHandler(system_event_handler_t* matchHandler) const
     {
         return (matchHandler==nullptr) || (matchHandler==handler);
@@ -55,9 +78,84 @@ struct SystemEventSubscription {
     }
 };
 
-// for now a simple implementation
-std::vector<SystemEventSubscription> subscriptions;
+/**
+ * Fixed capacity subscriber table. subscribers[n] holds a bitmask of the
+ * subscription slots interested in the event with bit n set, so dispatch only
+ * visits the handlers of that event.
+ */
+static SystemEventSubscription subscriptions[SYSTEM_EVENT_SUBSCRIPTIONS_MAX];
+static uint32_t subscribers[SYSTEM_EVENT_TYPES_MAX];
+
+static void system_event_index_update(size_t slot)
+{
+    const uint32_t mask = 1UL<<slot;
+    const system_event_t events = subscriptions[slot].events;
+    for (size_t i = 0; i < SYSTEM_EVENT_TYPES_MAX; i++) {
+        if (events & ((system_event_t)1<<i)) {
+            subscribers[i] |= mask;
+        } else {
+            subscribers[i] &= ~mask;
+        }
+    }
+}
+
+static uint32_t system_event_subscribers(system_event_t event)
+{
+    uint32_t slots = 0;
+    while (event) {
+        slots |= subscribers[__builtin_ctzll(event)];
+        event &= event - 1;
+    }
+    return slots;
+}
+
+#if PLATFORM_THREADING
+
+/**
+ * Payloads of events raised off the application thread are copied here, since
+ * the caller's buffer may be gone by the time the application thread runs.
+ * Payloads larger than a block, or raised while the pool is exhausted, fall
+ * back to the heap.
+ */
+static uint8_t dataPool[SYSTEM_EVENT_DATA_POOL_SIZE][SYSTEM_EVENT_DATA_BLOCK_SIZE];
+static volatile uint32_t dataPoolUsed;
+
+static uint8_t* system_event_data_alloc(const uint8_t* data, uint16_t datalen)
+{
+    uint8_t* block = nullptr;
+    if (datalen <= SYSTEM_EVENT_DATA_BLOCK_SIZE) {
+        ATOMIC_BLOCK() {
+            for (size_t i = 0; i < SYSTEM_EVENT_DATA_POOL_SIZE; i++) {
+                if (!(dataPoolUsed & (1UL<<i))) {
+                    dataPoolUsed |= (1UL<<i);
+                    block = dataPool[i];
+                    break;
+                }
+            }
+        }
+    }
+    if (!block) {
+        block = new(std::nothrow) uint8_t[datalen];
+    }
+    if (block) {
+        memcpy(block, data, datalen);
+    }
+    return block;
+}
+
+static void system_event_data_free(uint8_t* block)
+{
+    if (block >= dataPool[0] && block < dataPool[SYSTEM_EVENT_DATA_POOL_SIZE]) {
+        const size_t i = (block - dataPool[0]) / SYSTEM_EVENT_DATA_BLOCK_SIZE;
+        ATOMIC_BLOCK() {
+            dataPoolUsed &= ~(1UL<<i);
+        }
+    } else {
+        delete[] block;
+    }
+}
 
+#endif
 
 /**
  * Subscribes to the system events given
@@ -68,9 +166,28 @@ std::vector<SystemEventSubscription> subscriptions;
  */
 int system_subscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved)
 {
-    size_t count = subscriptions.size();
-    subscriptions.push_back(SystemEventSubscription(events, handler));
-    return subscriptions.size()==count+1 ? 0 : -1;
+    if (!handler) {
+        return -1;
+    }
+
+    size_t slot = SYSTEM_EVENT_SUBSCRIPTIONS_MAX;
+    for (size_t i = 0; i < SYSTEM_EVENT_SUBSCRIPTIONS_MAX; i++) {
+        if (subscriptions[i].handler == handler) {
+            slot = i;
+            break;
+        }
+        if (subscriptions[i].isFree() && slot == SYSTEM_EVENT_SUBSCRIPTIONS_MAX) {
+            slot = i;
+        }
+    }
+    if (slot == SYSTEM_EVENT_SUBSCRIPTIONS_MAX) {
+        return -1;
+    }
+
+    subscriptions[slot].handler = handler;
+    subscriptions[slot].events |= events;
+    system_event_index_update(slot);
+    return 0;
 }
 
 /**
@@ -80,6 +197,17 @@ int system_subscribe_event(system_event_t events, system_event_handler_t* handle
  */
 void system_unsubscribe_event(system_event_t events, system_event_handler_t* handler, void* reserved)
 {
+    for (size_t i = 0; i < SYSTEM_EVENT_SUBSCRIPTIONS_MAX; i++) {
+        SystemEventSubscription& subscription = subscriptions[i];
+        if (subscription.isFree() || !subscription.matchesHandler(handler)) {
+            continue;
+        }
+        subscription.events &= ~events;
+        if (!subscription.events) {
+            subscription = SystemEventSubscription();
+        }
+        system_event_index_update(i);
+    }
 }
 
 /**
@@ -90,14 +218,42 @@ void system_unsubscribe_event(system_event_t events, system_event_handler_t* han
  */
 void system_notify_event(system_event_t event, int param, uint8_t *data, uint16_t datalen, void (*fn)(void* data), void* fndata)
 {
-    APPLICATION_THREAD_CONTEXT_ASYNC(system_notify_event(event, param, data, datalen, fn, fndata));
+#if PLATFORM_THREADING
     // run event notifications on the application thread
+    if (ApplicationThread.isStarted() && !ApplicationThread.isCurrentThread()) {
+        uint8_t* copy = nullptr;
+        if (data && datalen) {
+            copy = system_event_data_alloc(data, datalen);
+            if (!copy) {
+                // the payload cannot outlive the caller, drop the notification
+                if (fn) {
+                    fn(fndata);
+                }
+                return;
+            }
+        }
+        auto lambda = [=]() {
+            system_notify_event(event, param, copy, copy ? datalen : 0, fn, fndata);
+            if (copy) {
+                system_event_data_free(copy);
+            }
+        };
+        ApplicationThread.invoke_async(FFL(lambda));
+        return;
+    }
+#endif
 
-    for (const SystemEventSubscription& subscription : subscriptions) {
-        subscription.notify(event, param, data, datalen);
+    uint32_t slots = system_event_subscribers(event);
+    while (slots) {
+        const size_t i = __builtin_ctz(slots);
+        slots &= slots - 1;
+        // a handler may unsubscribe itself or others while being notified
+        const SystemEventSubscription& subscription = subscriptions[i];
+        if (!subscription.isFree()) {
+            subscription.notify(event, param, data, datalen);
+        }
     }
     if (fn) {
         fn(fndata);
     }
 }
-
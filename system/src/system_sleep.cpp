@@ -39,6 +39,8 @@ static TimerEvent_t sleepTimer;
 #endif
 
 static void before_sleep(uint32_t seconds) {
+    //休眠前完成待擦除的扇区 唤醒后写EEPROM不再卡顿
+    system_perform_pending_erase(SYSTEM_SLEEP_ERASE_MAX_PAGES);
 #ifndef configNO_LORAWAN
     LoRa.radioSetSleep();
     if(seconds > 0){
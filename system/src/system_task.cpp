@@ -26,6 +26,7 @@
 #include "timer_hal.h"
 #include "core_hal.h"
 #include "params_hal.h"
+#include "eeprom_hal.h"
 #include "wiring_system.h"
 #include "system_task.h"
 #include "system_cloud.h"
@@ -217,6 +218,8 @@ void preprocess_cloud_connection(void)
                     }
                     break;
             }
+            // 预处理的http请求结束, 释放连接
+            intorobot_http_session_stop();
             cloud_connection_attempt_init();
             INTOROBOT_CLOUD_CONNECT_PREPARED = 1;
         }
@@ -359,6 +362,17 @@ void manage_lorawan_connection(void)
 
 #endif
 
+/*
+ * 擦除EEPROM模拟区换页后留下的旧页 最多擦除max_pages页
+ * 在系统空闲和休眠前执行 用户写EEPROM时不会再遇到擦除扇区的卡顿
+ * */
+void system_perform_pending_erase(uint8_t max_pages)
+{
+    for(uint8_t i = 0; (i < max_pages) && HAL_EEPROM_Has_Pending_Erase(); i++) {
+        HAL_EEPROM_Perform_Pending_Erase();
+    }
+}
+
 void system_process_loop(void)
 {
     intorobot_loop_total_millis = 0;
@@ -373,6 +387,8 @@ void system_process_loop(void)
 #ifdef configSETUP_ENABLE
     }
 #endif
+    //每次循环最多擦除一页 避免系统循环长时间卡顿
+    system_perform_pending_erase(1);
 }
 
 /*
@@ -75,11 +75,20 @@ UpdaterClass::UpdaterClass()
     : _error(0)
     , _buffer(0)
     , _bufferLen(0)
+    , _flashBuffer(0)
+    , _flashLen(0)
     , _size(0)
     , _startAddress(0)
     , _currentAddress(0)
     , _progress(0)
     , _progressCb(NULL)
+    , _checkpoint(NULL)
+    , _decoder(NULL)
+    , _input(NULL)
+    , _delta(NULL)
+    , _patch(NULL)
+    , _patchPos(0)
+    , _patchLen(0)
 {
 }
 
@@ -88,6 +97,29 @@ void UpdaterClass::_reset() {
         delete[] _buffer;
     _buffer = 0;
     _bufferLen = 0;
+    if (_flashBuffer)
+        delete[] _flashBuffer;
+    _flashBuffer = 0;
+    _flashLen = 0;
+    if (_checkpoint)
+        delete _checkpoint;
+    _checkpoint = 0;
+    if (_decoder) {
+        lzssReleaseDecoder(_decoder);
+        delete _decoder;
+    }
+    _decoder = 0;
+    if (_input)
+        delete[] _input;
+    _input = 0;
+    if (_delta)
+        delete _delta;
+    _delta = 0;
+    if (_patch)
+        delete[] _patch;
+    _patch = 0;
+    _patchPos = 0;
+    _patchLen = 0;
     _startAddress = 0;
     _currentAddress = 0;
     _size = 0;
@@ -135,6 +167,9 @@ bool UpdaterClass::begin(size_t size, uint32_t startAddress, uint32_t maxSize) {
     _currentAddress = _startAddress;
     _size = size;
     _buffer = new uint8_t[UPDATE_SECTOR_SIZE];
+    _flashBuffer = new uint8_t[UPDATE_SECTOR_SIZE];
+    _checkpoint = new update_checkpoint_t;
+    _checkpoint->offset = 0;
 
     SUPDATE_DEBUG("[begin] _startAddress:       0x%08X (%d)\r\n", _startAddress, _startAddress);
     SUPDATE_DEBUG("[begin] _currentAddress:     0x%08X (%d)\r\n", _currentAddress, _currentAddress);
@@ -152,6 +187,92 @@ bool UpdaterClass::setMD5(const char * expected_md5){
     return true;
 }
 
+bool UpdaterClass::setCompression(const update_compress_header_t *header){
+    if(!isRunning() || progress() || _bufferLen || _decoder)
+        return false;
+
+    if(header->magic != UPDATE_COMPRESS_MAGIC) {
+        _error = UPDATE_ERROR_COMPRESS;
+        return false;
+    }
+    return _setDecoder(header);
+}
+
+static int update_read_base(void *context, uint32_t offset, uint8_t *buffer, uint32_t length){
+    return HAL_FLASH_Read(buffer, HAL_APP_FlashAddress() + offset, length);
+}
+
+bool UpdaterClass::setDelta(const update_delta_header_t *header){
+    if(!isRunning() || progress() || _bufferLen || _decoder)
+        return false;
+
+    if(header->image.magic != UPDATE_DELTA_MAGIC) {
+        _error = UPDATE_ERROR_PATCH;
+        return false;
+    }
+    if(!_verifyBase(header->baseSize, header->baseMd5)) {
+        _error = UPDATE_ERROR_BASE;
+        SUPDATE_DEBUG("[setDelta] application is not the base of the patch\r\n");
+        return false;
+    }
+    if(!_setDecoder(&header->image))
+        return false;
+
+    _delta = new DELTA_PATCH;
+    deltaInitialPatch(_delta, update_read_base, NULL, header->baseSize);
+    _patch = new uint8_t[UPDATE_INPUT_SIZE];
+    return true;
+}
+
+/*
+  Checks the first size bytes of the application against md5,
+  using the receive buffer as nothing has been received yet
+*/
+bool UpdaterClass::_verifyBase(uint32_t size, const uint8_t *md5){
+    MD5Builder base;
+    uint8_t result[16];
+
+    if(size == 0 || size > HAL_APP_FlashLength())
+        return false;
+
+    base.begin();
+    for(uint32_t offset = 0; offset < size; offset += UPDATE_SECTOR_SIZE) {
+        uint32_t len = size - offset;
+        if(len > UPDATE_SECTOR_SIZE) {
+            len = UPDATE_SECTOR_SIZE;
+        }
+        if(HAL_FLASH_Read(_buffer, HAL_APP_FlashAddress() + offset, len))
+            return false;
+        base.add(_buffer, len);
+    }
+    base.calculate();
+    base.getBytes(result);
+    return memcmp(result, md5, sizeof(result)) == 0;
+}
+
+bool UpdaterClass::_setDecoder(const update_compress_header_t *header){
+    char md5[33];
+
+    if(header->algorithm != UPDATE_COMPRESS_LZSS || header->size != _size) {
+        _error = UPDATE_ERROR_COMPRESS;
+        return false;
+    }
+
+    _decoder = new LZSS_DECODER;
+    if(!lzssInitialDecoder(_decoder, header->windowBits, header->lookaheadBits)) {
+        delete _decoder;
+        _decoder = 0;
+        _error = UPDATE_ERROR_COMPRESS;
+        return false;
+    }
+    _input = new uint8_t[UPDATE_INPUT_SIZE];
+
+    for(int i = 0; i < 16; i++) {
+        sprintf(md5 + i * 2, "%02x", header->md5[i]);
+    }
+    return setMD5(md5);
+}
+
 bool UpdaterClass::setSendProgressCb(progressCb Cb){
     if(NULL == Cb) {
         return false;
@@ -180,6 +301,7 @@ bool UpdaterClass::end(bool evenIfRemaining){
     }
 
     _md5.calculate();
+    clearCheckpoint();
     if(_target_md5.length()) {
         if(_target_md5 != _md5.toString()){
             _error = UPDATE_ERROR_MD5;
@@ -198,9 +320,44 @@ bool UpdaterClass::end(bool evenIfRemaining){
 }
 
 bool UpdaterClass::_writeBuffer(){
+    return _queueBuffer() && _flushBuffer();
+}
+
+/*
+  Hands the receive buffer over to be programmed and starts a new one.
+  A sector still waiting is programmed first.
+*/
+bool UpdaterClass::_queueBuffer(){
+    if(!_flushBuffer())
+        return false;
+
+    uint8_t *buffer = _flashBuffer;
+    _flashBuffer = _buffer;
+    _flashLen = _bufferLen;
+    _buffer = buffer;
+    _bufferLen = 0;
+
+    // the MD5 now covers exactly what is programmed plus the queued sector
+    // a decompressor's window is not saved, so compressed images start over
+    size_t offset = progress() + _flashLen;
+    if(_target_md5.length() && !_decoder && offset < _size && (offset % (UPDATE_CHECKPOINT_SECTORS * UPDATE_SECTOR_SIZE)) == 0) {
+        _checkpoint->magic = UPDATE_CHECKPOINT_MAGIC;
+        _checkpoint->startAddress = _startAddress;
+        _checkpoint->size = _size;
+        _checkpoint->offset = offset;
+        strncpy(_checkpoint->md5, _target_md5.c_str(), sizeof(_checkpoint->md5));
+        _md5.getContext(&_checkpoint->ctx);
+    }
+    return true;
+}
+
+bool UpdaterClass::_flushBuffer(){
     StreamString error;
 
-    int result = HAL_FLASH_Update(_buffer, _currentAddress, _bufferLen, NULL);
+    if(_flashLen == 0)
+        return true;
+
+    int result = HAL_FLASH_Update(_flashBuffer, _currentAddress, _flashLen, NULL);
     if (result) {
         _error = UPDATE_ERROR_WRITE;
         _currentAddress = (_startAddress + _size);
@@ -209,16 +366,118 @@ bool UpdaterClass::_writeBuffer(){
         SUPDATE_DEBUG("error : (%s)\r\n", error.c_str());
         return false;
     }
-    _md5.add(_buffer, _bufferLen);
-    _currentAddress += _bufferLen;
-    _bufferLen = 0;
+    _currentAddress += _flashLen;
+    _flashLen = 0;
+
+    if(_checkpoint->offset && _checkpoint->offset == progress()) {
+        HAL_OTA_Set_Checkpoint(_checkpoint, sizeof(update_checkpoint_t));
+        _checkpoint->offset = 0;
+        SUPDATE_DEBUG("checkpoint at %d\r\n", progress());
+    }
+    return true;
+}
+
+bool UpdaterClass::_loadCheckpoint(update_checkpoint_t *checkpoint){
+    return HAL_OTA_Get_Checkpoint(checkpoint, sizeof(update_checkpoint_t))
+        && checkpoint->magic == UPDATE_CHECKPOINT_MAGIC;
+}
+
+size_t UpdaterClass::checkpoint(uint32_t startAddress, size_t *size, char *md5){
+    update_checkpoint_t checkpoint;
+
+    if(!_loadCheckpoint(&checkpoint) || checkpoint.startAddress != startAddress
+            || checkpoint.offset >= checkpoint.size || checkpoint.md5[32] != '\0') {
+        return 0;
+    }
+    *size = checkpoint.size;
+    strcpy(md5, checkpoint.md5);
+    return checkpoint.offset;
+}
+
+bool UpdaterClass::resume(size_t offset){
+    update_checkpoint_t checkpoint;
+
+    if(hasError() || !isRunning() || progress() || _bufferLen)
+        return false;
+
+    if(!_loadCheckpoint(&checkpoint) || checkpoint.startAddress != _startAddress
+            || checkpoint.size != _size || checkpoint.offset != offset
+            || _target_md5 != checkpoint.md5) {
+        return false;
+    }
+    _md5.setContext(&checkpoint.ctx);
+    _currentAddress += offset;
+    SUPDATE_DEBUG("[resume] from %d\r\n", offset);
     return true;
 }
 
+void UpdaterClass::clearCheckpoint(){
+    update_checkpoint_t checkpoint;
+
+    if(_loadCheckpoint(&checkpoint)) {
+        HAL_OTA_Set_Checkpoint(NULL, sizeof(update_checkpoint_t));
+    }
+}
+
+/*
+  Decompresses into the receive buffer, queueing each full sector
+  A patch is decompressed into _patch and applied from there
+  The decoder is called until it produces nothing, as the end of a
+  back-reference may still be pending once all of the input is used
+  Returns the input used, all of it until the image is complete
+*/
+size_t UpdaterClass::_decode(const uint8_t *data, size_t len) {
+    size_t used = 0;
+
+    while((_flashLen + _bufferLen) < remaining()) {
+        uint32_t room = UPDATE_SECTOR_SIZE - _bufferLen;
+        if(room > remaining() - _flashLen - _bufferLen) {
+            room = remaining() - _flashLen - _bufferLen;
+        }
+        uint32_t consumed = 0;
+        uint32_t produced;
+
+        if(_delta) {
+            produced = deltaApply(_delta, _patch + _patchPos, _patchLen - _patchPos, &consumed, _buffer + _bufferLen, room);
+            _patchPos += consumed;
+            if(_delta->error) {
+                _error = UPDATE_ERROR_PATCH;
+                break;
+            }
+            if(!produced && !consumed) {
+                // the patch applied so far is used up, decompress more of it
+                _patchLen = lzssDecode(_decoder, data + used, len - used, &consumed, _patch, UPDATE_INPUT_SIZE);
+                _patchPos = 0;
+                used += consumed;
+                if(!_patchLen && !consumed)
+                    break;
+                continue;
+            }
+        } else {
+            produced = lzssDecode(_decoder, data + used, len - used, &consumed, _buffer + _bufferLen, room);
+            used += consumed;
+            if(!produced && !consumed)
+                break;
+        }
+        _md5.add(_buffer + _bufferLen, produced);
+        _bufferLen += produced;
+        if((_bufferLen == UPDATE_SECTOR_SIZE || _flashLen + _bufferLen == remaining()) && !_queueBuffer())
+            break;
+    }
+    return used;
+}
+
 size_t UpdaterClass::write(uint8_t *data, size_t len) {
     if(hasError() || !isRunning())
         return 0;
 
+    if(_decoder) {
+        size_t used = _decode(data, len);
+        if(hasError() || !_flushBuffer())
+            return used;
+        return len;
+    }
+
     if(len > remaining()){
         //fail instead
         _error = UPDATE_ERROR_SPACE;
@@ -230,6 +489,7 @@ size_t UpdaterClass::write(uint8_t *data, size_t len) {
     while((_bufferLen + left) > UPDATE_SECTOR_SIZE) {
         size_t toBuff = UPDATE_SECTOR_SIZE - _bufferLen;
         memcpy(_buffer + _bufferLen, data + (len - left), toBuff);
+        _md5.add(_buffer + _bufferLen, toBuff);
         _bufferLen += toBuff;
         if(!_writeBuffer()){
             return len - left;
@@ -238,6 +498,7 @@ size_t UpdaterClass::write(uint8_t *data, size_t len) {
     }
     //lets see whats left
     memcpy(_buffer + _bufferLen, data + (len - left), left);
+    _md5.add(_buffer + _bufferLen, left);
     _bufferLen += left;
     if(_bufferLen == remaining()){
         //we are at the end of the update, so should write what's left to flash
@@ -252,7 +513,8 @@ size_t UpdaterClass::writeStream(Stream &data) {
     StreamString error;
     size_t written = 0;
     size_t toRead = 0;
-    uint8_t progress = 0;
+    uint8_t percent = 0;
+    system_tick_t lastRead = millis();
 
     if(hasError() || !isRunning())
         return 0;
@@ -261,34 +523,56 @@ size_t UpdaterClass::writeStream(Stream &data) {
         _progressCb(1);
     }
     while(remaining()) {
-        if((_bufferLen + remaining()) <= UPDATE_SECTOR_SIZE) {
-            toRead = data.readBytes((char *)_buffer + _bufferLen, remaining());
-        } else {
-            toRead = data.readBytes((char *)_buffer + _bufferLen, (UPDATE_SECTOR_SIZE - _bufferLen));
+        // bytes still to come from the stream that fit into the receive buffer
+        toRead = remaining() - _flashLen - _bufferLen;
+        if(toRead > (UPDATE_SECTOR_SIZE - _bufferLen)) {
+            toRead = UPDATE_SECTOR_SIZE - _bufferLen;
         }
 
-        if(toRead == 0) { //Timeout
-            delay(100);
-            toRead = data.readBytes((char *)_buffer + _bufferLen, (UPDATE_SECTOR_SIZE - _bufferLen));
-            if(toRead == 0) { //Timeout
-                _error = UPDATE_ERROR_STREAM;
-                _currentAddress = (_startAddress + _size);
-                printError(error);
-                error.trim(); // remove line ending
-                SUPDATE_DEBUG("error : (%s)\r\n", error.c_str());
-                _reset();
+        int available = toRead ? data.available() : 0;
+        if(available > 0 && _decoder) {
+            if(available > UPDATE_INPUT_SIZE) {
+                available = UPDATE_INPUT_SIZE;
+            }
+            size_t received = progress() + _flashLen + _bufferLen;
+            toRead = data.readBytes((char *)_input, available);
+            _decode(_input, toRead);
+            if(hasError())
                 return written;
+            written += progress() + _flashLen + _bufferLen - received;
+            lastRead = millis();
+        } else if(available > 0) {
+            if((size_t)available < toRead) {
+                toRead = available;
             }
-        }
-        _bufferLen += toRead;
-        if((_bufferLen == remaining() || _bufferLen == UPDATE_SECTOR_SIZE) && !_writeBuffer())
+            toRead = data.readBytes((char *)_buffer + _bufferLen, toRead);
+            _md5.add(_buffer + _bufferLen, toRead);
+            _bufferLen += toRead;
+            written += toRead;
+            lastRead = millis();
+            if((_bufferLen == UPDATE_SECTOR_SIZE || _flashLen + _bufferLen == remaining()) && !_queueBuffer())
+                return written;
+        } else if(_flashLen) {
+            // nothing to read, program the full sector while the data is on its way
+            if(!_flushBuffer())
+                return written;
+        } else if(millis() - lastRead > data.getTimeout()) { //Timeout
+            _error = UPDATE_ERROR_STREAM;
+            _currentAddress = (_startAddress + _size);
+            printError(error);
+            error.trim(); // remove line ending
+            SUPDATE_DEBUG("error : (%s)\r\n", error.c_str());
+            _reset();
             return written;
-        written += toRead;
+        } else {
+            delay(1);
+        }
+
         if(NULL != _progressCb) {
-            progress = (written*100)/size();
-            if((progress - _progress) > 20) {
-                _progressCb(progress);
-                _progress = progress;
+            percent = ((size() - remaining())*100)/size();
+            if((percent - _progress) > 20) {
+                _progressCb(percent);
+                _progress = percent;
             }
         }
         intorobot_cloud_handle();
@@ -315,6 +599,12 @@ void UpdaterClass::printError(Stream &out){
         out.println("Stream Read Timeout");
     } else if(_error == UPDATE_ERROR_MD5){
         out.println("MD5 Check Failed");
+    } else if(_error == UPDATE_ERROR_COMPRESS){
+        out.println("Unsupported Compressed Image");
+    } else if(_error == UPDATE_ERROR_BASE){
+        out.println("Delta Base Mismatch");
+    } else if(_error == UPDATE_ERROR_PATCH){
+        out.println("Delta Patch Invalid");
     } else {
         out.println("UNKNOWN");
     }
@@ -404,6 +694,8 @@ String HTTPUpdate::getLastErrorString(void)
             return F("Verify bin header failed");
         case HTTP_UE_BIN_FOR_WRONG_FLASH:
             return F("bin for wrong flash size");
+        case HTTP_UE_RESUME_FAILED:
+            return F("Resume failed");
     }
 
     return String();
@@ -429,24 +721,53 @@ bool HTTPUpdate::setSendProgressCb(progressCb Cb){
 
 
 /**
- *
+ * requests the update, retrying from the last checkpoint when the link drops
  * @param http HTTPClient *
  * @param currentVersion const char *
  * @return HTTPUpdateResult
  */
 HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& currentVersion)
+{
+    _lastError = 0;
+    // patches are made against the running application, so only for its update
+    _acceptDelta = (_startAddress == HAL_OTA_FlashAddress());
+    HTTPUpdateResult ret = requestUpdate(http, currentVersion);
+    if(HTTP_UPDATE_FAILED == ret && UPDATE_ERROR_BASE == _lastError) {
+        SUPDATE_DEBUG("[httpUpdate] patch does not fit, requesting the full image\r\n");
+        _acceptDelta = false;
+        ret = requestUpdate(http, currentVersion);
+    }
+    for(int retry = 0; retry < HTTP_UPDATE_RETRIES && HTTP_UPDATE_FAILED == ret; retry++) {
+        // only stream timeouts and http client errors are worth another try
+        if(_lastError != UPDATE_ERROR_STREAM && (_lastError >= 0 || _lastError <= -100)) {
+            break;
+        }
+        SUPDATE_DEBUG("[httpUpdate] retry %d, last error %d\r\n", retry + 1, _lastError);
+        delay(1000);
+        ret = requestUpdate(http, currentVersion);
+    }
+    return ret;
+}
+
+/**
+ *
+ * @param http HTTPClient *
+ * @param currentVersion const char *
+ * @return HTTPUpdateResult
+ */
+HTTPUpdateResult HTTPUpdate::requestUpdate(HTTPClient& http, const String& currentVersion)
 {
     HTTPUpdateResult ret = HTTP_UPDATE_FAILED;
 
     // use HTTP/1.0 for update since the update handler not support any transfer Encoding
     http.useHTTP10(true);
-    http.setReuse(true); /// keep-alive
     http.setTimeout(4000);
     http.setUserAgent(F("Mozilla/5.0 (Windows NT 5.1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/30.0.1599.101 Safari/537.36"));
     http.addHeader(F("Cache-Control"), F("no-cache"));
     http.addHeader(F("Accept"), F("*/*"));
     http.addHeader(F("Accept-Encoding"), F("gzip,deflate"));
     http.addHeader(F("Accept-Language"), F("zh-CN,eb-US;q=0.8"));
+    http.addHeader(F("X-Delta"), _acceptDelta ? F("1") : F("0"));
 
     /*
     if(currentVersion && currentVersion[0] != 0x00) {
@@ -454,12 +775,21 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
     }
     */
 
-    const char * headerkeys[] = { "X-Md5" };
+    const char * headerkeys[] = { "X-Md5", "Content-Range" };
     size_t headerkeyssize = sizeof(headerkeys) / sizeof(char*);
 
     // track these headers
     http.collectHeaders(headerkeys, headerkeyssize);
 
+    // continue an interrupted download of the same image
+    size_t resumeSize = 0;
+    char resumeMd5[33] = {0};
+    size_t offset = Update.checkpoint(_startAddress, &resumeSize, resumeMd5);
+    if(offset) {
+        http.addHeader(F("Range"), String("bytes=") + String(offset) + "-");
+        SUPDATE_DEBUG("[httpUpdate] resume from %d of %d\r\n", offset, resumeSize);
+    }
+
     int code = http.GET();
     int len = http.getSize();
 
@@ -522,6 +852,33 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
                 SUPDATE_DEBUG("[httpUpdate] Content-Length is 0 or not set by Server?!\r\n");
             }
             break;
+        case HTTP_CODE_PARTIAL_CONTENT: ///< Partial Content (Resume Update)
+            {
+                unsigned long first = 0, total = 0;
+                String range = http.header("Content-Range");
+                if(offset && len > 0 && 2 == sscanf(range.c_str(), "bytes %lu-%*u/%lu", &first, &total)
+                        && first == offset && total == resumeSize && offset + len == resumeSize
+                        && (!http.hasHeader("X-Md5") || http.header("X-Md5") == resumeMd5)) {
+                    TCPClient * tcp = http.getStreamPtr();
+
+                    SUPDATE_DEBUG("[httpUpdate] runUpdate flash from %d...\r\n", offset);
+
+                    if(runUpdate(*tcp, resumeSize, resumeMd5, offset)) {
+                        ret = HTTP_UPDATE_OK;
+                        SUPDATE_DEBUG("[httpUpdate] Update ok\r\n");
+                    } else {
+                        ret = HTTP_UPDATE_FAILED;
+                        SUPDATE_DEBUG("[httpUpdate] Update failed\r\n");
+                    }
+                } else {
+                    // the image changed on the server, start over next time
+                    Update.clearCheckpoint();
+                    _lastError = HTTP_UE_RESUME_FAILED;
+                    ret = HTTP_UPDATE_FAILED;
+                    SUPDATE_DEBUG("[httpUpdate] Content-Range (%s) does not match checkpoint\r\n", range.c_str());
+                }
+            }
+            break;
         case HTTP_CODE_NOT_MODIFIED:
             ///< Not Modified (No updates)
             ret = HTTP_UPDATE_NO_UPDATES;
@@ -550,13 +907,38 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
  * @param in Stream&
  * @param size uint32_t
  * @param md5 String
+ * @param offset size_t bytes already in flash from a checkpoint
  * @return true if Update ok
  */
-bool HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5)
+bool HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5, size_t offset)
 {
     StreamString error;
+    update_delta_header_t header;
+    size_t headerLen = 0;
+
+    // a compressed image or a patch starts with its header, anything else is written as it is
+    if(!offset && size > sizeof(header.image)) {
+        headerLen = in.readBytes((char *)&header.image, sizeof(header.image));
+        if(headerLen != sizeof(header.image)) {
+            _lastError = UPDATE_ERROR_STREAM;
+            SUPDATE_DEBUG("[httpUpdate] read image header failed!\r\n");
+            return false;
+        }
+    }
+    bool compressed = headerLen && (UPDATE_COMPRESS_MAGIC == header.image.magic);
+    bool delta = headerLen && (UPDATE_DELTA_MAGIC == header.image.magic);
 
-    if(!Update.begin(size, _startAddress, _maxSize)) {
+    if(delta) {
+        size_t rest = sizeof(header) - sizeof(header.image);
+        if(size <= sizeof(header) || in.readBytes((char *)&header + headerLen, rest) != rest) {
+            _lastError = UPDATE_ERROR_STREAM;
+            SUPDATE_DEBUG("[httpUpdate] read patch header failed!\r\n");
+            return false;
+        }
+        headerLen += rest;
+    }
+
+    if(!Update.begin((compressed || delta) ? header.image.size : size, _startAddress, _maxSize)) {
         _lastError = Update.getError();
         Update.printError(error);
         error.trim(); // remove line ending
@@ -568,7 +950,25 @@ bool HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5)
         Update.setSendProgressCb(_progressCb);
     }
 
-    if(md5.length()) {
+    if(delta) {
+        // the MD5 of the patched image is in the header too
+        if(!Update.setDelta(&header)) {
+            _lastError = Update.getError();
+            Update.end();
+            SUPDATE_DEBUG("[httpUpdate] Update.setDelta failed!\r\n");
+            return false;
+        }
+        SUPDATE_DEBUG("[httpUpdate] patch, %d -> %d\r\n", size, header.image.size);
+    } else if(compressed) {
+        // X-Md5 is that of the download, the header has the one of the image
+        if(!Update.setCompression(&header.image)) {
+            _lastError = Update.getError();
+            Update.end();
+            SUPDATE_DEBUG("[httpUpdate] Update.setCompression failed!\r\n");
+            return false;
+        }
+        SUPDATE_DEBUG("[httpUpdate] compressed image, %d -> %d\r\n", size, header.image.size);
+    } else if(md5.length()) {
         if(!Update.setMD5(md5.c_str())) {
             _lastError = HTTP_UE_SERVER_FAULTY_MD5;
             SUPDATE_DEBUG("[httpUpdate] Update.setMD5 failed! (%s)\r\n", md5.c_str());
@@ -576,7 +976,25 @@ bool HTTPUpdate::runUpdate(Stream& in, uint32_t size, String md5)
         }
     }
 
-    if(Update.writeStream(in) != size) {
+    if(offset) {
+        if(!Update.resume(offset)) {
+            _lastError = HTTP_UE_RESUME_FAILED;
+            Update.end();
+            SUPDATE_DEBUG("[httpUpdate] Update.resume failed!\r\n");
+            return false;
+        }
+    } else {
+        Update.clearCheckpoint();
+    }
+
+    // the header of a compressed image or a patch is not part of the image
+    if(headerLen && !compressed && !delta && Update.write((uint8_t *)&header, headerLen) != headerLen) {
+        _lastError = Update.getError();
+        SUPDATE_DEBUG("[httpUpdate] Update.write failed!\r\n");
+        return false;
+    }
+
+    if(Update.writeStream(in) != ((compressed || delta) ? header.image.size : size - offset - headerLen)) {
         _lastError = Update.getError();
         Update.printError(error);
         error.trim(); // remove line ending
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Packs a firmware image into the compressed OTA format read by UpdaterClass.
+
+The output is a 28 byte little endian header followed by the image coded as
+a heatshrink compatible LZSS bit stream:
+
+    uint32 magic            0x5a4f5249 ("IROZ")
+    uint8  algorithm        1 = LZSS
+    uint8  window bits
+    uint8  lookahead bits
+    uint8  reserved         0
+    uint32 size             size of the original image
+    uint8  md5[16]          MD5 of the original image
+
+usage: ota_compress.py [-w 11] [-l 4] [-d] input output
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x5a4f5249
+ALGORITHM_LZSS = 1
+HEADER = struct.Struct('<IBBBBI16s')
+MIN_MATCH = 3           # shorter matches cost about as much as literals
+MAX_CANDIDATES = 32     # positions tried per match, trades speed for ratio
+
+
+class BitWriter(object):
+    def __init__(self):
+        self.out = bytearray()
+        self.current = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        for i in range(bits - 1, -1, -1):
+            self.current = (self.current << 1) | ((value >> i) & 1)
+            self.count += 1
+            if self.count == 8:
+                self.out.append(self.current)
+                self.current = 0
+                self.count = 0
+
+    def finish(self):
+        if self.count:
+            self.out.append(self.current << (8 - self.count))
+        return bytes(self.out)
+
+
+def compress(data, window_bits, lookahead_bits):
+    window = 1 << window_bits
+    max_match = 1 << lookahead_bits
+    chains = {}
+    bits = BitWriter()
+    pos = 0
+
+    def remember(p):
+        if p + MIN_MATCH <= len(data):
+            chains.setdefault(data[p:p + MIN_MATCH], []).append(p)
+
+    while pos < len(data):
+        best_len, best_off = 0, 0
+        limit = min(max_match, len(data) - pos)
+        if limit >= MIN_MATCH:
+            candidates = chains.get(data[pos:pos + MIN_MATCH], [])
+            for cand in reversed(candidates[-MAX_CANDIDATES:]):
+                off = pos - cand
+                if off > window:
+                    break
+                length = MIN_MATCH
+                while length < limit and data[cand + length] == data[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_off = length, off
+                    if length == limit:
+                        break
+        if best_len >= MIN_MATCH:
+            bits.write(0, 1)
+            bits.write(best_off - 1, window_bits)
+            bits.write(best_len - 1, lookahead_bits)
+            step = best_len
+        else:
+            bits.write(1, 1)
+            bits.write(data[pos], 8)
+            step = 1
+        for p in range(pos, pos + step):
+            remember(p)
+        pos += step
+    return bits.finish()
+
+
+def decompress(stream, size, window_bits, lookahead_bits):
+    out = bytearray()
+    state = {'pos': 0, 'mask': 0, 'current': 0}
+
+    def get(bits):
+        value = 0
+        for _ in range(bits):
+            if state['mask'] == 0:
+                state['current'] = stream[state['pos']]
+                state['pos'] += 1
+                state['mask'] = 0x80
+            value = (value << 1) | (1 if state['current'] & state['mask'] else 0)
+            state['mask'] >>= 1
+        return value
+
+    try:
+        while len(out) < size:
+            if get(1):
+                out.append(get(8))
+            else:
+                off = get(window_bits) + 1
+                for _ in range(get(lookahead_bits) + 1):
+                    # references before the start read the zeroed window
+                    out.append(out[-off] if off <= len(out) else 0)
+    except IndexError:
+        pass    # the stream ran out, the caller checks the size
+    return bytes(out[:size])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack a firmware image for compressed OTA.')
+    parser.add_argument('-w', '--window', type=int, default=11, help='window bits, 4..15 (default 11, 2KB of RAM on the device)')
+    parser.add_argument('-l', '--lookahead', type=int, default=4, help='lookahead bits, 3..window-1 (default 4)')
+    parser.add_argument('-d', '--decompress', action='store_true', help='unpack a compressed image instead')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    if args.decompress:
+        magic, algorithm, window_bits, lookahead_bits, _, size, md5 = HEADER.unpack_from(data)
+        if magic != MAGIC or algorithm != ALGORITHM_LZSS:
+            sys.exit('not a compressed image')
+        image = decompress(data[HEADER.size:], size, window_bits, lookahead_bits)
+        if hashlib.md5(image).digest() != md5:
+            sys.exit('MD5 mismatch')
+        with open(args.output, 'wb') as f:
+            f.write(image)
+        return
+
+    if not 4 <= args.window <= 15 or not 3 <= args.lookahead < args.window:
+        sys.exit('bad window or lookahead size')
+    md5 = hashlib.md5(data).digest()
+    stream = compress(data, args.window, args.lookahead)
+    # the image is checked by unpacking it again before it is written out
+    if decompress(stream, len(data), args.window, args.lookahead) != data:
+        sys.exit('internal error: round trip failed')
+    with open(args.output, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, ALGORITHM_LZSS, args.window, args.lookahead, 0, len(data), md5))
+        f.write(stream)
+    print('%s: %d -> %d bytes (%.1f%%)' % (args.input, len(data), HEADER.size + len(stream),
+                                          100.0 * (HEADER.size + len(stream)) / max(len(data), 1)))
+
+
+if __name__ == '__main__':
+    main()
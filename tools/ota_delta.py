@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""
+Builds a delta OTA patch turning the image running on a device into a new one.
+
+The output is a 48 byte little endian header followed by the patch operations
+coded as the same LZSS bit stream as ota_compress.py:
+
+    uint32 magic            0x444f5249 ("IROD")
+    uint8  algorithm        1 = LZSS
+    uint8  window bits
+    uint8  lookahead bits
+    uint8  reserved         0
+    uint32 size             size of the new image
+    uint8  md5[16]          MD5 of the new image
+    uint32 base size        size of the image the patch applies to
+    uint8  md5[16]          MD5 of that image
+
+The device checks the base MD5 against its application region before taking
+the patch, see services/inc/delta_patch.h for the operations.
+
+usage: ota_delta.py [-w 11] [-l 4] base new output
+       ota_delta.py -a base patch output
+"""
+
+import argparse
+import hashlib
+import re
+import struct
+import sys
+
+import ota_compress
+
+MAGIC = 0x444f5249
+HEADER = struct.Struct('<IBBBBI16sI16s')
+OP_COPY, OP_ADD, OP_INSERT = 1, 2, 3
+BLOCK = 8               # bytes hashed to find matches in the base
+MIN_MATCH = 16          # exact match needed to start a region
+MAX_CANDIDATES = 8      # base positions remembered per block
+MIN_COPY = 32           # unchanged runs worth a COPY instead of zero diffs
+GIVE_UP = 32            # mismatches beyond the best point that end a region
+
+
+def match_length(base, b, new, n):
+    length = 0
+    while n + length < len(new) and b + length < len(base):
+        step = min(32, len(new) - n - length, len(base) - b - length)
+        if base[b + length:b + length + step] == new[n + length:n + length + step]:
+            length += step
+            continue
+        while base[b + length] == new[n + length]:
+            length += 1
+        break
+    return length
+
+
+def extend(base, b, new, n):
+    """Grows a match while it stays mostly equal, as bsdiff does."""
+    score = best = 0
+    end = n
+    while n < len(new) and b < len(base):
+        score += 1 if new[n] == base[b] else -1
+        n += 1
+        b += 1
+        if score > best:
+            best, end = score, n
+        elif best - score > GIVE_UP:
+            break
+    return end
+
+
+def region_ops(offset, base, segment):
+    diffs = bytes((x - base[offset + i]) & 0xff for i, x in enumerate(segment))
+    ops = bytearray()
+    pos = 0
+
+    def add(start, end):
+        if end > start:
+            ops.extend(struct.pack('<BII', OP_ADD, offset + start, end - start))
+            ops.extend(diffs[start:end])
+
+    for run in re.finditer(b'\x00{%d,}' % MIN_COPY, diffs):
+        add(pos, run.start())
+        ops.extend(struct.pack('<BII', OP_COPY, offset + run.start(), run.end() - run.start()))
+        pos = run.end()
+    add(pos, len(diffs))
+    return ops
+
+
+def diff(base, new):
+    index = {}
+    for p in range(len(base) - BLOCK + 1):
+        positions = index.setdefault(base[p:p + BLOCK], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(p)
+
+    ops = bytearray()
+    literal = pos = 0
+
+    def insert(end):
+        if end > literal:
+            ops.extend(struct.pack('<BI', OP_INSERT, end - literal))
+            ops.extend(new[literal:end])
+
+    while pos + BLOCK <= len(new):
+        best_len, best_off = 0, 0
+        for cand in index.get(new[pos:pos + BLOCK], ()):
+            length = match_length(base, cand, new, pos)
+            if length > best_len:
+                best_len, best_off = length, cand
+        if best_len < MIN_MATCH:
+            pos += 1
+            continue
+        end = max(pos + best_len, extend(base, best_off + best_len, new, pos + best_len))
+        insert(pos)
+        ops.extend(region_ops(best_off, base, new[pos:end]))
+        pos = literal = end
+    insert(len(new))
+    return bytes(ops)
+
+
+def apply(base, ops, size):
+    out = bytearray()
+    pos = 0
+    while len(out) < size:
+        op = ops[pos]
+        if op == OP_INSERT:
+            length, = struct.unpack_from('<I', ops, pos + 1)
+            pos += 5
+            out.extend(ops[pos:pos + length])
+            pos += length
+        elif op in (OP_COPY, OP_ADD):
+            offset, length = struct.unpack_from('<II', ops, pos + 1)
+            pos += 9
+            if offset + length > len(base):
+                raise ValueError('operation outside the base')
+            if op == OP_COPY:
+                out.extend(base[offset:offset + length])
+            else:
+                out.extend((base[offset + i] + ops[pos + i]) & 0xff for i in range(length))
+                pos += length
+        else:
+            raise ValueError('bad operation %d' % op)
+    return bytes(out[:size])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build a delta OTA patch.')
+    parser.add_argument('-w', '--window', type=int, default=11, help='window bits, 4..15 (default 11, 2KB of RAM on the device)')
+    parser.add_argument('-l', '--lookahead', type=int, default=4, help='lookahead bits, 3..window-1 (default 4)')
+    parser.add_argument('-a', '--apply', action='store_true', help='apply a patch to base instead')
+    parser.add_argument('base')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    with open(args.base, 'rb') as f:
+        base = f.read()
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    if args.apply:
+        magic, algorithm, window_bits, lookahead_bits, _, size, md5, base_size, base_md5 = HEADER.unpack_from(data)
+        if magic != MAGIC or algorithm != ota_compress.ALGORITHM_LZSS:
+            sys.exit('not a delta patch')
+        if base_size > len(base) or hashlib.md5(base[:base_size]).digest() != base_md5:
+            sys.exit('base does not match')
+        stream = data[HEADER.size:]
+        # the stream has no end marker, unpack until the operations cover size
+        ops = ota_compress.decompress(stream, len(stream) * 8, window_bits, lookahead_bits)
+        image = apply(base[:base_size], ops, size)
+        if hashlib.md5(image).digest() != md5:
+            sys.exit('MD5 mismatch')
+        with open(args.output, 'wb') as f:
+            f.write(image)
+        return
+
+    if not 4 <= args.window <= 15 or not 3 <= args.lookahead < args.window:
+        sys.exit('bad window or lookahead size')
+    ops = diff(base, data)
+    # the patch is checked by applying it again before it is written out
+    if apply(base, ops, len(data)) != data:
+        sys.exit('internal error: round trip failed')
+    stream = ota_compress.compress(ops, args.window, args.lookahead)
+    with open(args.output, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, ota_compress.ALGORITHM_LZSS, args.window, args.lookahead, 0,
+                            len(data), hashlib.md5(data).digest(), len(base), hashlib.md5(base).digest()))
+        f.write(stream)
+    print('%s: %d -> %d bytes (%.1f%%)' % (args.input, len(data), HEADER.size + len(stream),
+                                          100.0 * (HEADER.size + len(stream)) / max(len(data), 1)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,114 @@
+/**
+ ******************************************************************************
+ * @file    hal_sim.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+
+/* Host versions of the HAL functions called by the modem driver */
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "hw_config.h"
+#include "timer_hal.h"
+#include "delay_hal.h"
+#include "net_hal.h"
+#include "concurrent_hal.h"
+#include "hal_sim.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const Clock::time_point boot = Clock::now();
+
+GPIO_TypeDef sim_gpio[3];
+SimNetEvents simNet;
+
+system_tick_t HAL_Timer_Get_Micro_Seconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - boot).count();
+}
+
+system_tick_t HAL_Timer_Get_Milli_Seconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - boot).count();
+}
+
+void HAL_Delay_Milliseconds(uint32_t millis)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+}
+
+void HAL_Delay(uint32_t ms)
+{
+    HAL_Delay_Milliseconds(ms);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef* port, GPIO_InitTypeDef* init)
+{
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state)
+{
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin)
+{
+    return GPIO_PIN_RESET;
+}
+
+void HAL_NET_notify_connected()
+{
+    simNet.connected++;
+}
+
+void HAL_NET_notify_disconnected()
+{
+    simNet.disconnected++;
+}
+
+void HAL_NET_notify_dhcp(bool dhcp)
+{
+    if (dhcp)
+        simNet.dhcp++;
+}
+
+int os_mutex_recursive_create(os_mutex_recursive_t* mutex)
+{
+    *mutex = new std::recursive_mutex;
+    return 0;
+}
+
+int os_mutex_recursive_destroy(os_mutex_recursive_t mutex)
+{
+    delete (std::recursive_mutex*)mutex;
+    return 0;
+}
+
+int os_mutex_recursive_lock(os_mutex_recursive_t mutex)
+{
+    ((std::recursive_mutex*)mutex)->lock();
+    return 0;
+}
+
+int os_mutex_recursive_unlock(os_mutex_recursive_t mutex)
+{
+    ((std::recursive_mutex*)mutex)->unlock();
+    return 0;
+}
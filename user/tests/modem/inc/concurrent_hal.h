@@ -0,0 +1,42 @@
+/**
+ ******************************************************************************
+ * @file    concurrent_hal.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/* Host stand-in, the modem driver only takes a recursive mutex. */
+
+#ifndef CONCURRENT_HAL_H
+#define CONCURRENT_HAL_H
+
+typedef void* os_mutex_recursive_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int os_mutex_recursive_create(os_mutex_recursive_t* mutex);
+int os_mutex_recursive_destroy(os_mutex_recursive_t mutex);
+int os_mutex_recursive_lock(os_mutex_recursive_t mutex);
+int os_mutex_recursive_unlock(os_mutex_recursive_t mutex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONCURRENT_HAL_H */
@@ -0,0 +1,30 @@
+/**
+ ******************************************************************************
+ * @file    flash_map.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/* Host stand-in, see hal/src/neutron/flash_map.h */
+
+#ifndef FLASH_MAP_H
+#define FLASH_MAP_H
+
+#define CACHE_BOOTLOADER_START_ADDR      ((uint32_t)0x08016000)
+#define APP_ADDR                         ((uint32_t)0x08020000)
+
+#endif /* FLASH_MAP_H */
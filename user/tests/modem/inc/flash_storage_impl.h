@@ -0,0 +1,36 @@
+/**
+ ******************************************************************************
+ * @file    flash_storage_impl.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/* Host stand-in, flash writes of the driver are dropped. */
+
+#ifndef FLASH_STORAGE_IMPL_H
+#define FLASH_STORAGE_IMPL_H
+
+class InternalFlashStore
+{
+public:
+    int write(const unsigned offset, const void* data, const unsigned size)
+    {
+        return 0;
+    }
+};
+
+#endif /* FLASH_STORAGE_IMPL_H */
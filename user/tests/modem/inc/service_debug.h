@@ -0,0 +1,37 @@
+/**
+ ******************************************************************************
+ * @file    service_debug.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/* Host stand-in, driver traces go to stderr when MDM_SIM_TRACE is defined. */
+
+#ifndef SERVICE_DEBUG_H
+#define SERVICE_DEBUG_H
+
+#include <stdio.h>
+
+#ifdef MDM_SIM_TRACE
+#define DEBUG(...)      do {fprintf(stderr, __VA_ARGS__); fputc('\n', stderr);} while (0)
+#define DEBUG_D(...)    do {fprintf(stderr, __VA_ARGS__);} while (0)
+#else
+#define DEBUG(...)      do {} while (0)
+#define DEBUG_D(...)    do {} while (0)
+#endif
+
+#endif /* SERVICE_DEBUG_H */
@@ -0,0 +1,425 @@
+/**
+ ******************************************************************************
+ * @file    main.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+
+/* Drives the modem driver against the simulated modem and local TCP / UDP
+   servers, reports the latency of each socket operation and the transfer
+   rates. Exits with 1 if an operation failed or data came back wrong. */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mdm_hal.h"
+#include "modem_sim.h"
+#include "hal_sim.h"
+
+#ifdef MDM_SIM_SIM800
+MDMCellularSerial CellularMDM;
+static MDMParser& modem = CellularMDM;
+#else
+MDMEsp8266Serial esp8266MDM;
+static MDMParser& modem = esp8266MDM;
+#endif
+
+#define RECV_TIMEOUT    10000   //!< ms to wait for data before an operation fails
+
+typedef std::chrono::steady_clock Clock;
+
+//! latency of an operation
+struct Op {
+    std::string name;
+    int count;
+    double min, max, total;
+};
+
+//! rate of a transfer
+struct Transfer {
+    std::string name;
+    int bytes;
+    double seconds;
+};
+
+static std::vector<Op> ops;
+static std::vector<Transfer> transfers;
+static int failures;
+
+static double elapsed(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void record(const char* name, Clock::time_point start)
+{
+    double ms = elapsed(start);
+    for (size_t i = 0; i < ops.size(); i++) {
+        if (ops[i].name == name) {
+            Op& op = ops[i];
+            op.count++;
+            op.total += ms;
+            if (ms < op.min) op.min = ms;
+            if (ms > op.max) op.max = ms;
+            return;
+        }
+    }
+    Op op = { name, 1, ms, ms, ms };
+    ops.push_back(op);
+}
+
+static bool check(bool ok, const char* what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+    return ok;
+}
+
+static void pattern(std::string& data, int len, int seed)
+{
+    data.resize(len);
+    for (int i = 0; i < len; i++)
+        data[i] = char((i * 31 + seed) >> 2);
+}
+
+// local servers -------------------------------------------------------------
+
+static int listenOn(int type, int& port)
+{
+    int fd = socket(AF_INET, type, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(addr);
+    if ((fd < 0) || bind(fd, (struct sockaddr*)&addr, sizeof(addr))
+            || ((type == SOCK_STREAM) && listen(fd, 4))
+            || getsockname(fd, (struct sockaddr*)&addr, &size)) {
+        perror("server");
+        exit(2);
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+//! accept connections and hand each one to fn on its own thread
+static int serveTcp(void (*fn)(int fd, int bytes), int bytes)
+{
+    int port;
+    int fd = listenOn(SOCK_STREAM, port);
+    std::thread([=]() {
+        for (;;) {
+            int c = accept(fd, NULL, NULL);
+            if (c < 0)
+                break;
+            std::thread([=]() { fn(c, bytes); close(c); }).detach();
+        }
+    }).detach();
+    return port;
+}
+
+static void echo(int fd, int bytes)
+{
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        if (send(fd, buf, n, 0) != n)
+            break;
+    }
+}
+
+static void discard(int fd, int bytes)
+{
+    char buf[4096];
+    while (recv(fd, buf, sizeof(buf), 0) > 0)
+        /* drop it */;
+}
+
+static void source(int fd, int bytes)
+{
+    std::string data;
+    pattern(data, bytes, 7);
+    send(fd, data.data(), data.size(), 0);
+}
+
+//! reset the connection, writes that reach the peer after it fail
+static void reset(int fd, int bytes)
+{
+    struct linger lin = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+}
+
+static int serveUdpEcho(void)
+{
+    int port;
+    int fd = listenOn(SOCK_DGRAM, port);
+    std::thread([=]() {
+        char buf[2048];
+        struct sockaddr_in addr;
+        for (;;) {
+            socklen_t size = sizeof(addr);
+            ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&addr, &size);
+            if (n < 0)
+                break;
+            sendto(fd, buf, n, 0, (struct sockaddr*)&addr, size);
+        }
+    }).detach();
+    return port;
+}
+
+// driver helpers -----------------------------------------------------------
+
+//! read len bytes from a socket, false on timeout
+static bool receive(int socket, char* buf, int len)
+{
+    int got = 0;
+    Clock::time_point start = Clock::now();
+    while ((got < len) && (elapsed(start) < RECV_TIMEOUT)) {
+        int n = modem.socketRecv(socket, buf + got, len - got);
+        if (n > 0) {
+            got += n;
+            modemSim.consumed(socket, n);
+        }
+    }
+    return got == len;
+}
+
+static int connectTo(IpProtocol proto, MDM_IP ip, int port)
+{
+    int socket = modem.socketCreate(proto);
+    if (!check(socket >= 0, "socketCreate"))
+        return -1;
+    Clock::time_point start = Clock::now();
+    bool ok = modem.socketConnect(socket, ip, port);
+    record(proto == MDM_IPPROTO_TCP ? "tcp connect" : "udp connect", start);
+    if (!check(ok, "socketConnect")) {
+        modem.socketFree(socket);
+        return -1;
+    }
+    return socket;
+}
+
+static void shut(int socket, const char* name)
+{
+    Clock::time_point start = Clock::now();
+    modem.socketFree(socket);
+    record(name, start);
+}
+
+// scenarios ----------------------------------------------------------------
+
+static void tcpEcho(MDM_IP ip, int port, int rounds, int bytes)
+{
+    int s = connectTo(MDM_IPPROTO_TCP, ip, port);
+    if (s < 0)
+        return;
+    std::string out, in;
+    pattern(out, 32, 1);
+    in.resize(out.size());
+    for (int r = 0; r < rounds; r++) {
+        Clock::time_point start = Clock::now();
+        check(modem.socketSend(s, out.data(), out.size()) == (int)out.size(), "tcp send");
+        record("tcp send", start);
+        check(receive(s, &in[0], in.size()) && (in == out), "tcp echo");
+        record("tcp echo 32", start);
+    }
+
+    // keep the uplink busy while reading back what is echoed
+    pattern(out, bytes, 3);
+    in.assign(bytes, 0);
+    int sent = 0, got = 0;
+    Clock::time_point start = Clock::now();
+    while ((got < bytes) && (elapsed(start) < RECV_TIMEOUT * 10)) {
+        if (sent < bytes) {
+            int n = modem.socketSend(s, out.data() + sent, std::min(1024, bytes - sent));
+            if (!check(n > 0, "tcp bulk send"))
+                break;
+            sent += n;
+        }
+        int n = modem.socketRecv(s, &in[got], bytes - got);
+        if (n > 0) {
+            got += n;
+            modemSim.consumed(s, n);
+        }
+    }
+    Transfer t = { "tcp echo", bytes, elapsed(start) / 1000 };
+    transfers.push_back(t);
+    check(in == out, "tcp bulk echo");
+    shut(s, "tcp close");
+}
+
+static void tcpUpload(MDM_IP ip, int port, int bytes)
+{
+    int s = connectTo(MDM_IPPROTO_TCP, ip, port);
+    if (s < 0)
+        return;
+    std::string out;
+    pattern(out, bytes, 5);
+    Clock::time_point start = Clock::now();
+    check(modem.socketSend(s, out.data(), out.size()) == bytes, "tcp upload");
+    // closing waits for the queued data
+    modem.socketClose(s);
+    Transfer t = { "tcp upload", bytes, elapsed(start) / 1000 };
+    transfers.push_back(t);
+    modem.socketFree(s);
+}
+
+static void tcpDownload(MDM_IP ip, int port, int bytes)
+{
+    Clock::time_point start = Clock::now();
+    int s = connectTo(MDM_IPPROTO_TCP, ip, port);
+    if (s < 0)
+        return;
+    std::string in(bytes, 0), expect;
+    pattern(expect, bytes, 7);
+    check(receive(s, &in[0], bytes) && (in == expect), "tcp download");
+    Transfer t = { "tcp download", bytes, elapsed(start) / 1000 };
+    transfers.push_back(t);
+    modem.socketFree(s);
+}
+
+static void tcpSendFail(MDM_IP ip, int port)
+{
+    int s = connectTo(MDM_IPPROTO_TCP, ip, port);
+    if (s < 0)
+        return;
+    // a queued write fails in the modem, a later call has to say so
+    std::string out;
+    pattern(out, 256, 11);
+    int n = 0;
+    Clock::time_point start = Clock::now();
+    while ((n >= 0) && (elapsed(start) < RECV_TIMEOUT)) {
+        n = modem.socketSend(s, out.data(), out.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(n < 0, "tcp send to a reset peer");
+#ifndef MDM_SIM_SIM800
+    // the ESP8266 drivers queue writes, the others fail in socketSend itself
+    check(!modem.socketIsConnected(s), "tcp send failure disconnects");
+    check(modem.socketReadable(s) < 0, "tcp send failure is reported on read");
+#endif
+    shut(s, "tcp close");
+}
+
+static void udpEcho(MDM_IP ip, int port, int rounds)
+{
+    int s = connectTo(MDM_IPPROTO_UDP, ip, port);
+    if (s < 0)
+        return;
+    std::string out, in;
+    pattern(out, 64, 9);
+    in.resize(out.size());
+    for (int r = 0; r < rounds; r++) {
+        Clock::time_point start = Clock::now();
+        check(modem.socketSendTo(s, ip, port, out.data(), out.size()) == (int)out.size(), "udp send");
+        check(receive(s, &in[0], in.size()) && (in == out), "udp echo");
+        record("udp echo 64", start);
+    }
+    shut(s, "udp close");
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-s script] [-n bytes] [-r rounds]\n", name);
+    exit(2);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* script = NULL;
+    int bytes = 65536;
+    int rounds = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:r:")) != -1) {
+        switch (opt) {
+            case 's': script = optarg; break;
+            case 'n': bytes = atoi(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (script && !modemSim.load(script)) {
+        fprintf(stderr, "cannot read %s\n", script);
+        return 2;
+    }
+
+    int echoPort = serveTcp(echo, 0);
+    int discardPort = serveTcp(discard, 0);
+    int sourcePort = serveTcp(source, bytes);
+    int resetPort = serveTcp(reset, 0);
+    int udpPort = serveUdpEcho();
+
+    Clock::time_point start = Clock::now();
+#ifdef MDM_SIM_SIM800
+    bool up = modem.connect();
+#else
+    bool up = modem.init();
+#endif
+    record("init", start);
+    if (check(up, "modem init")) {
+        start = Clock::now();
+#ifdef MDM_SIM_SIM800
+        MDM_IP ip = modem.gethostbyname("localhost");
+#else
+        MDM_IP ip = modem.getHostByName("localhost");
+#endif
+        record("dns", start);
+        if (check(ip == IPADR(127,0,0,1), "resolve localhost")) {
+            tcpEcho(ip, echoPort, rounds, bytes);
+            tcpUpload(ip, discardPort, bytes);
+            tcpDownload(ip, sourcePort, bytes);
+            tcpSendFail(ip, resetPort);
+            udpEcho(ip, udpPort, rounds);
+        }
+    }
+    // let late urcs of the script arrive
+    modem.waitFinalResp(NULL, NULL, 100);
+
+    printf("%-16s %6s %9s %9s %9s\n", "operation", "count", "min ms", "avg ms", "max ms");
+    for (size_t i = 0; i < ops.size(); i++) {
+        const Op& op = ops[i];
+        printf("%-16s %6d %9.2f %9.2f %9.2f\n", op.name.c_str(), op.count, op.min, op.total / op.count, op.max);
+    }
+    printf("\n%-16s %9s %9s %9s\n", "transfer", "bytes", "seconds", "bytes/s");
+    for (size_t i = 0; i < transfers.size(); i++) {
+        const Transfer& t = transfers[i];
+        printf("%-16s %9d %9.3f %9.0f\n", t.name.c_str(), t.bytes, t.seconds, t.bytes / t.seconds);
+    }
+    ModemSim::Stats st = modemSim.stats();
+    printf("\nuart: %llu bytes out, %llu bytes in, %llu held back, %llu commands\n",
+            (unsigned long long)st.txBytes, (unsigned long long)st.rxBytes,
+            (unsigned long long)st.rxHeld, (unsigned long long)st.commands);
+    printf("sockets: %llu bytes sent, %llu bytes received\n",
+            (unsigned long long)st.sockTx, (unsigned long long)st.sockRx);
+    printf("net: %d connected, %d dhcp, %d disconnected\n",
+            simNet.connected, simNet.dhcp, simNet.disconnected);
+    modemSim.stop();
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
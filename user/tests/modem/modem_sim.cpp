@@ -0,0 +1,615 @@
+/**
+ ******************************************************************************
+ * @file    modem_sim.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+
+#include "modem_sim.h"
+
+#ifdef MDM_SIM_SIM800
+#define SIM_WINDOW      1460    //!< bytes buffered by the modem before the driver reads them
+#else
+#define SIM_WINDOW      2920
+#endif
+#define SIM_SEGMENT     1460    //!< max payload pushed in one +IPD / +RECEIVE
+#define SIM_PIECE       32      //!< bytes delivered to the pipe at once
+#define SIM_SOCKET_ROOM 2047    //!< room of a socket pipe of the driver, Pipe<char>(MAX_SIZE)
+
+ModemSim modemSim;
+
+static std::string unescape(const std::string& s)
+{
+    std::string r;
+    for (size_t i = 0; i < s.size(); i++) {
+        char ch = s[i];
+        if ((ch == '\\') && (i + 1 < s.size())) {
+            ch = s[++i];
+            if (ch == 'r') ch = '\r';
+            else if (ch == 'n') ch = '\n';
+        }
+        r += ch;
+    }
+    return r;
+}
+
+static std::string trim(const std::string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return (b == std::string::npos) ? std::string() : s.substr(b, e - b + 1);
+}
+
+//! split the arguments of a command at the commas outside quotes, the quotes are removed
+static std::vector<std::string> arguments(const std::string& cmd)
+{
+    std::vector<std::string> args;
+    size_t eq = cmd.find('=');
+    if (eq == std::string::npos)
+        return args;
+    std::string arg;
+    bool quoted = false;
+    for (size_t i = eq + 1; i < cmd.size(); i++) {
+        char ch = cmd[i];
+        if (ch == '"')
+            quoted = !quoted;
+        else if ((ch == ',') && !quoted) {
+            args.push_back(arg);
+            arg.clear();
+        } else
+            arg += ch;
+    }
+    args.push_back(arg);
+    return args;
+}
+
+static std::string format(const char* fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+ModemSim::ModemSim(void)
+{
+    _rx = NULL;
+    _baud = 0;
+    _latency = 1;
+    _wake[0] = _wake[1] = -1;
+    _running = false;
+    _downBytes = 0;
+    _sendSocket = -1;
+    _sendLeft = 0;
+    _sendPort = 0;
+    memset(&_stats, 0, sizeof(_stats));
+    // a socket closed by the peer must not kill the run
+    signal(SIGPIPE, SIG_IGN);
+}
+
+ModemSim::~ModemSim(void)
+{
+    stop();
+}
+
+bool ModemSim::load(const char* file)
+{
+    std::ifstream in(file);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || (line[0] == '#'))
+            continue;
+        size_t arrow = line.find(" -> ");
+        if (arrow == std::string::npos) {
+            unsigned value;
+            if (sscanf(line.c_str(), "baud %u", &value) == 1)
+                _baud = value;
+            else if (sscanf(line.c_str(), "latency %u", &value) == 1)
+                _latency = value;
+            else
+                fprintf(stderr, "%s: ignoring \"%s\"\n", file, line.c_str());
+            continue;
+        }
+        Rule rule;
+        std::string lhs = trim(line.substr(0, arrow));
+        rule.text = unescape(trim(line.substr(arrow + 4)));
+        rule.delay = -1;
+        if (lhs[0] == '@') {
+            rule.delay = atoi(lhs.c_str() + 1);
+            _urcs.push_back(rule);
+            continue;
+        }
+        size_t plus = lhs.rfind(" +");
+        if (plus != std::string::npos) {
+            rule.delay = atoi(lhs.c_str() + plus + 2);
+            lhs = trim(lhs.substr(0, plus));
+        }
+        rule.prefix = lhs;
+        _rules.push_back(rule);
+    }
+    return true;
+}
+
+void ModemSim::start(Pipe<char>* rx, unsigned baud)
+{
+    if (_running)
+        return;
+    _rx = rx;
+    if (!_baud)
+        _baud = baud;
+    if (pipe(_wake) == 0) {
+        fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+    }
+    Clock::time_point now = Clock::now();
+    _upAt = _downAt = now;
+    for (size_t i = 0; i < _urcs.size(); i++)
+        _later(_urcs[i].text, now + std::chrono::milliseconds(_urcs[i].delay));
+    _running = true;
+    _thread = std::thread(&ModemSim::_run, this);
+}
+
+void ModemSim::stop(void)
+{
+    if (!_running)
+        return;
+    _running = false;
+    char ch = 0;
+    if (::write(_wake[1], &ch, 1) < 0)
+        /* the thread wakes up by itself */;
+    _thread.join();
+    while (!_sockets.empty())
+        _close(_sockets.begin()->first);
+    close(_wake[0]);
+    close(_wake[1]);
+}
+
+void ModemSim::write(const void* buf, int len)
+{
+    Clock::time_point at;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        at = std::max(Clock::now(), _upAt) + _wire(len);
+        _upAt = at;
+        Chunk chunk = { at, std::string((const char*)buf, len) };
+        _up.push_back(chunk);
+        _stats.txBytes += len;
+    }
+    char ch = 0;
+    if (::write(_wake[1], &ch, 1) < 0)
+        /* a wake up is already pending */;
+    // the UART of the driver is blocking
+    std::this_thread::sleep_until(at);
+}
+
+void ModemSim::consumed(int id, int len)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::map<int, int>::iterator it = _room.find(id);
+        if (it == _room.end())
+            return;
+        it->second = std::min(it->second + len, SIM_SOCKET_ROOM);
+    }
+    char ch = 0;
+    if (::write(_wake[1], &ch, 1) < 0)
+        /* a wake up is already pending */;
+}
+
+ModemSim::Stats ModemSim::stats(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+ModemSim::Clock::duration ModemSim::_wire(size_t len) const
+{
+    // 8N1, ten bits a byte
+    return std::chrono::nanoseconds(uint64_t(len) * 10 * 1000000000ULL / _baud);
+}
+
+void ModemSim::_run(void)
+{
+    while (_running) {
+        Clock::time_point now = Clock::now();
+        std::deque<Chunk> up;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (!_up.empty() && (_up.front().at <= now)) {
+                up.push_back(_up.front());
+                _up.pop_front();
+            }
+        }
+        for (size_t i = 0; i < up.size(); i++)
+            _input(up[i].data, now);
+        while (!_timed.empty() && (_timed.front().at <= now)) {
+            _emit(_timed.front().data, now);
+            _timed.pop_front();
+        }
+        _poll(now);
+        bool held = !_deliver(now);
+
+        // sleep until the next byte is due or a socket has data
+        Clock::time_point next = now + std::chrono::milliseconds(5);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_up.empty())
+                next = std::min(next, _up.front().at);
+        }
+        if (!_timed.empty())
+            next = std::min(next, _timed.front().at);
+        if (!_down.empty())
+            next = std::min(next, held ? now + std::chrono::milliseconds(1) : _down.front().at);
+        std::vector<struct pollfd> fds(1);
+        fds[0].fd = _wake[0];
+        fds[0].events = POLLIN;
+        if (_downBytes + SIM_SEGMENT <= SIM_WINDOW) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (std::map<int, Sock>::iterator it = _sockets.begin(); it != _sockets.end(); ++it) {
+                if (!_room[it->first])
+                    continue;
+                struct pollfd fd = { it->second.fd, POLLIN, 0 };
+                fds.push_back(fd);
+            }
+        }
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next - Clock::now()).count();
+        if (ns < 0)
+            ns = 0;
+        struct timespec ts = { time_t(ns / 1000000000), long(ns % 1000000000) };
+        ppoll(&fds[0], fds.size(), &ts, NULL);
+        if (fds[0].revents) {
+            char buf[64];
+            while (read(_wake[0], buf, sizeof(buf)) > 0)
+                /* drain */;
+        }
+    }
+}
+
+void ModemSim::_input(const std::string& data, Clock::time_point now)
+{
+    for (size_t i = 0; i < data.size(); i++) {
+        if (_sendLeft > 0) {
+            size_t n = std::min(size_t(_sendLeft), data.size() - i);
+            _sendData.append(data, i, n);
+            _sendLeft -= n;
+            i += n - 1;
+            if (_sendLeft == 0)
+                _data(now);
+            continue;
+        }
+        _line += data[i];
+        size_t len = _line.size();
+        if ((len >= 2) && (_line[len - 2] == '\r') && (_line[len - 1] == '\n')) {
+            std::string cmd = trim(_line);
+            _line.clear();
+            if (!cmd.empty())
+                _command(cmd, now);
+        }
+    }
+}
+
+void ModemSim::_command(const std::string& cmd, Clock::time_point now)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.commands++;
+    }
+    Clock::time_point at = now + std::chrono::milliseconds(_latency);
+    const Rule* answer = NULL;
+    for (size_t i = 0; (i < _rules.size()) && !answer; i++) {
+        if ((_rules[i].delay < 0) && (cmd.compare(0, _rules[i].prefix.size(), _rules[i].prefix) == 0))
+            answer = &_rules[i];
+    }
+    if (answer)
+        _later(answer->text, at);
+    else if (!_builtin(cmd, at))
+        _later("\r\nOK\r\n", at);
+    for (size_t i = 0; i < _rules.size(); i++) {
+        if ((_rules[i].delay >= 0) && (cmd.compare(0, _rules[i].prefix.size(), _rules[i].prefix) == 0))
+            _later(_rules[i].text, at + std::chrono::milliseconds(_rules[i].delay));
+    }
+}
+
+bool ModemSim::_builtin(const std::string& cmd, Clock::time_point at)
+{
+    std::vector<std::string> args = arguments(cmd);
+    if (!cmd.compare(0, 12, "AT+CIPSTART=") && (args.size() >= 4)) {
+        int id = atoi(args[0].c_str());
+        bool udp = (args[1] == "UDP");
+        int local = (args.size() >= 5) ? atoi(args[4].c_str()) : 0;
+        bool ok = _open(id, udp, args[2], atoi(args[3].c_str()), local);
+#ifdef MDM_SIM_SIM800
+        _later("\r\nOK\r\n", at);
+        _later(format(ok ? "\r\n%d, CONNECT OK\r\n" : "\r\n%d, CONNECT FAIL\r\n", id), at);
+#else
+        _later(ok ? format("%d,CONNECT\r\n\r\nOK\r\n", id) : std::string("\r\nERROR\r\n"), at);
+#endif
+        return true;
+    }
+    if (!cmd.compare(0, 11, "AT+CIPSEND=") && (args.size() >= 2)) {
+        int id = atoi(args[0].c_str());
+        if (!_sockets.count(id)) {
+            _later("\r\nERROR\r\n", at);
+            return true;
+        }
+        _sendSocket = id;
+        _sendLeft = atoi(args[1].c_str());
+        _sendData.clear();
+        _sendHost = (args.size() >= 4) ? args[2] : std::string();
+        _sendPort = (args.size() >= 4) ? atoi(args[3].c_str()) : 0;
+#ifdef MDM_SIM_SIM800
+        _later("\r\n> ", at);
+#else
+        _later("\r\nOK\r\n> ", at);
+#endif
+        return true;
+    }
+    if (!cmd.compare(0, 12, "AT+CIPCLOSE=") && (args.size() >= 1)) {
+        int id = atoi(args[0].c_str());
+        _close(id);
+#ifdef MDM_SIM_SIM800
+        _later(format("\r\n%d, CLOSE OK\r\n", id), at);
+#else
+        _later(format("%d,CLOSED\r\n\r\nOK\r\n", id), at);
+#endif
+        return true;
+    }
+    if (!cmd.compare(0, 13, "AT+CIPDOMAIN=") && (args.size() >= 1)) {
+        std::string ip = _resolve(args[0]);
+        _later(ip.empty() ? std::string("DNS Fail\r\n\r\nERROR\r\n") :
+                "+CIPDOMAIN:" + ip + "\r\n\r\nOK\r\n", at);
+        return true;
+    }
+    if (!cmd.compare(0, 11, "AT+CDNSGIP=") && (args.size() >= 1)) {
+        std::string ip = _resolve(args[0]);
+        _later("\r\nOK\r\n", at);
+        _later(ip.empty() ? format("\r\n+CDNSGIP: 0,8\r\n") :
+                format("\r\n+CDNSGIP: 1,\"%s\", \"%s\"\r\n", args[0].c_str(), ip.c_str()), at);
+        return true;
+    }
+    if (cmd == "AT+CIPSHUT") {
+        while (!_sockets.empty())
+            _close(_sockets.begin()->first);
+        _later("\r\nSHUT OK\r\n", at);
+        return true;
+    }
+    return false;
+}
+
+void ModemSim::_data(Clock::time_point now)
+{
+    Clock::time_point at = now + std::chrono::milliseconds(_latency);
+    int id = _sendSocket;
+    _sendSocket = -1;
+    std::map<int, Sock>::iterator it = _sockets.find(id);
+    bool ok = (it != _sockets.end());
+    if (ok && it->second.udp) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_sendHost.empty() ? it->second.port : _sendPort);
+        inet_pton(AF_INET, _sendHost.empty() ? it->second.host.c_str() : _sendHost.c_str(), &addr.sin_addr);
+        ok = sendto(it->second.fd, _sendData.data(), _sendData.size(), 0,
+                (struct sockaddr*)&addr, sizeof(addr)) == (ssize_t)_sendData.size();
+    } else if (ok) {
+        size_t sent = 0;
+        while (ok && (sent < _sendData.size())) {
+            ssize_t n = send(it->second.fd, _sendData.data() + sent, _sendData.size() - sent, 0);
+            if (n > 0)
+                sent += n;
+            else if ((n < 0) && (errno == EAGAIN)) {
+                struct pollfd fd = { it->second.fd, POLLOUT, 0 };
+                poll(&fd, 1, 100);
+            } else
+                ok = false;
+        }
+    }
+    if (ok) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.sockTx += _sendData.size();
+    }
+#ifdef MDM_SIM_SIM800
+    _later(format(ok ? "\r\n%d, SEND OK\r\n" : "\r\n%d, SEND FAIL\r\n", id), at);
+#else
+    _later(format("\r\nRecv %d bytes\r\n", (int)_sendData.size()), at);
+    _later(ok ? "\r\nSEND OK\r\n" : "\r\nSEND FAIL\r\n", at);
+#endif
+}
+
+void ModemSim::_poll(Clock::time_point now)
+{
+    std::vector<int> closed;
+    for (std::map<int, Sock>::iterator it = _sockets.begin(); it != _sockets.end(); ++it) {
+        // like the module, stop reading while the driver is behind
+        if (_downBytes + SIM_SEGMENT > SIM_WINDOW)
+            break;
+        // and only push what the socket pipe of the driver can take, a
+        // datagram needs room for a whole segment
+        int len;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            len = std::min(_room[it->first], SIM_SEGMENT);
+        }
+        if (it->second.udp && (len < SIM_SEGMENT))
+            len = 0;
+        if (!len)
+            continue;
+        char buf[SIM_SEGMENT];
+        struct sockaddr_in addr;
+        socklen_t size = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        ssize_t n = recvfrom(it->second.fd, buf, len, 0,
+                (struct sockaddr*)&addr, &size);
+        if (n > 0) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stats.sockRx += n;
+                _room[it->first] -= n;
+            }
+#ifdef MDM_SIM_SIM800
+            std::string head = format("\r\n+RECEIVE,%d,%d:\r\n", it->first, (int)n);
+#else
+            char ip[INET_ADDRSTRLEN] = "0.0.0.0";
+            inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+            std::string head = format("\r\n+IPD,%d,%d,%s,%d:", it->first, (int)n, ip, ntohs(addr.sin_port));
+#endif
+            _emit(head + std::string(buf, n), now);
+        } else if ((n == 0) && !it->second.udp) {
+            closed.push_back(it->first);
+        }
+    }
+    for (size_t i = 0; i < closed.size(); i++) {
+        _close(closed[i]);
+#ifdef MDM_SIM_SIM800
+        _emit(format("\r\n%d, CLOSED\r\n", closed[i]), now);
+#else
+        _emit(format("%d,CLOSED\r\n", closed[i]), now);
+#endif
+    }
+}
+
+bool ModemSim::_deliver(Clock::time_point now)
+{
+    uint64_t put = 0;
+    bool held = false;
+    while (!_down.empty() && (_down.front().at <= now)) {
+        std::string& data = _down.front().data;
+        // a full pipe holds the rest back like hardware flow control, a
+        // slow driver shows up in the timings instead of as lost bytes
+        int n = _rx ? _rx->put(data.data(), data.size(), false) : 0;
+        put += n;
+        _downBytes -= n;
+        if (n < (int)data.size()) {
+            data.erase(0, n);
+            held = true;
+            break;
+        }
+        _down.pop_front();
+    }
+    if (put || held) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.rxBytes += put;
+        _stats.rxHeld += held;
+    }
+    return !held;
+}
+
+void ModemSim::_emit(const std::string& text, Clock::time_point at)
+{
+    Clock::time_point t = std::max(at, _downAt);
+    for (size_t i = 0; i < text.size(); i += SIM_PIECE) {
+        Chunk chunk;
+        chunk.data = text.substr(i, SIM_PIECE);
+        t += _wire(chunk.data.size());
+        chunk.at = t;
+        _down.push_back(chunk);
+        _downBytes += chunk.data.size();
+    }
+    _downAt = t;
+}
+
+void ModemSim::_later(const std::string& text, Clock::time_point at)
+{
+    Chunk chunk = { at, text };
+    std::deque<Chunk>::iterator it = _timed.end();
+    while ((it != _timed.begin()) && ((it - 1)->at > at))
+        --it;
+    _timed.insert(it, chunk);
+}
+
+bool ModemSim::_open(int id, bool udp, const std::string& host, int port, int local)
+{
+    _close(id);
+    std::string ip = _resolve(host);
+    if (ip.empty())
+        return false;
+    int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    bool ok = true;
+    if (udp) {
+        if (local) {
+            addr.sin_port = htons(local);
+            ok = bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        }
+    } else {
+        struct timeval tv = { 5, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, ip.c_str(), &addr.sin_addr);
+        ok = connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    Sock sock = { fd, udp, ip, port };
+    _sockets[id] = sock;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _room[id] = SIM_SOCKET_ROOM;
+    return true;
+}
+
+void ModemSim::_close(int id)
+{
+    std::map<int, Sock>::iterator it = _sockets.find(id);
+    if (it != _sockets.end()) {
+        close(it->second.fd);
+        _sockets.erase(it);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _room.erase(id);
+}
+
+std::string ModemSim::_resolve(const std::string& host)
+{
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &res) || !res)
+        return std::string();
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &((struct sockaddr_in*)res->ai_addr)->sin_addr, ip, sizeof(ip));
+    freeaddrinfo(res);
+    return ip;
+}
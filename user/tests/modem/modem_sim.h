@@ -0,0 +1,164 @@
+/**
+ ******************************************************************************
+ * @file    modem_sim.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+
+#ifndef MODEM_SIM_H
+#define MODEM_SIM_H
+
+#include <stdint.h>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pipe_hal.h"
+
+/** Scripted AT modem for host runs of the modem driver
+
+    Speaks the ESP8266 (MDM_SIM_ESP8266) or SIM800 (MDM_SIM_SIM800) AT
+    dialect on a virtual UART paced at the configured baud rate. The socket
+    commands (CIPSTART, CIPSEND, CIPCLOSE, CIPDOMAIN / CDNSGIP) are bridged
+    to real TCP and UDP sockets, data coming back is pushed as +IPD or
+    +RECEIVE. Any other command is answered from the script, a line based
+    file of
+
+        # comment
+        baud <bps>                       // UART speed, overrides begin()
+        latency <ms>                     // delay of every answer
+        <command prefix> -> <answer>     // answer of a command, first match wins
+        <command prefix> +<ms> -> <urc>  // sent <ms> after the answer
+        @<ms> -> <urc>                   // sent <ms> after start
+
+    with \r \n \" \\ escapes in the answers. Commands without a rule are
+    answered with OK.
+*/
+class ModemSim
+{
+public:
+    //! counters of a run
+    struct Stats {
+        uint64_t commands;          //!< AT commands handled
+        uint64_t txBytes;           //!< bytes the driver wrote to the UART
+        uint64_t rxBytes;           //!< bytes delivered to the driver
+        uint64_t rxHeld;            //!< deliveries held back by a full receive pipe
+        uint64_t sockTx;            //!< payload bytes sent on real sockets
+        uint64_t sockRx;            //!< payload bytes received on real sockets
+    };
+
+    ModemSim(void);
+    ~ModemSim(void);
+
+    /** Load the script
+        \param file the script path
+        \return false if the file could not be read
+    */
+    bool load(const char* file);
+
+    /** Start the modem, called when the driver opens the UART
+        \param rx the receive pipe of the driver
+        \param baud the UART speed
+    */
+    void start(Pipe<char>* rx, unsigned baud);
+
+    //! Stop the modem and close its sockets
+    void stop(void);
+
+    /** Bytes written by the driver, blocks for their time on the wire
+        \param buf the bytes
+        \param len the number of bytes
+    */
+    void write(const void* buf, int len);
+
+    /** The application read data of a socket, +IPD / +RECEIVE payload is
+        only pushed while the socket pipe of the driver has room for it
+        \param id the socket
+        \param len the number of bytes read
+    */
+    void consumed(int id, int len);
+
+    //! Get the counters
+    Stats stats(void);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Rule {
+        std::string prefix;
+        int delay;                  //!< -1 for the answer, else ms after it
+        std::string text;
+    };
+    struct Chunk {
+        Clock::time_point at;       //!< time it is due
+        std::string data;
+    };
+    struct Sock {
+        int fd;
+        bool udp;
+        std::string host;           //!< remote address of a datagram socket
+        int port;
+    };
+
+    void _run(void);
+    void _input(const std::string& data, Clock::time_point now);
+    void _command(const std::string& cmd, Clock::time_point now);
+    void _data(Clock::time_point now);
+    bool _deliver(Clock::time_point now);
+    void _poll(Clock::time_point now);
+    void _emit(const std::string& text, Clock::time_point at);
+    void _later(const std::string& text, Clock::time_point at);
+    bool _builtin(const std::string& cmd, Clock::time_point at);
+    bool _open(int id, bool udp, const std::string& host, int port, int local);
+    void _close(int id);
+    std::string _resolve(const std::string& host);
+    Clock::duration _wire(size_t len) const;
+
+    std::vector<Rule> _rules;
+    std::vector<Rule> _urcs;        //!< sent after start
+    std::thread _thread;
+    std::mutex _mutex;              //!< guards _up, _room and _stats
+    std::deque<Chunk> _up;          //!< bytes written by the driver
+    std::deque<Chunk> _down;        //!< bytes on their way to the driver
+    int _downBytes;                 //!< bytes in _down
+    std::deque<Chunk> _timed;       //!< answers and urcs not yet due, by time
+    Clock::time_point _upAt;        //!< end of the last byte sent by the driver
+    Clock::time_point _downAt;      //!< end of the last byte queued for the driver
+    Pipe<char>* _rx;
+    unsigned _baud;                 //!< set by the script, else by start()
+    unsigned _latency;              //!< ms
+    int _wake[2];                   //!< self pipe waking the modem thread
+    volatile bool _running;
+    std::string _line;              //!< command being received
+    int _sendSocket;                //!< socket of a CIPSEND waiting for its data, -1 if none
+    int _sendLeft;                  //!< data bytes still expected
+    std::string _sendData;
+    std::string _sendHost;          //!< destination of a datagram, empty for the default
+    int _sendPort;
+    std::map<int, Sock> _sockets;
+    std::map<int, int> _room;       //!< free space of the socket pipes of the driver
+    Stats _stats;
+};
+
+extern ModemSim modemSim;
+
+#endif /* MODEM_SIM_H */
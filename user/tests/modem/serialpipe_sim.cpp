@@ -0,0 +1,112 @@
+/**
+ ******************************************************************************
+ * @file    serialpipe_sim.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+
+/* The serial pipe of the modem driver wired to the simulated modem
+   instead of the USART */
+
+#include "modem_sim.h"
+
+#ifdef MDM_SIM_SIM800
+#include "cellular_serialpipe_hal.h"
+#define SerialPipe CellularSerialPipe
+#else
+#include "esp8266serialpipe_hal.h"
+#define SerialPipe Esp8266SerialPipe
+#endif
+
+SerialPipe::SerialPipe(int rxSize, int txSize) :
+    _pipeRx(rxSize),
+    _pipeTx(txSize)
+{
+}
+
+SerialPipe::~SerialPipe(void)
+{
+}
+
+void SerialPipe::begin(unsigned int baud)
+{
+    modemSim.start(&_pipeRx, baud);
+}
+
+// tx channel
+int SerialPipe::writeable(void)
+{
+    return 1;
+}
+
+int SerialPipe::putc(int c)
+{
+    char ch = c;
+    modemSim.write(&ch, 1);
+    return c;
+}
+
+int SerialPipe::put(const void* buffer, int length, bool blocking)
+{
+    modemSim.write(buffer, length);
+    return length;
+}
+
+void SerialPipe::txStart(void)
+{
+}
+
+void SerialPipe::txCopy(void)
+{
+}
+
+void SerialPipe::txIrqBuf(void)
+{
+}
+
+// rx channel
+int SerialPipe::readable(void)
+{
+    return _pipeRx.readable();
+}
+
+int SerialPipe::getc(void)
+{
+    if (!_pipeRx.readable())
+        return EOF;
+    return _pipeRx.getc();
+}
+
+int SerialPipe::get(void* buffer, int length, bool blocking)
+{
+    return _pipeRx.get((char*)buffer, length, blocking);
+}
+
+void SerialPipe::rxIrqBuf(void)
+{
+}
+
+#ifdef MDM_SIM_SIM800
+void CellularSerialPipe::rxResume(void)
+{
+}
+
+void CellularSerialPipe::rxPause(void)
+{
+}
+#endif
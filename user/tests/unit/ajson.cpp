@@ -0,0 +1,311 @@
+/**
+ ******************************************************************************
+ * @file    ajson.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "wiring_ajson.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// aJsonStream::getch() times out on millis()
+extern "C" system_tick_t HAL_Timer_Get_Milli_Seconds(void) { return 0; }
+
+static const char* message =
+    "{\"board\":\"888002\",\"cmd\":\"upgradeBin\",\"dwn_token\":\"0123456789abcdef\","
+    "\"version\":\"1.2.3\",\"ts\":1500000000,\"ratio\":0.25,\"ok\":true,"
+    "\"list\":[1,2,{\"name\":\"a\"}],\"none\":null}";
+
+static void checkMessage(aJsonClass& aJson, aJsonObject* root) {
+    REQUIRE(root != NULL);
+    CHECK(!strcmp(aJson.getObjectItem(root, "cmd")->valuestring, "upgradeBin"));
+    CHECK(!strcmp(aJson.getObjectItem(root, "dwn_token")->valuestring, "0123456789abcdef"));
+    CHECK(aJson.getObjectItem(root, "ts")->valueint == 1500000000);
+    CHECK(aJson.getObjectItem(root, "ok")->valuebool);
+    aJsonObject* list = aJson.getObjectItem(root, "list");
+    REQUIRE(aJson.getArraySize(list) == 3);
+    CHECK(!strcmp(aJson.getObjectItem(aJson.getArrayItem(list, 2), "name")->valuestring, "a"));
+    CHECK(aJson.getObjectItem(root, "none")->type == aJson_NULL);
+}
+
+SCENARIO("A parse in an arena takes all items and strings from it", "[ajson]") {
+    alignas(8) uint8_t buffer[1024];
+    aJsonArena arena(buffer, sizeof(buffer));
+    aJsonClass aJson(&arena);
+    String text = message;
+
+    aJsonObject* root = aJson.parse((char*)text.c_str());
+    checkMessage(aJson, root);
+    CHECK(arena.contains(root));
+    CHECK(arena.contains(aJson.getObjectItem(root, "cmd")->valuestring));
+    CHECK(arena.used() > 0);
+    aJson.deleteItem(root);
+    arena.reset();
+    CHECK(arena.used() == 0);
+
+    root = aJson.parse((char*)text.c_str());
+    checkMessage(aJson, root);
+    CHECK((uint8_t*)root == buffer);
+}
+
+SCENARIO("A full arena falls back to the heap", "[ajson]") {
+    uint8_t buffer[100];
+    aJsonArena arena(buffer, sizeof(buffer));
+    aJsonClass aJson(&arena);
+    String text = message;
+
+    aJsonObject* root = aJson.parse((char*)text.c_str());
+    checkMessage(aJson, root);
+    CHECK(arena.contains(root));
+    CHECK_FALSE(arena.contains(aJson.getObjectItem(root, "none")));
+    // frees the heap part only
+    aJson.deleteItem(root);
+}
+
+SCENARIO("Strings longer than the decode buffer are cut", "[ajson]") {
+    alignas(8) uint8_t buffer[1024];
+    aJsonArena arena(buffer, sizeof(buffer));
+    aJsonClass heapJson, arenaJson(&arena);
+    String text = String("{\"long\":\"") + String(std::string(300, 'x').c_str()) + "\",\"short\":\"y\"}";
+
+    aJsonClass* parsers[] = { &heapJson, &arenaJson };
+    for (aJsonClass* aJson : parsers) {
+        aJsonObject* root = aJson->parse((char*)text.c_str());
+        REQUIRE(root != NULL);
+        CHECK(strlen(aJson->getObjectItem(root, "long")->valuestring) == 255);
+        CHECK(!strcmp(aJson->getObjectItem(root, "short")->valuestring, "y"));
+        aJson->deleteItem(root);
+    }
+}
+
+SCENARIO("Items built in an arena are released by reset", "[ajson]") {
+    alignas(8) uint8_t buffer[512];
+    aJsonArena arena(buffer, sizeof(buffer));
+    aJsonClass aJson(&arena);
+
+    aJsonObject* root = aJson.createObject();
+    aJson.addStringToObject(root, "productId", "abc");
+    aJson.addNumberToObject(root, "ts", 12);
+    char* text = aJson.print(root);
+    CHECK(!strcmp(text, "{\"productId\":\"abc\",\"ts\":12}"));
+    free(text);
+    CHECK(arena.contains(aJson.getObjectItem(root, "productId")->name));
+    CHECK(((uintptr_t)aJson.getObjectItem(root, "ts") % sizeof(double)) == 0);
+    arena.reset();
+}
+
+SCENARIO("Extract fills a table of fields in one pass", "[ajson]") {
+    char cmd[16], name[4], big[8];
+    int ts = 0, second = 0;
+    uint32_t version = 0;
+    double ratio = 0;
+    bool ok = false;
+    aJsonExtract table[] = {
+        { "cmd", aJson_String, cmd, sizeof(cmd) },
+        { "ts", aJson_Int, &ts },
+        { "ratio", aJson_Float, &ratio },
+        { "ok", aJson_Boolean, &ok },
+        { "list[1]", aJson_Int, &second },
+        { "list[2].name", aJson_String, name, sizeof(name) },
+        { "dwn_token", aJson_String, big, sizeof(big) },
+        { "version", aJson_Uint, &version },
+        { "missing.field", aJson_Int, &ts },
+    };
+    String text = message;
+
+    CHECK(jsonGetValues((uint8_t*)text.c_str(), table, 9) == 7);
+    CHECK(!strcmp(cmd, "upgradeBin"));
+    CHECK(ts == 1500000000);
+    CHECK(ratio == 0.25);
+    CHECK(ok);
+    CHECK(second == 2);
+    CHECK(!strcmp(name, "a"));
+    CHECK(!strcmp(big, "0123456"));
+    CHECK_FALSE(table[7].found);
+    CHECK_FALSE(table[8].found);
+}
+
+SCENARIO("Extract rejects malformed text", "[ajson]") {
+    int ts = 0;
+    aJsonExtract table[] = { { "a.b", aJson_Int, &ts } };
+    char text[] = "{\"a\":{\"b\":1,}";
+    CHECK(jsonGetValues((uint8_t*)text, table, 1) == EOF);
+}
+
+SCENARIO("Benchmark extract versus jsonGetValue", "[.][benchmark][ajson]") {
+    const int rounds = 20000;
+    using clock = std::chrono::steady_clock;
+    String cmd, token, version;
+    int ts = 0;
+    double ratio = 0;
+    String text = message;
+    uint8_t* payload = (uint8_t*)text.c_str();
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        jsonGetValue(payload, "cmd", cmd);
+        jsonGetValue(payload, "dwn_token", token);
+        jsonGetValue(payload, "version", version);
+        jsonGetValue(payload, "ts", ts);
+        jsonGetValue(payload, "ratio", ratio);
+    }
+    double repeated = std::chrono::duration<double>(clock::now() - start).count();
+
+    char cmdBuffer[16], tokenBuffer[24], versionBuffer[16];
+    aJsonExtract table[] = {
+        { "cmd", aJson_String, cmdBuffer, sizeof(cmdBuffer) },
+        { "dwn_token", aJson_String, tokenBuffer, sizeof(tokenBuffer) },
+        { "version", aJson_String, versionBuffer, sizeof(versionBuffer) },
+        { "ts", aJson_Int, &ts },
+        { "ratio", aJson_Float, &ratio },
+    };
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        jsonGetValues(payload, table, 5);
+    }
+    double once = std::chrono::duration<double>(clock::now() - start).count();
+
+    WARN("jsonGetValue x5: " << rounds / repeated << " messages/s, jsonGetValues: " << rounds / once << " messages/s");
+    CHECK(once < repeated);
+}
+
+SCENARIO("Writer produces the same text as building and printing a tree", "[ajson]") {
+    char text[256];
+    aJsonWriter json(text, sizeof(text));
+    json.beginObject()
+        .add("status", 200)
+        .add("board", "888002")
+        .add("online", true)
+        .add("ratio", 0.25)
+        .beginArray("list").add(NULL, 1).add(NULL, -2).beginObject(NULL).addNull("n").endObject().endArray()
+        .beginObject("value").add("at_mode", 3U).add("big", 4000000000UL).endObject()
+        .endObject();
+
+    aJsonClass aJson;
+    aJsonObject* root = aJson.createObject();
+    aJson.addNumberToObject(root, "status", 200);
+    aJson.addStringToObject(root, "board", "888002");
+    aJson.addBooleanToObject(root, "online", true);
+    aJson.addNumberToObject(root, "ratio", 0.25);
+    aJsonObject* list = aJson.createArray();
+    aJson.addItemToArray(list, aJson.createItem(1));
+    aJson.addItemToArray(list, aJson.createItem(-2));
+    aJsonObject* inner = aJson.createObject();
+    aJson.addNullToObject(inner, "n");
+    aJson.addItemToArray(list, inner);
+    aJson.addItemToObject(root, "list", list);
+    aJsonObject* value = aJson.createObject();
+    aJson.addNumberToObject(value, "at_mode", 3);
+    aJson.addNumberToObject(value, "big", (uint32_t)4000000000UL);
+    aJson.addItemToObject(root, "value", value);
+    char* printed = aJson.print(root);
+
+    CHECK(std::string(text) == printed);
+    CHECK(json.length() == strlen(printed));
+    free(printed);
+    aJson.deleteItem(root);
+}
+
+SCENARIO("Writer escapes strings", "[ajson]") {
+    char text[64];
+    aJsonWriter json(text, sizeof(text));
+    json.beginObject().add("s", "a\"b\\c\n\x01" "d").endObject();
+    CHECK(std::string(text) == "{\"s\":\"a\\\"b\\\\c\\n\\u0001d\"}");
+}
+
+SCENARIO("Writer reports the length a cut text needs", "[ajson]") {
+    aJsonWriter measure(NULL, 0);
+    measure.beginObject().add("status", 200).add("ssid", "some network").endObject();
+    const size_t needed = measure.length();
+    CHECK(needed == strlen("{\"status\":200,\"ssid\":\"some network\"}"));
+
+    char small[10];
+    aJsonWriter json(small, sizeof(small));
+    json.beginObject().add("status", 200).add("ssid", "some network").endObject();
+    CHECK(json.overflow());
+    CHECK(json.length() == needed);
+    CHECK(std::string(small) == "{\"status\"");
+
+    std::vector<char> exact(needed + 1);
+    aJsonWriter fits(exact.data(), exact.size());
+    fits.beginObject().add("status", 200).add("ssid", "some network").endObject();
+    CHECK_FALSE(fits.overflow());
+}
+
+SCENARIO("Benchmark writer versus building and printing a tree", "[.][benchmark][ajson]") {
+    const int rounds = 100000;
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        aJsonClass aJson;
+        aJsonObject* root = aJson.createObject();
+        aJson.addStringToObject(root, "board", "888002");
+        aJson.addStringToObject(root, "productId", "0123456789abcdef");
+        aJson.addStringToObject(root, "mode", "master");
+        aJson.addStringToObject(root, "swVer", "1.0.0");
+        aJson.addStringToObject(root, "hwVer", "1.0.0");
+        aJson.addStringToObject(root, "libVer", "3.0.1");
+        aJson.addBooleanToObject(root, "online", true);
+        free(aJson.print(root));
+        aJson.deleteItem(root);
+    }
+    double tree = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        char text[256];
+        aJsonWriter json(text, sizeof(text));
+        json.beginObject().add("board", "888002").add("productId", "0123456789abcdef").add("mode", "master")
+            .add("swVer", "1.0.0").add("hwVer", "1.0.0").add("libVer", "3.0.1").add("online", true).endObject();
+    }
+    double writer = std::chrono::duration<double>(clock::now() - start).count();
+
+    WARN("tree + print: " << rounds / tree << " messages/s, writer: " << rounds / writer << " messages/s");
+    CHECK(writer < tree);
+}
+
+SCENARIO("Benchmark arena versus heap parsing", "[.][benchmark][ajson]") {
+    alignas(8) static uint8_t buffer[2048];
+    aJsonArena arena(buffer, sizeof(buffer));
+    const int rounds = 100000;
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        aJsonClass aJson;
+        String text = message;
+        aJson.deleteItem(aJson.parse((char*)text.c_str()));
+    }
+    double heap = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        aJsonClass aJson(&arena);
+        String text = message;
+        aJson.deleteItem(aJson.parse((char*)text.c_str()));
+        arena.reset();
+    }
+    double inArena = std::chrono::duration<double>(clock::now() - start).count();
+
+    WARN("heap: " << rounds / heap << " parses/s, arena: " << rounds / inArena << " parses/s");
+    CHECK(inArena < heap);
+}
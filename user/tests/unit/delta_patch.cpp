@@ -0,0 +1,165 @@
+/**
+ ******************************************************************************
+ * @file    delta_patch.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "delta_patch.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static int readBase(void *context, uint32_t offset, uint8_t *buffer, uint32_t length) {
+    const Bytes& base = *static_cast<const Bytes*>(context);
+    if (offset + length > base.size()) {
+        return -1;
+    }
+    memcpy(buffer, &base[offset], length);
+    return 0;
+}
+
+static void putU32(Bytes& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(value >> (8 * i));
+    }
+}
+
+static void copy(Bytes& patch, uint32_t offset, uint32_t length) {
+    patch.push_back(DELTA_OP_COPY);
+    putU32(patch, offset);
+    putU32(patch, length);
+}
+
+static void add(Bytes& patch, uint32_t offset, const Bytes& diff) {
+    patch.push_back(DELTA_OP_ADD);
+    putU32(patch, offset);
+    putU32(patch, diff.size());
+    patch.insert(patch.end(), diff.begin(), diff.end());
+}
+
+static void insert(Bytes& patch, const Bytes& data) {
+    patch.push_back(DELTA_OP_INSERT);
+    putU32(patch, data.size());
+    patch.insert(patch.end(), data.begin(), data.end());
+}
+
+// applies feeding at most inStep bytes and taking at most outStep bytes per call
+static Bytes apply(const Bytes& base, const Bytes& patch, size_t size, size_t inStep, size_t outStep, bool* error = NULL) {
+    DELTA_PATCH applier;
+    deltaInitialPatch(&applier, readBase, const_cast<Bytes*>(&base), base.size());
+    Bytes out(size);
+    size_t inPos = 0, outPos = 0;
+    while (outPos < size && !applier.error) {
+        uint32_t used = 0;
+        uint32_t inLen = std::min(inStep, patch.size() - inPos);
+        uint32_t produced = deltaApply(&applier, patch.data() + inPos, inLen, &used,
+                                       &out[outPos], std::min(outStep, size - outPos));
+        inPos += used;
+        outPos += produced;
+        if (!produced && !used && inPos == patch.size()) {
+            break;
+        }
+    }
+    if (error) {
+        *error = applier.error;
+    }
+    out.resize(outPos);
+    return out;
+}
+
+static Bytes randomBytes(size_t size) {
+    Bytes data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = rand();
+    }
+    return data;
+}
+
+SCENARIO("Patch builds the new image from the base and new data", "[delta]") {
+    srand(2);
+    Bytes base = randomBytes(5000);
+    Bytes extra = randomBytes(300);
+    Bytes diff(1000);
+    for (size_t i = 0; i < diff.size(); i += 6) {
+        diff[i] = 0x10;
+    }
+
+    Bytes expected(base.begin() + 1000, base.begin() + 3000);
+    expected.insert(expected.end(), extra.begin(), extra.end());
+    for (size_t i = 0; i < diff.size(); i++) {
+        expected.push_back(base[3500 + i] + diff[i]);
+    }
+    expected.insert(expected.end(), base.begin(), base.begin() + 700);
+
+    Bytes patch;
+    copy(patch, 1000, 2000);
+    insert(patch, extra);
+    add(patch, 3500, diff);
+    copy(patch, 0, 700);
+
+    CHECK(apply(base, patch, expected.size(), patch.size(), expected.size()) == expected);
+
+    WHEN("input and output are split anywhere") {
+        CHECK(apply(base, patch, expected.size(), 1, 1) == expected);
+        CHECK(apply(base, patch, expected.size(), 3, 4096) == expected);
+        CHECK(apply(base, patch, expected.size(), 256, 7) == expected);
+    }
+}
+
+SCENARIO("Patch stops when the stream runs out", "[delta]") {
+    Bytes base = randomBytes(1000);
+    Bytes extra = randomBytes(500);
+    Bytes patch;
+    insert(patch, extra);
+    patch.resize(200);
+
+    bool error = true;
+    Bytes out = apply(base, patch, extra.size(), 64, 64, &error);
+    CHECK_FALSE(error);
+    CHECK(out.size() == 200 - 5);
+    CHECK(std::equal(out.begin(), out.end(), extra.begin()));
+}
+
+SCENARIO("Patch rejects operations it cannot apply", "[delta]") {
+    Bytes base = randomBytes(1000);
+    bool error = false;
+
+    GIVEN("an operation reaching past the base") {
+        Bytes patch;
+        copy(patch, 900, 101);
+        CHECK(apply(base, patch, 101, 16, 16, &error).empty());
+        CHECK(error);
+    }
+    GIVEN("an offset past the base") {
+        Bytes patch;
+        add(patch, 0xfffffff0, Bytes(0x20));
+        CHECK(apply(base, patch, 0x20, 16, 16, &error).empty());
+        CHECK(error);
+    }
+    GIVEN("an unknown operation") {
+        Bytes patch;
+        insert(patch, Bytes(10, 1));
+        patch.push_back(0x7f);
+        CHECK(apply(base, patch, 20, 16, 16, &error).size() == 10);
+        CHECK(error);
+    }
+}
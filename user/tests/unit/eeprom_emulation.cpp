@@ -4,6 +4,8 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <functional>
 #include "eeprom_emulation.h"
 #include "flash_storage.h"
 
@@ -592,6 +594,42 @@ TEST_CASE("Initialize EEPROM", "[eeprom]")
     }
 }
 
+TEST_CASE("Pages written by the old emulation", "[eeprom]")
+{
+    TestEEPROM eeprom;
+
+    // The old code stored 16 bit variables as (data, virtual address)
+    // halfword pairs after a VALID_PAGE (0x0000) halfword
+    uint16_t page[] = { 0x0000, 0xFFFF, 0x00AA, 10, 0x00BB, 3584, 0x00CC, 10 };
+    eeprom.store.eraseSector(PageBase1);
+    eeprom.store.eraseSector(PageBase2);
+    eeprom.store.write(PageBase1, page, sizeof(page));
+
+    eeprom.init();
+
+    THEN("the page is active and the variables read back")
+    {
+        uint8_t value;
+        REQUIRE(eeprom.getActivePage() == Page1);
+        eeprom.get(10, value);
+        REQUIRE(value == 0xCC);
+        eeprom.get(3584, value);
+        REQUIRE(value == 0xBB);
+    }
+
+    WHEN("the page is swapped")
+    {
+        eeprom.swapPagesAndWrite(0, nullptr, 0);
+
+        THEN("variables beyond the capacity are kept")
+        {
+            uint8_t value;
+            eeprom.get(3584, value);
+            REQUIRE(value == 0xBB);
+        }
+    }
+}
+
 TEST_CASE("Clear", "[eeprom]")
 {
     TestEEPROM eeprom;
@@ -1313,6 +1351,59 @@ TEST_CASE("Write ignored for any address out of range", "[eeprom]")
     }
 }
 
+const size_t TestLegacyCapacity = 1024;
+using LegacyEEPROM = EEPROMEmulation<TestStore, PageBase1, PageSize1, PageBase2, PageSize2, 0, TestLegacyCapacity>;
+
+TEST_CASE("Indexes used by an older emulation with more capacity", "[eeprom]")
+{
+    LegacyEEPROM eeprom;
+    eeprom.init();
+    const uint16_t index = TestLegacyCapacity - 16;
+    const uint8_t data[4] = { 1, 2, 3, 4 };
+    uint8_t dataRead[4];
+
+    eeprom.put(index, data, sizeof(data));
+
+    THEN("they are written")
+    {
+        eeprom.get(index, dataRead, sizeof(dataRead));
+        REQUIRE(memcmp(dataRead, data, sizeof(data)) == 0);
+        REQUIRE(eeprom.capacity() < index);
+    }
+
+    THEN("they are kept by a page swap")
+    {
+        eeprom.swapPagesAndWrite(0, nullptr, 0);
+        eeprom.get(index, dataRead, sizeof(dataRead));
+        REQUIRE(memcmp(dataRead, data, sizeof(data)) == 0);
+    }
+
+    WHEN("they are written back as 0xFF")
+    {
+        const uint8_t erased[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+        eeprom.put(index, erased, sizeof(erased));
+        eeprom.swapPagesAndWrite(0, nullptr, 0);
+
+        THEN("the page swap leaves their records behind")
+        {
+            int records = 0;
+            eeprom.forEachValidRecord(eeprom.getActivePage(), [&](uintptr_t address, const LegacyEEPROM::Record &record)
+            {
+                records++;
+            });
+            REQUIRE(records == 0);
+        }
+    }
+
+    THEN("indexes past the legacy capacity are not written")
+    {
+        eeprom.put(TestLegacyCapacity, 0xAA);
+        uint8_t value;
+        eeprom.get(TestLegacyCapacity, value);
+        REQUIRE(value == 0xFF);
+    }
+}
+
 TEST_CASE("Page swap with data in multiple batches", "[eeprom]")
 {
     TestEEPROM eeprom;
@@ -1338,3 +1429,127 @@ TEST_CASE("Page swap with data in multiple batches", "[eeprom]")
         REQUIRE(dataRead == data);
     }
 }
+
+const size_t TestCacheSize = 256;
+using CachedEEPROM = EEPROMEmulation<TestStore, PageBase1, PageSize1, PageBase2, PageSize2, TestCacheSize>;
+
+TEST_CASE("Index cache", "[eeprom]")
+{
+    CachedEEPROM eeprom;
+
+    SECTION("The cache is rebuilt from existing records at init")
+    {
+        TestEEPROM uncached;
+        EEPROMTester tester(uncached);
+        tester.populate(PageBase1, PAGE_ACTIVE, {
+            Record(1, 0xAA), Record(300, 0xBB), Record(1, 0xCC)
+        });
+        tester.populate(PageBase2, PAGE_ERASED);
+        eeprom.store = uncached.store;
+
+        eeprom.init();
+
+        uint8_t value;
+        eeprom.get(1, value);
+        REQUIRE(value == 0xCC);
+        eeprom.get(300, value);
+        REQUIRE(value == 0xBB);
+
+        THEN("writes append after the existing records")
+        {
+            eeprom.put(2, 0x11);
+
+            Record record;
+            eeprom.store.read(PageBase1 + sizeof(uint32_t) + 3 * sizeof(Record), &record, sizeof(record));
+            REQUIRE(record.index == 2);
+            REQUIRE(record.data == 0x11);
+        }
+    }
+
+    SECTION("Reads and writes match the uncached emulation")
+    {
+        TestEEPROM uncached;
+        eeprom.init();
+        uncached.init();
+
+        // Ranges inside the cache, straddling its end and past it, with
+        // enough writes for many page swaps
+        srand(5);
+        for(int i = 0; i < 20000; i++)
+        {
+            uint8_t data[16];
+            uint16_t length = 1 + rand() % sizeof(data);
+            uint16_t index = rand() % (eeprom.capacity() - length);
+            for(uint16_t j = 0; j < length; j++)
+            {
+                data[j] = rand() % 4;
+            }
+            eeprom.put(index, data, length);
+            uncached.put(index, data, length);
+
+            uint8_t expected[sizeof(data)], actual[sizeof(data)];
+            index = rand() % (eeprom.capacity() - length);
+            uncached.get(index, expected, length);
+            eeprom.get(index, actual, length);
+            CAPTURE(i);
+            CAPTURE(index);
+            REQUIRE(std::memcmp(expected, actual, length) == 0);
+        }
+
+        REQUIRE(eeprom.store.getEraseCount() == uncached.store.getEraseCount());
+
+        for(uint16_t index = 0; index < eeprom.capacity(); index++)
+        {
+            uint8_t expected, actual;
+            uncached.get(index, expected);
+            eeprom.get(index, actual);
+            CAPTURE(index);
+            REQUIRE(expected == actual);
+        }
+    }
+
+    SECTION("Values survive a page swap")
+    {
+        eeprom.init();
+        eeprom.put(10, 0x55);
+        eeprom.swapPagesAndWrite(11, nullptr, 0);
+
+        uint8_t value;
+        eeprom.get(10, value);
+        REQUIRE(value == 0x55);
+    }
+}
+
+TEST_CASE("Benchmark EEPROM reads", "[.][benchmark][eeprom]")
+{
+    TestEEPROM uncached;
+    CachedEEPROM cached;
+    uncached.init();
+    cached.init();
+
+    // Fill about half of the page with records
+    for(int i = 0; i < 500; i++)
+    {
+        uncached.put(i % TestCacheSize, i);
+        cached.put(i % TestCacheSize, i);
+    }
+
+    const int rounds = 20000;
+    auto timeReads = [&](std::function<void(uint16_t, uint8_t &)> get)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint8_t value, sum = 0;
+        for(int i = 0; i < rounds; i++)
+        {
+            get(i % TestCacheSize, value);
+            sum += value;
+        }
+        REQUIRE(sum != 1);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double uncachedTime = timeReads([&](uint16_t index, uint8_t &value) { uncached.get(index, value); });
+    double cachedTime = timeReads([&](uint16_t index, uint8_t &value) { cached.get(index, value); });
+
+    WARN("byte reads, uncached: " << rounds / uncachedTime << "/s, cached: " << rounds / cachedTime << "/s");
+}
@@ -0,0 +1,305 @@
+// Off device tests for the ring variant of the EEPROM emulation
+
+#include "catch.hpp"
+#include <vector>
+#include <algorithm>
+#include "eeprom_emulation.h"
+#include "eeprom_ring_emulation.h"
+#include "flash_storage.h"
+
+const size_t RingPageSize = 0x400;
+const uint8_t RingPageCount = 8;
+const uintptr_t RingBase = 0xC000;
+
+using RingStore = RAMFlashStorage<RingBase, RingPageCount, RingPageSize>;
+using RingEEPROM = EEPROMRingEmulation<RingStore, RingBase, RingPageSize, RingPageCount>;
+
+/* A small ring that compacts every few writes */
+using SmallRingStore = RAMFlashStorage<RingBase, 4, RingPageSize / 4>;
+using SmallRingEEPROM = EEPROMRingEmulation<SmallRingStore, RingBase, RingPageSize / 4, 4>;
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes readAll(RingEEPROM &eeprom)
+{
+    Bytes data(eeprom.capacity());
+    eeprom.get(0, data.data(), data.size());
+    return data;
+}
+
+// Puts random blocks in the first `span` bytes, keeping model up to date
+static void putRandom(RingEEPROM &eeprom, Bytes &model, int count, size_t span)
+{
+    for(int i = 0; i < count; i++)
+    {
+        uint16_t length = 1 + rand() % 8;
+        uint16_t index = rand() % (span - length);
+        Bytes data(length);
+        for(auto &value: data)
+        {
+            value = rand();
+        }
+        eeprom.put(index, data.data(), length);
+        std::copy(data.begin(), data.end(), model.begin() + index);
+    }
+}
+
+TEST_CASE("Ring get and put", "[eeprom_ring]")
+{
+    RingEEPROM eeprom;
+    eeprom.init();
+
+    REQUIRE(eeprom.capacity() == (RingPageSize - 8) / 4);
+
+    uint8_t value;
+    eeprom.get(10, value);
+    REQUIRE(value == 0xFF);
+
+    eeprom.put(10, 0xCC);
+    eeprom.get(10, value);
+    REQUIRE(value == 0xCC);
+
+    uint8_t values[] = { 1, 2, 3 };
+    eeprom.put(20, values, sizeof(values));
+
+    uint8_t readValues[3];
+    eeprom.get(20, readValues, sizeof(readValues));
+    REQUIRE(std::equal(values, values + 3, readValues));
+
+    SECTION("The address is out of range")
+    {
+        eeprom.put(eeprom.capacity() - 1, values, sizeof(values));
+        eeprom.get(eeprom.capacity() - 1, value);
+        REQUIRE(value == 0xFF);
+    }
+
+    SECTION("After a reset")
+    {
+        eeprom.init();
+        eeprom.get(10, value);
+        REQUIRE(value == 0xCC);
+        eeprom.get(22, value);
+        REQUIRE(value == 3);
+    }
+
+    SECTION("After clear")
+    {
+        eeprom.clear();
+        eeprom.get(10, value);
+        REQUIRE(value == 0xFF);
+    }
+}
+
+TEST_CASE("Ring wraps around", "[eeprom_ring]")
+{
+    srand(7);
+    RingEEPROM eeprom;
+    eeprom.init();
+    Bytes model(eeprom.capacity(), 0xFF);
+
+    // Enough writes to go around the ring many times
+    putRandom(eeprom, model, 4000, model.size());
+    REQUIRE(readAll(eeprom) == model);
+
+    eeprom.init();
+    REQUIRE(readAll(eeprom) == model);
+
+    THEN("pages are erased evenly")
+    {
+        unsigned least = eeprom.store.getEraseCount(RingBase), most = least;
+        for(unsigned page = 1; page < RingPageCount; page++)
+        {
+            unsigned count = eeprom.store.getEraseCount(RingBase + page * RingPageSize);
+            least = std::min(least, count);
+            most = std::max(most, count);
+        }
+        REQUIRE(least > 0);
+        REQUIRE(most <= least + 2);
+    }
+}
+
+TEST_CASE("Ring erases old pages in the background", "[eeprom_ring]")
+{
+    srand(8);
+    RingEEPROM eeprom;
+    eeprom.init();
+    Bytes model(eeprom.capacity(), 0xFF);
+
+    while(!eeprom.hasPendingErase())
+    {
+        putRandom(eeprom, model, 1, model.size());
+    }
+
+    while(eeprom.hasPendingErase())
+    {
+        eeprom.performPendingErase();
+    }
+
+    THEN("writes don't erase until the erased pages run out")
+    {
+        eeprom.store.resetEraseCount();
+        for(int i = 0; i < 100; i++)
+        {
+            putRandom(eeprom, model, 1, model.size());
+        }
+        REQUIRE(eeprom.store.getEraseCount() == 0);
+        REQUIRE(readAll(eeprom) == model);
+    }
+}
+
+TEST_CASE("Ring writes survive resets", "[eeprom_ring]")
+{
+    srand(9);
+    RingEEPROM eeprom;
+    eeprom.init();
+    Bytes model(eeprom.capacity(), 0xFF);
+
+    // Interrupt block writes anywhere, including in the compactions and
+    // page erases they trigger
+    for(int round = 0; round < 1000; round++)
+    {
+        putRandom(eeprom, model, 5, model.size());
+
+        Bytes block(16);
+        for(auto &value: block)
+        {
+            value = rand();
+        }
+        uint16_t index = rand() % (model.size() - block.size());
+        eeprom.store.discardWritesAfter(rand() % 1200, [&] {
+            eeprom.put(index, block.data(), block.size());
+        });
+
+        Bytes updated = model;
+        std::copy(block.begin(), block.end(), updated.begin() + index);
+
+        eeprom.init();
+        Bytes data = readAll(eeprom);
+        INFO("round " << round);
+        REQUIRE((data == model || data == updated));
+        model = data;
+    }
+
+    THEN("it keeps working once writes go through")
+    {
+        putRandom(eeprom, model, 500, model.size());
+        REQUIRE(readAll(eeprom) == model);
+        eeprom.init();
+        REQUIRE(readAll(eeprom) == model);
+    }
+}
+
+TEST_CASE("Ring resumes an interrupted compaction", "[eeprom_ring]")
+{
+    srand(10);
+    SmallRingEEPROM eeprom;
+    eeprom.init();
+    Bytes model(eeprom.capacity(), 0x55);
+
+    // Fill the whole capacity so compactions copy a full page of records
+    eeprom.put(0, model.data(), model.size());
+
+    for(int round = 0; round < 1000; round++)
+    {
+        uint8_t value = rand() % 0xFF;
+        uint16_t index = rand() % model.size();
+        eeprom.store.discardWritesAfter(rand() % 600, [&] {
+            for(int i = 0; i < 100; i++)
+            {
+                eeprom.put(index, value);
+                eeprom.put(index, value ^ 1);
+            }
+        });
+
+        eeprom.init();
+        Bytes data(model.size());
+        eeprom.get(0, data.data(), data.size());
+        INFO("round " << round);
+        for(size_t i = 0; i < model.size(); i++)
+        {
+            if(i != index)
+            {
+                REQUIRE(data[i] == model[i]);
+            }
+        }
+        model = data;
+    }
+
+    THEN("it keeps working once writes go through")
+    {
+        for(int i = 0; i < 500; i++)
+        {
+            uint16_t index = rand() % model.size();
+            model[index] = rand();
+            eeprom.put(index, model[index]);
+        }
+        eeprom.init();
+        Bytes data(model.size());
+        eeprom.get(0, data.data(), data.size());
+        REQUIRE(data == model);
+    }
+}
+
+// Host simulation of both emulations on the same 32KB of flash, split in
+// 2 sectors of 16KB or 8 pages of 4KB
+TEST_CASE("Simulate EEPROM wear", "[.][benchmark][eeprom_ring]")
+{
+    const size_t SimFlash = 0x8000;
+    const uintptr_t SimBase = 0x20000;
+    using TwoPageStore = RAMFlashStorage<SimBase, 2, SimFlash / 2>;
+    using TwoPageEEPROM = EEPROMEmulation<TwoPageStore, SimBase, SimFlash / 2, SimBase + SimFlash / 2, SimFlash / 2>;
+    using SimRingStore = RAMFlashStorage<SimBase, 8, SimFlash / 8>;
+    using SimRingEEPROM = EEPROMRingEmulation<SimRingStore, SimBase, SimFlash / 8, 8>;
+
+    std::unique_ptr<TwoPageEEPROM> twoPage(new TwoPageEEPROM);
+    std::unique_ptr<SimRingEEPROM> ring(new SimRingEEPROM);
+    twoPage->init();
+    ring->init();
+
+    // Same workload on both: blocks of 1 to 16 bytes in the first 512 bytes
+    const int puts = 50000;
+    const size_t span = 512;
+    unsigned long changed = 0;
+    Bytes model(span, 0xFF);
+    srand(11);
+    for(int i = 0; i < puts; i++)
+    {
+        uint16_t length = 1 + rand() % 16;
+        uint16_t index = rand() % (span - length);
+        Bytes data(length);
+        for(size_t j = 0; j < length; j++)
+        {
+            data[j] = rand();
+            changed += data[j] != model[index + j];
+            model[index + j] = data[j];
+        }
+        twoPage->put(index, data.data(), length);
+        ring->put(index, data.data(), length);
+    }
+
+    Bytes twoPageData(span), ringData(span);
+    twoPage->get(0, twoPageData.data(), span);
+    ring->get(0, ringData.data(), span);
+    REQUIRE(twoPageData == model);
+    REQUIRE(ringData == model);
+
+    auto report = [&](const char *name, unsigned long written, unsigned erases,
+                      unsigned most, size_t eraseSize)
+    {
+        WARN(name << ": write amplification " << double(written) / changed
+             << ", " << erases << " erases of " << eraseSize / 1024 << "KB ("
+             << erases * eraseSize / 1024 << "KB in total), at most " << most << " per sector");
+    };
+
+    unsigned twoPageMost = std::max(twoPage->store.getEraseCount(SimBase),
+                                    twoPage->store.getEraseCount(SimBase + SimFlash / 2));
+    unsigned ringMost = 0;
+    for(unsigned page = 0; page < 8; page++)
+    {
+        ringMost = std::max(ringMost, ring->store.getEraseCount(SimBase + page * SimFlash / 8));
+    }
+
+    WARN(puts << " puts, " << changed << " bytes changed");
+    report("two pages", twoPage->store.getWriteCount(), twoPage->store.getEraseCount(), twoPageMost, SimFlash / 2);
+    report("ring", ring->store.getWriteCount(), ring->store.getEraseCount(), ringMost, SimFlash / 8);
+}
@@ -0,0 +1,154 @@
+/**
+ ******************************************************************************
+ * @file    flash_storage.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/* Host stand-in for the flash stores, with the interface of InternalFlashStore. */
+
+#ifndef FLASH_STORAGE_H
+#define FLASH_STORAGE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+/**
+ * Sectors of flash in RAM. Like real flash, erased bytes read 0xFF and
+ * writes can only clear bits, so a write over programmed bytes fails
+ * verification.
+ */
+template <uintptr_t Base, unsigned SectorCount, unsigned SectorSize>
+class RAMFlashStorage
+{
+public:
+    RAMFlashStorage()
+    {
+        // flash starts out in an unknown state
+        for (unsigned i = 0; i < sizeof(memory); i++)
+        {
+            memory[i] = rand();
+        }
+    }
+
+    int erase(unsigned address, unsigned size)
+    {
+        for (unsigned sector = address; sector < address + size; sector += SectorSize)
+        {
+            if (eraseSector(sector))
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int eraseSector(unsigned address)
+    {
+        if (address < Base || address >= Base + sizeof(memory))
+        {
+            return -1;
+        }
+        if (discarding())
+        {
+            return 0;
+        }
+        unsigned sector = (address - Base) / SectorSize;
+        std::memset(memory + sector * SectorSize, 0xFF, SectorSize);
+        eraseCount++;
+        sectorEraseCount[sector]++;
+        return 0;
+    }
+
+    int write(const unsigned offset, const void* data, const unsigned size)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint8_t* destination = memory + offset - Base;
+        for (unsigned i = 0; i < size; i++)
+        {
+            if (discarding())
+            {
+                // simulate a reset in the middle of the write
+                return 0;
+            }
+            destination[i] &= bytes[i];
+            writeCount++;
+            totalWriteCount++;
+        }
+        return std::memcmp(destination, data, size) ? -1 : 0;
+    }
+
+    const uint8_t* dataAt(unsigned address)
+    {
+        return memory + address - Base;
+    }
+
+    int read(unsigned offset, void* data, unsigned size)
+    {
+        std::memcpy(data, dataAt(offset), size);
+        return 0;
+    }
+
+    // Runs f with only the first count bytes written reaching the flash,
+    // erases are dropped too once the count is reached
+    void discardWritesAfter(int count, std::function<void()> f)
+    {
+        writeCount = 0;
+        writeLimit = count;
+        f();
+        writeLimit = -1;
+    }
+
+    unsigned getEraseCount() const
+    {
+        return eraseCount;
+    }
+
+    void resetEraseCount()
+    {
+        eraseCount = 0;
+    }
+
+    // Erases of the sector containing address
+    unsigned getEraseCount(unsigned address) const
+    {
+        return sectorEraseCount[(address - Base) / SectorSize];
+    }
+
+    // Bytes programmed since construction
+    unsigned long getWriteCount() const
+    {
+        return totalWriteCount;
+    }
+
+private:
+    bool discarding() const
+    {
+        return writeLimit >= 0 && writeCount >= unsigned(writeLimit);
+    }
+
+    uint8_t memory[SectorCount * SectorSize];
+    unsigned eraseCount = 0;
+    unsigned sectorEraseCount[SectorCount] = {};
+    unsigned writeCount = 0;
+    unsigned long totalWriteCount = 0;
+    int writeLimit = -1;
+};
+
+#endif /* FLASH_STORAGE_H */
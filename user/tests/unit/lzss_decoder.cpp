@@ -0,0 +1,132 @@
+/**
+ ******************************************************************************
+ * @file    lzss_decoder.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "lzss_decoder.h"
+#include "lzss_encoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// decodes feeding at most inStep bytes and taking at most outStep bytes per call
+static Bytes decode(const Bytes& in, size_t size, int windowBits, int lookaheadBits, size_t inStep, size_t outStep) {
+    LZSS_DECODER decoder;
+    REQUIRE(lzssInitialDecoder(&decoder, windowBits, lookaheadBits));
+    Bytes out(size);
+    size_t inPos = 0, outPos = 0;
+    while (outPos < size) {
+        uint32_t used = 0;
+        uint32_t inLen = std::min(inStep, in.size() - inPos);
+        uint32_t produced = lzssDecode(&decoder, &in[inPos], inLen, &used,
+                                       &out[outPos], std::min(outStep, size - outPos));
+        inPos += used;
+        outPos += produced;
+        if (!produced && inPos == in.size()) {
+            break;
+        }
+    }
+    lzssReleaseDecoder(&decoder);
+    out.resize(outPos);
+    return out;
+}
+
+static Bytes firmwareLike(size_t size) {
+    Bytes data(size);
+    srand(1);
+    for (size_t i = 0; i < size; i++) {
+        // runs of zeros, repeated instruction-like words and some noise
+        data[i] = (i % 512 < 64) ? 0 : (i % 7 == 0) ? rand() : uint8_t(0x40 + (i % 24));
+    }
+    return data;
+}
+
+SCENARIO("Decoder reproduces a stream packed by the host tool", "[lzss]") {
+    // tools/ota_compress.py -w 8 -l 4, without the image header
+    const uint8_t packed[] = {
+        0xa4, 0xdb, 0xae, 0x96, 0xfa, 0x95, 0xbe, 0xc5, 0x6f, 0xba, 0x48, 0x01, 0x3e, 0x09,
+        0x3b, 0x35, 0xa6, 0xe5, 0x6d, 0xbb, 0xd8, 0x6e, 0x56, 0x50, 0x44, 0xdd, 0x6e, 0x16,
+        0x4b, 0x0d, 0xd2, 0xcb, 0x0a, 0x16, 0x78, 0xdb, 0xc6, 0xde, 0x36, 0x60
+    };
+    std::string text;
+    for (int i = 0; i < 2; i++) {
+        text += "IntoRobot IntoRobot IntoRobot firmware firmware update\n";
+    }
+    Bytes in(packed, packed + sizeof(packed));
+    Bytes out = decode(in, text.size(), 8, 4, sizeof(packed), text.size());
+    CHECK(std::string(out.begin(), out.end()) == text);
+    CHECK(lzssEncode(Bytes(text.begin(), text.end()), 8, 4) == in);
+}
+
+SCENARIO("Decoder output does not depend on how the stream is split", "[lzss]") {
+    Bytes data = firmwareLike(6000);
+    Bytes packed = lzssEncode(data, 10, 4);
+    CHECK(packed.size() < data.size() / 2);
+    CHECK(decode(packed, data.size(), 10, 4, packed.size(), data.size()) == data);
+    CHECK(decode(packed, data.size(), 10, 4, 1, 1) == data);
+    CHECK(decode(packed, data.size(), 10, 4, 3, 4096) == data);
+    CHECK(decode(packed, data.size(), 10, 4, 256, 7) == data);
+}
+
+SCENARIO("Decoder handles every window and lookahead size", "[lzss]") {
+    Bytes data = firmwareLike(3000);
+    for (int window = LZSS_MIN_WINDOW_BITS; window <= 12; window++) {
+        for (int lookahead = LZSS_MIN_LOOKAHEAD_BITS; lookahead < window && lookahead <= 8; lookahead++) {
+            Bytes packed = lzssEncode(data, window, lookahead);
+            CHECK(decode(packed, data.size(), window, lookahead, 33, 100) == data);
+        }
+    }
+}
+
+SCENARIO("Decoder stops when the stream runs out", "[lzss]") {
+    Bytes data = firmwareLike(1000);
+    Bytes packed = lzssEncode(data, 8, 4);
+    packed.resize(packed.size() / 2);
+    Bytes out = decode(packed, data.size(), 8, 4, 64, 64);
+    CHECK(out.size() < data.size());
+    CHECK(std::equal(out.begin(), out.end(), data.begin()));
+}
+
+SCENARIO("Decoder rejects unsupported sizes", "[lzss]") {
+    LZSS_DECODER decoder;
+    CHECK_FALSE(lzssInitialDecoder(&decoder, LZSS_MIN_WINDOW_BITS - 1, 3));
+    CHECK_FALSE(lzssInitialDecoder(&decoder, LZSS_MAX_WINDOW_BITS + 1, 4));
+    CHECK_FALSE(lzssInitialDecoder(&decoder, 8, 8));
+    CHECK_FALSE(lzssInitialDecoder(&decoder, 8, LZSS_MIN_LOOKAHEAD_BITS - 1));
+}
+
+SCENARIO("Benchmark decoding an image", "[.][benchmark][lzss]") {
+    Bytes data = firmwareLike(64 * 1024);
+    Bytes packed = lzssEncode(data, 11, 4);
+    const int rounds = 50;
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        decode(packed, data.size(), 11, 4, 256, 4096);
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    double mb = double(rounds) * data.size() / (1024 * 1024);
+    WARN("ratio: " << 100.0 * packed.size() / data.size() << "%, decode: " << mb / seconds << " MB/s");
+}
@@ -0,0 +1,76 @@
+/**
+ ******************************************************************************
+ * @file    lzss_encoder.h
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#ifndef LZSS_ENCODER_H_
+#define LZSS_ENCODER_H_
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+// greedy encoder writing the same bit stream as tools/ota_compress.py
+inline Bytes lzssEncode(const Bytes& in, int windowBits, int lookaheadBits) {
+    Bytes out;
+    uint8_t current = 0;
+    int count = 0;
+    auto put = [&](unsigned value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            current = (current << 1) | ((value >> i) & 1);
+            if (++count == 8) {
+                out.push_back(current);
+                current = 0;
+                count = 0;
+            }
+        }
+    };
+    const size_t window = 1u << windowBits, maxMatch = 1u << lookaheadBits;
+    for (size_t pos = 0; pos < in.size();) {
+        size_t bestLen = 0, bestOff = 0;
+        size_t limit = std::min(maxMatch, in.size() - pos);
+        for (size_t off = 1; off <= std::min(window, pos); off++) {
+            size_t len = 0;
+            while (len < limit && in[pos - off + len] == in[pos + len]) {
+                len++;
+            }
+            if (len > bestLen) {
+                bestLen = len;
+                bestOff = off;
+            }
+        }
+        if (bestLen >= 3) {
+            put(0, 1);
+            put(bestOff - 1, windowBits);
+            put(bestLen - 1, lookaheadBits);
+            pos += bestLen;
+        } else {
+            put(1, 1);
+            put(in[pos++], 8);
+        }
+    }
+    if (count) {
+        out.push_back(current << (8 - count));
+    }
+    return out;
+}
+
+#endif /* LZSS_ENCODER_H_ */
@@ -0,0 +1,135 @@
+/**
+ ******************************************************************************
+ * @file    pipe_hal.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "pipe_hal.h"
+
+#undef WARN
+#undef INFO
+#include "catch.hpp"
+
+SCENARIO("Pipe stores one element less than its size", "[pipe]") {
+    Pipe<char> p(16);
+    char data[20] = {};
+    CHECK(p.free() == 15);
+    CHECK(p.put(data, sizeof(data)) == 15);
+    CHECK_FALSE(p.writeable());
+    CHECK(p.size() == 15);
+}
+
+SCENARIO("Pipe put and get wrap around the buffer", "[pipe]") {
+    Pipe<char> p(16);
+    char in[100], out[100];
+    for (unsigned i = 0; i < sizeof(in); i++) {
+        in[i] = char(i);
+    }
+    int written = 0, read = 0;
+    while (read < int(sizeof(in))) {
+        written += p.put(&in[written], std::min<int>(11, sizeof(in) - written));
+        read += p.get(&out[read], 7);
+    }
+    CHECK(memcmp(in, out, sizeof(in)) == 0);
+    CHECK_FALSE(p.readable());
+}
+
+SCENARIO("Pipe copies whole elements", "[pipe]") {
+    Pipe<int> p(8);
+    int in[6] = { 1, 2, 3, 4, 5, 6 }, out[6] = {};
+    p.put(in, 4);
+    p.get(out, 4);
+    REQUIRE(p.put(in, 6) == 6);
+    REQUIRE(p.get(out, 6) == 6);
+    CHECK(memcmp(in, out, sizeof(in)) == 0);
+}
+
+SCENARIO("Pipe peek exposes data in place up to the wrap", "[pipe]") {
+    Pipe<char> p(8);
+    char in[] = "abcdef", out[4];
+    const char* span = nullptr;
+    p.put(in, 6);
+    p.get(out, 4);
+    REQUIRE(p.put(in, 6) == 5);
+    REQUIRE(p.peek(&span) == 4);
+    CHECK(span[0] == 'e');
+    REQUIRE(p.peek(&span, 2) == 2);
+    CHECK(span[0] == 'a');
+    REQUIRE(p.peek(&span, 4) == 3);
+    CHECK(span[0] == 'c');
+    CHECK(p.peek(&span, 7) == 0);
+    CHECK(p.skip(5) == 5);
+    REQUIRE(p.peek(&span) == 2);
+    CHECK(span[0] == 'd');
+    CHECK(p.skip(10) == 2);
+    CHECK_FALSE(p.readable());
+}
+
+SCENARIO("Pipe move drops what the target has no room for", "[pipe]") {
+    Pipe<char> from(16), to(4);
+    char in[] = "0123456789", out[8] = {};
+    from.put(in, 10);
+    CHECK(from.move(&to, 6) == 3);
+    CHECK(from.size() == 4);
+    REQUIRE(to.get(out, sizeof(out)) == 3);
+    CHECK(memcmp(out, "012", 3) == 0);
+    CHECK(from.move(NULL, 10) == 0);
+    CHECK_FALSE(from.readable());
+}
+
+SCENARIO("Pipe parsing index does not consume until done", "[pipe]") {
+    Pipe<char> p(8);
+    p.put("xyz", 3);
+    CHECK(p.set(1) == 2);
+    CHECK(p.next() == 'y');
+    CHECK(p.size() == 3);
+    p.done();
+    CHECK(p.getc() == 'z');
+}
+
+SCENARIO("Pipe writer and reader threads see an ordered stream", "[pipe]") {
+    Pipe<char> p(256);
+    const int total = 1000000;
+    std::thread producer([&]() {
+        char chunk[37];
+        int n = 0;
+        while (n < total) {
+            int len = std::min<int>(sizeof(chunk), total - n);
+            for (int i = 0; i < len; i++) {
+                chunk[i] = char(n + i);
+            }
+            n += p.put(chunk, len);
+        }
+    });
+    int n = 0;
+    bool ordered = true;
+    while (n < total) {
+        const char* span;
+        int got = p.peek(&span);
+        for (int i = 0; i < got; i++) {
+            ordered &= (span[i] == char(n + i));
+        }
+        n += p.skip(got);
+    }
+    producer.join();
+    CHECK(ordered);
+}
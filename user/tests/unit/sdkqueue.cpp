@@ -0,0 +1,169 @@
+/**
+ ******************************************************************************
+ * @file    sdkqueue.cpp
+ ******************************************************************************
+  Copyright (c) 2013-2014 IntoRobot Team.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+#include "catch.hpp"
+#include "sdkqueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+struct Queue {
+    SDK_QUEUE q;
+    Queue(uint32_t size) { sdkInitialQueue(&q, size); }
+    ~Queue() { sdkReleaseQueue(&q); }
+};
+
+SCENARIO("Queue size must be a power of two", "[sdkqueue]") {
+    SDK_QUEUE q;
+    CHECK(sdkInitialQueue(&q, 100) == SDK_PARA_ERR);
+    CHECK(q.heData == NULL);
+    CHECK(sdkGetQueueFreeLen(&q) == 0);
+    CHECK(sdkInitialQueue(&q, 0) == SDK_PARA_ERR);
+    REQUIRE(sdkInitialQueue(&q, 128) == SDK_OK);
+    CHECK(sdkGetQueueFreeLen(&q) == 128);
+    sdkReleaseQueue(&q);
+}
+
+SCENARIO("Queue is empty after creation", "[sdkqueue]") {
+    Queue q(16);
+    CHECK(sdkIsQueueEmpty(&q.q));
+    CHECK(sdkGetQueueDataLen(&q.q) == 0);
+}
+
+SCENARIO("Queue holds its full capacity", "[sdkqueue]") {
+    Queue q(16);
+    uint8_t data[20] = {};
+    CHECK(sdkInsertQueue(&q.q, data, sizeof(data)) == 16);
+    CHECK(sdkIsQueueFull(&q.q));
+    CHECK(sdkInsertQueue(&q.q, data, 1) == 0);
+}
+
+SCENARIO("Bulk insert and get wrap around the buffer", "[sdkqueue]") {
+    Queue q(16);
+    uint8_t in[64], out[64];
+    for (unsigned i = 0; i < sizeof(in); i++) {
+        in[i] = i;
+    }
+    uint32_t written = 0, read = 0;
+    while (read < sizeof(in)) {
+        written += sdkInsertQueue(&q.q, &in[written], std::min<uint32_t>(11, sizeof(in) - written));
+        read += sdkGetQueueBuffer(&q.q, &out[read], 7);
+    }
+    CHECK(memcmp(in, out, sizeof(in)) == 0);
+    CHECK(sdkIsQueueEmpty(&q.q));
+}
+
+SCENARIO("Peek does not consume data", "[sdkqueue]") {
+    Queue q(4);
+    uint8_t in[] = { 1, 2, 3 };
+    sdkInsertQueue(&q.q, in, sizeof(in));
+    uint8_t c = 0;
+    REQUIRE(sdkTryQueueData(&q.q, sdkGetQueueHead(&q.q) + 2, &c));
+    CHECK(c == 3);
+    CHECK_FALSE(sdkTryQueueData(&q.q, sdkGetQueueHead(&q.q) + 3, &c));
+    CHECK(sdkGetQueueDataLen(&q.q) == 3);
+    REQUIRE(sdkGetQueueData(&q.q, &c));
+    CHECK(c == 1);
+}
+
+SCENARIO("Span exposes queued data in place up to the wrap", "[sdkqueue]") {
+    Queue q(8);
+    uint8_t in[] = { 1, 2, 3, 4, 5, 6 }, out[4];
+    uint8_t* span = nullptr;
+    sdkInsertQueue(&q.q, in, sizeof(in));
+    sdkGetQueueBuffer(&q.q, out, sizeof(out));
+    sdkInsertQueue(&q.q, in, sizeof(in));
+    REQUIRE(sdkGetQueueSpan(&q.q, &span) == 4);
+    CHECK(span[0] == 5);
+    sdkSetQueueHead(&q.q, sdkGetQueueHead(&q.q) + 4);
+    REQUIRE(sdkGetQueueSpan(&q.q, &span) == 4);
+    CHECK(span[0] == 3);
+    CHECK(sdkGetQueueDataLen(&q.q) == 4);
+}
+
+SCENARIO("Clear empties the queue", "[sdkqueue]") {
+    Queue q(8);
+    uint8_t in[] = { 1, 2, 3 };
+    sdkInsertQueue(&q.q, in, sizeof(in));
+    sdkClearQueue(&q.q);
+    CHECK(sdkIsQueueEmpty(&q.q));
+    CHECK(sdkGetQueueFreeLen(&q.q) == 8);
+}
+
+SCENARIO("Producer and consumer threads see an ordered stream", "[sdkqueue]") {
+    Queue q(256);
+    const uint32_t total = 1000000;
+    std::thread producer([&]() {
+        uint8_t chunk[37];
+        uint32_t n = 0;
+        while (n < total) {
+            uint32_t len = std::min<uint32_t>(sizeof(chunk), total - n);
+            for (uint32_t i = 0; i < len; i++) {
+                chunk[i] = uint8_t(n + i);
+            }
+            int32_t put = sdkInsertQueue(&q.q, chunk, len);
+            n += put > 0 ? put : 0;
+        }
+    });
+    uint8_t chunk[53];
+    uint32_t n = 0;
+    bool ordered = true;
+    while (n < total) {
+        int32_t got = sdkGetQueueBuffer(&q.q, chunk, sizeof(chunk));
+        for (int32_t i = 0; i < got; i++) {
+            ordered &= (chunk[i] == uint8_t(n + i));
+        }
+        n += got;
+    }
+    producer.join();
+    CHECK(ordered);
+}
+
+SCENARIO("Benchmark bulk versus byte wise transfer", "[.][benchmark][sdkqueue]") {
+    Queue q(1024);
+    std::vector<uint8_t> in(512), out(512);
+    const int rounds = 20000;
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < in.size(); i++) {
+            sdkInsertQueue(&q.q, &in[i], 1);
+        }
+        for (size_t i = 0; i < out.size(); i++) {
+            sdkGetQueueData(&q.q, &out[i]);
+        }
+    }
+    double bytewise = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        sdkInsertQueue(&q.q, in.data(), in.size());
+        sdkGetQueueBuffer(&q.q, out.data(), out.size());
+    }
+    double bulk = std::chrono::duration<double>(clock::now() - start).count();
+
+    double mb = double(rounds) * in.size() / (1024 * 1024);
+    WARN("byte wise: " << mb / bytewise << " MB/s, bulk: " << mb / bulk << " MB/s");
+    CHECK(bulk < bytewise);
+}
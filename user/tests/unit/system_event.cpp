@@ -0,0 +1,309 @@
+// Off device tests of the system event subscriptions and dispatch. The
+// source is built here against a stand-in for the application thread, so
+// the asynchronous path and its payload copies can be driven by the test.
+
+#include <deque>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#define PLATFORM_THREADING 1
+#define SYSTEM_THREADING_H
+#define WIRING_INTERRUPTS_H_
+
+// Queues what is invoked until run() is called, like the application
+// thread between two loops
+struct TestApplicationThread {
+    bool started = false;
+    bool current = true;
+    std::deque<std::function<void()>> queue;
+
+    bool isStarted() { return started; }
+    bool isCurrentThread() { return current; }
+    void invoke_async(const std::function<void()>& fn) { queue.push_back(fn); }
+
+    void run()
+    {
+        current = true;
+        while (!queue.empty()) {
+            std::function<void()> fn = queue.front();
+            queue.pop_front();
+            fn();
+        }
+    }
+};
+
+static TestApplicationThread ApplicationThread;
+
+template<typename F>
+std::function<void()> FFL(F const &func)
+{
+    return func;
+}
+
+#define ATOMIC_BLOCK() for (bool __todo = true; __todo; __todo = false)
+
+#include "../../../system/src/system_event.cpp"
+
+#include "catch.hpp"
+
+// Fails the payload copies on the heap while set
+static bool eventHeapFails;
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    if (eventHeapFails) {
+        return nullptr;
+    }
+    try {
+        return ::operator new[](size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+struct EventCall {
+    int handler;
+    system_event_t event;
+    int param;
+    const uint8_t* data;
+    std::string payload;
+};
+
+static std::vector<EventCall> eventCalls;
+static int eventDone;
+
+template<int N>
+static void eventHandler(system_event_t event, int param, uint8_t *data, uint16_t datalen)
+{
+    EventCall call = { N, event, param, data, std::string((const char*)data, datalen) };
+    eventCalls.push_back(call);
+}
+
+static system_event_handler_t* const eventHandlers[] = {
+    eventHandler<0>, eventHandler<1>, eventHandler<2>, eventHandler<3>,
+    eventHandler<4>, eventHandler<5>, eventHandler<6>, eventHandler<7>,
+    eventHandler<8>, eventHandler<9>, eventHandler<10>, eventHandler<11>,
+    eventHandler<12>, eventHandler<13>, eventHandler<14>, eventHandler<15>,
+    eventHandler<16>
+};
+
+static void eventCompleted(void* data)
+{
+    eventDone++;
+}
+
+static void resetEvents()
+{
+    system_unsubscribe_event(event_all, nullptr, nullptr);
+    ApplicationThread = TestApplicationThread();
+    eventCalls.clear();
+    eventDone = 0;
+    eventHeapFails = false;
+    dataPoolUsed = 0;
+}
+
+static bool inDataPool(const uint8_t* data)
+{
+    return data >= dataPool[0] && data < dataPool[SYSTEM_EVENT_DATA_POOL_SIZE];
+}
+
+TEST_CASE("Subscriptions fill a fixed table", "[system_event]")
+{
+    resetEvents();
+    for (int i = 0; i < SYSTEM_EVENT_SUBSCRIPTIONS_MAX; i++) {
+        REQUIRE(system_subscribe_event(event_cloud_status, eventHandlers[i], nullptr) == 0);
+    }
+
+    // the table is full
+    REQUIRE(system_subscribe_event(event_cloud_status, eventHandlers[16], nullptr) != 0);
+    REQUIRE(system_subscribe_event(event_cloud_status, nullptr, nullptr) != 0);
+
+    // a handler subscribed already adds events to its slot
+    REQUIRE(system_subscribe_event(event_time_changed, eventHandlers[3], nullptr) == 0);
+    system_notify_event(event_time_changed);
+    REQUIRE(eventCalls.size() == 1);
+    REQUIRE(eventCalls[0].handler == 3);
+
+    SECTION("Unsubscribing some of the events keeps the slot")
+    {
+        system_unsubscribe_event(event_time_changed, eventHandlers[3], nullptr);
+        REQUIRE(system_subscribe_event(event_cloud_status, eventHandlers[16], nullptr) != 0);
+        eventCalls.clear();
+        system_notify_event(event_cloud_status);
+        REQUIRE(eventCalls.size() == SYSTEM_EVENT_SUBSCRIPTIONS_MAX);
+    }
+
+    SECTION("Unsubscribing all of the events frees the slot")
+    {
+        system_unsubscribe_event(event_cloud_status | event_time_changed, eventHandlers[3], nullptr);
+        REQUIRE(system_subscribe_event(event_reset, eventHandlers[16], nullptr) == 0);
+        eventCalls.clear();
+        system_notify_event(event_cloud_status);
+        REQUIRE(eventCalls.size() == SYSTEM_EVENT_SUBSCRIPTIONS_MAX - 1);
+        system_notify_event(event_reset);
+        REQUIRE(eventCalls.back().handler == 16);
+    }
+
+    SECTION("Unsubscribing without a handler clears the table")
+    {
+        system_unsubscribe_event(event_all, nullptr, nullptr);
+        eventCalls.clear();
+        system_notify_event(event_all);
+        REQUIRE(eventCalls.empty());
+        REQUIRE(system_subscribe_event(event_reset, eventHandlers[16], nullptr) == 0);
+    }
+}
+
+TEST_CASE("Events reach the subscribers of any of their bits", "[system_event]")
+{
+    const system_event_t highEvent = (system_event_t)1 << 40;
+
+    resetEvents();
+    REQUIRE(system_subscribe_event(event_network_status | event_cloud_status, eventHandlers[0], nullptr) == 0);
+    REQUIRE(system_subscribe_event(event_cloud_status, eventHandlers[1], nullptr) == 0);
+    REQUIRE(system_subscribe_event(highEvent, eventHandlers[2], nullptr) == 0);
+
+    SECTION("One bit")
+    {
+        system_notify_event(event_network_status, ep_network_status_on);
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(eventCalls[0].handler == 0);
+        REQUIRE(eventCalls[0].param == ep_network_status_on);
+    }
+
+    SECTION("A subscriber of several of the bits is notified once")
+    {
+        system_notify_event(event_network_status | event_cloud_status);
+        REQUIRE(eventCalls.size() == 2);
+        REQUIRE(eventCalls[0].handler == 0);
+        REQUIRE(eventCalls[1].handler == 1);
+        REQUIRE(eventCalls[0].event == (event_network_status | event_cloud_status));
+    }
+
+    SECTION("Bits without subscribers")
+    {
+        system_notify_event(event_reset | event_time_changed);
+        REQUIRE(eventCalls.empty());
+    }
+
+    SECTION("Bits of the upper word")
+    {
+        system_notify_event(highEvent | event_reset);
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(eventCalls[0].handler == 2);
+    }
+
+    SECTION("All events")
+    {
+        REQUIRE(system_subscribe_event(event_all, eventHandlers[3], nullptr) == 0);
+        system_notify_event(event_lorawan_status, 0, nullptr, 0, eventCompleted, nullptr);
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(eventCalls[0].handler == 3);
+        REQUIRE(eventDone == 1);
+    }
+}
+
+TEST_CASE("Asynchronous events copy their payload", "[system_event]")
+{
+    resetEvents();
+    REQUIRE(system_subscribe_event(event_cloud_data, eventHandlers[0], nullptr) == 0);
+
+    uint8_t data[SYSTEM_EVENT_DATA_BLOCK_SIZE + 1];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    SECTION("On the application thread the caller's payload is passed")
+    {
+        ApplicationThread.started = true;
+        system_notify_event(event_cloud_data, 0, data, 16);
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(eventCalls[0].data == data);
+    }
+
+    ApplicationThread.started = true;
+    ApplicationThread.current = false;
+
+    SECTION("The pool is used first, then the heap")
+    {
+        for (int i = 0; i < SYSTEM_EVENT_DATA_POOL_SIZE + 1; i++) {
+            system_notify_event(event_cloud_data, i, data + i, 16, eventCompleted, nullptr);
+        }
+        REQUIRE(dataPoolUsed == (1UL << SYSTEM_EVENT_DATA_POOL_SIZE) - 1);
+        REQUIRE(eventCalls.empty());
+
+        // the caller's buffer may be reused before the application thread runs
+        memset(data, 0xEE, sizeof(data));
+        ApplicationThread.run();
+        REQUIRE(eventCalls.size() == SYSTEM_EVENT_DATA_POOL_SIZE + 1);
+        REQUIRE(eventDone == SYSTEM_EVENT_DATA_POOL_SIZE + 1);
+        for (int i = 0; i < SYSTEM_EVENT_DATA_POOL_SIZE + 1; i++) {
+            const EventCall& call = eventCalls[i];
+            REQUIRE(call.param == i);
+            REQUIRE(call.payload.size() == 16);
+            REQUIRE((uint8_t)call.payload[0] == i);
+            REQUIRE((uint8_t)call.payload[15] == i + 15);
+            REQUIRE(inDataPool(call.data) == (i < SYSTEM_EVENT_DATA_POOL_SIZE));
+        }
+        REQUIRE(dataPoolUsed == 0);
+    }
+
+    SECTION("Payloads larger than a block go to the heap")
+    {
+        system_notify_event(event_cloud_data, 0, data, sizeof(data));
+        REQUIRE(dataPoolUsed == 0);
+        ApplicationThread.run();
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(!inDataPool(eventCalls[0].data));
+        REQUIRE(eventCalls[0].payload == std::string((const char*)data, sizeof(data)));
+    }
+
+    SECTION("A block freed by the application thread is used again")
+    {
+        for (int i = 0; i < SYSTEM_EVENT_DATA_POOL_SIZE; i++) {
+            system_notify_event(event_cloud_data, i, data, 16);
+        }
+        ApplicationThread.run();
+        ApplicationThread.current = false;
+        system_notify_event(event_cloud_data, 0, data, 16);
+        REQUIRE(dataPoolUsed == 1);
+        ApplicationThread.run();
+        REQUIRE(inDataPool(eventCalls.back().data));
+    }
+
+    SECTION("Events without a payload copy nothing")
+    {
+        system_notify_event(event_cloud_data, 7, nullptr, 0, eventCompleted, nullptr);
+        REQUIRE(dataPoolUsed == 0);
+        REQUIRE(eventDone == 0);
+        ApplicationThread.run();
+        REQUIRE(eventCalls.size() == 1);
+        REQUIRE(eventCalls[0].data == nullptr);
+        REQUIRE(eventDone == 1);
+    }
+
+    SECTION("An event whose payload cannot be copied is dropped")
+    {
+        for (int i = 0; i < SYSTEM_EVENT_DATA_POOL_SIZE; i++) {
+            system_notify_event(event_cloud_data, i, data, 16, eventCompleted, nullptr);
+        }
+        eventHeapFails = true;
+        system_notify_event(event_cloud_data, 99, data, 16, eventCompleted, nullptr);
+
+        // the completion runs right away, the subscribers never see it
+        REQUIRE(eventDone == 1);
+        REQUIRE(ApplicationThread.queue.size() == SYSTEM_EVENT_DATA_POOL_SIZE);
+        eventHeapFails = false;
+        ApplicationThread.run();
+        REQUIRE(eventCalls.size() == SYSTEM_EVENT_DATA_POOL_SIZE);
+        for (size_t i = 0; i < eventCalls.size(); i++) {
+            REQUIRE(eventCalls[i].param != 99);
+        }
+        REQUIRE(eventDone == SYSTEM_EVENT_DATA_POOL_SIZE + 1);
+        REQUIRE(dataPoolUsed == 0);
+    }
+
+    resetEvents();
+}
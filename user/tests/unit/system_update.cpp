@@ -0,0 +1,258 @@
+// Off device tests of the updater. The source is built here with the
+// configuration of a board with network and cloud, against flash, socket and
+// timer stand-ins, so compressed images and patches can be fed to it.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../../../hal/inc/variants/neutron/intorobot_config.h"
+
+#include "../../../system/src/system_update.cpp"
+#include "../../../wiring/src/wiring_httpclient.cpp"
+#include "../../../wiring/src/wiring_tcpclient.cpp"
+#include "../../../wiring/src/wiring_ipaddress.cpp"
+
+#undef WARN
+#undef INFO
+#include "catch.hpp"
+#include "lzss_encoder.h"
+#include "delta_patch.h"
+
+#define UPDATE_TEST_START       0x08060000
+#define UPDATE_TEST_MAX_SIZE    0x20000
+#define UPDATE_TEST_APP         0x08020000
+
+// the update area and the running application
+static Bytes updateFlash(UPDATE_TEST_MAX_SIZE, 0xff);
+static Bytes updateApp;
+// polls of an empty stream, the clock of the runner does not advance
+static int updateIdle;
+
+extern "C" {
+
+uint32_t HAL_OTA_FlashAddress() { return UPDATE_TEST_START; }
+uint32_t HAL_OTA_FlashLength() { return UPDATE_TEST_MAX_SIZE; }
+uint32_t HAL_APP_FlashAddress() { return UPDATE_TEST_APP; }
+uint32_t HAL_APP_FlashLength() { return UPDATE_TEST_MAX_SIZE; }
+
+int HAL_FLASH_Update(const uint8_t *buffer, uint32_t address, uint32_t length, void* reserved)
+{
+    if (address < UPDATE_TEST_START || address - UPDATE_TEST_START + length > updateFlash.size()) {
+        return 1;
+    }
+    memcpy(&updateFlash[address - UPDATE_TEST_START], buffer, length);
+    return 0;
+}
+
+int HAL_FLASH_Read(uint8_t *buffer, uint32_t address, uint32_t length)
+{
+    if (address < UPDATE_TEST_APP || address - UPDATE_TEST_APP + length > updateApp.size()) {
+        return -1;
+    }
+    memcpy(buffer, &updateApp[address - UPDATE_TEST_APP], length);
+    return 0;
+}
+
+bool HAL_OTA_Get_Checkpoint(void* data, uint32_t length) { return false; }
+bool HAL_OTA_Set_Checkpoint(const void* data, uint32_t length) { return true; }
+void HAL_Core_Enter_DFU_Mode(bool persist) {}
+int intorobot_cloud_handle(void) { return 0; }
+
+int inet_gethostbyname(const char* hostname, uint16_t hostnameLen, HAL_IPAddress* out_ip_addr,
+        network_interface_t nif, void* reserved) { return 1; }
+sock_handle_t socket_create(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, network_interface_t nif) { return -1; }
+int32_t socket_connect(sock_handle_t sd, const sockaddr_t *addr, long addrlen) { return -1; }
+sock_result_t socket_receive(sock_handle_t sd, void* buffer, socklen_t len, system_tick_t timeout) { return -1; }
+sock_result_t socket_send(sock_handle_t sd, const void* buffer, socklen_t len) { return -1; }
+sock_result_t socket_close(sock_handle_t sd) { return 0; }
+uint8_t socket_handle_valid(sock_handle_t handle) { return handle >= 0; }
+sock_handle_t socket_handle_invalid() { return -1; }
+uint8_t socket_active_status(sock_handle_t socket) { return SOCKET_STATUS_INACTIVE; }
+
+}
+
+uint32_t HAL_NET_SetNetWatchDog(uint32_t timeOutInMS) { return 0; }
+
+void delay(unsigned long ms)
+{
+    // the updater waits for data that is not coming
+    if (++updateIdle > 1000) {
+        throw std::runtime_error("update stream stalled");
+    }
+}
+
+namespace intorobot {
+class TestNetworkClass : public NetworkClass {
+public:
+    bool ready(void) { return false; }
+};
+static TestNetworkClass updateNetwork;
+NetworkClass& Network = updateNetwork;
+}
+
+// hands out what it holds in pieces of a few bytes
+class UpdateTestStream : public Stream {
+public:
+    Bytes data;
+    size_t pos = 0;
+
+    int available() { return std::min<size_t>(37, data.size() - pos); }
+    int read() { return pos < data.size() ? data[pos++] : -1; }
+    int peek() { return pos < data.size() ? data[pos] : -1; }
+    void flush() {}
+    size_t write(uint8_t c) { return 0; }
+};
+
+class TestHTTPUpdate : public HTTPUpdate {
+public:
+    using HTTPUpdate::runUpdate;
+};
+
+static Bytes updateRandom(size_t size)
+{
+    Bytes data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = rand();
+    }
+    return data;
+}
+
+static void updateMd5(const Bytes& data, uint8_t* md5)
+{
+    MD5Builder builder;
+    builder.begin();
+    builder.add(const_cast<uint8_t*>(data.data()), data.size());
+    builder.calculate();
+    builder.getBytes(md5);
+}
+
+static void updatePutU32(Bytes& out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out.push_back(value >> (8 * i));
+    }
+}
+
+static update_compress_header_t updateHeader(const Bytes& image)
+{
+    update_compress_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = UPDATE_COMPRESS_MAGIC;
+    header.algorithm = UPDATE_COMPRESS_LZSS;
+    header.windowBits = 10;
+    header.lookaheadBits = 4;
+    header.size = image.size();
+    updateMd5(image, header.md5);
+    return header;
+}
+
+static void resetUpdate()
+{
+    Update.end();
+    Update.clearError();
+    std::fill(updateFlash.begin(), updateFlash.end(), 0xff);
+    updateIdle = 0;
+    srand(1);
+}
+
+static bool updateFlashHolds(const Bytes& image)
+{
+    return std::equal(image.begin(), image.end(), updateFlash.begin());
+}
+
+TEST_CASE("A compressed image ending in a back-reference across a sector", "[system_update]")
+{
+    resetUpdate();
+
+    // the last 16 bytes repeat earlier ones, one match of the longest length
+    // of which only 5 bytes are in the last sector
+    Bytes image = updateRandom(2 * UPDATE_SECTOR_SIZE + 5 - 16);
+    Bytes repeated(image.end() - 300, image.end() - 284);
+    image.insert(image.end(), repeated.begin(), repeated.end());
+    update_compress_header_t header = updateHeader(image);
+    Bytes packed = lzssEncode(image, header.windowBits, header.lookaheadBits);
+
+    REQUIRE(Update.begin(image.size(), UPDATE_TEST_START, UPDATE_TEST_MAX_SIZE));
+    REQUIRE(Update.setCompression(&header));
+
+    SECTION("In one piece")
+    {
+        REQUIRE(Update.write(packed.data(), packed.size()) == packed.size());
+    }
+
+    SECTION("A byte at a time")
+    {
+        for (size_t i = 0; i < packed.size(); i++) {
+            REQUIRE(Update.write(&packed[i], 1) == 1);
+        }
+    }
+
+    REQUIRE(Update.isFinished());
+    REQUIRE(Update.end());
+    REQUIRE(updateFlashHolds(image));
+}
+
+TEST_CASE("A patch is applied to the running application", "[system_update]")
+{
+    resetUpdate();
+    updateApp = updateRandom(3 * UPDATE_SECTOR_SIZE);
+
+    Bytes image(updateApp.begin(), updateApp.begin() + 5000);
+    Bytes inserted = updateRandom(700);
+    image.insert(image.end(), inserted.begin(), inserted.end());
+    image.insert(image.end(), updateApp.begin() + 5000, updateApp.end());
+    for (size_t i = 6000; i < 6100; i++) {
+        image[i] += 3;
+    }
+
+    Bytes patch;
+    patch.push_back(DELTA_OP_COPY);
+    updatePutU32(patch, 0);
+    updatePutU32(patch, 5000);
+    patch.push_back(DELTA_OP_INSERT);
+    updatePutU32(patch, inserted.size());
+    patch.insert(patch.end(), inserted.begin(), inserted.end());
+    patch.push_back(DELTA_OP_ADD);
+    updatePutU32(patch, 5000);
+    updatePutU32(patch, 1000);
+    for (size_t i = 0; i < 1000; i++) {
+        patch.push_back(i >= 300 && i < 400 ? 3 : 0);
+    }
+    patch.push_back(DELTA_OP_COPY);
+    updatePutU32(patch, 6000);
+    updatePutU32(patch, updateApp.size() - 6000);
+
+    update_delta_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.image = updateHeader(image);
+    header.image.magic = UPDATE_DELTA_MAGIC;
+    header.baseSize = updateApp.size();
+    updateMd5(updateApp, header.baseMd5);
+
+    UpdateTestStream in;
+    in.setTimeout(0);
+    in.data.assign((const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    Bytes packed = lzssEncode(patch, header.image.windowBits, header.image.lookaheadBits);
+    in.data.insert(in.data.end(), packed.begin(), packed.end());
+
+    TestHTTPUpdate updater;
+    REQUIRE(updater.setStoreStartAddress(UPDATE_TEST_START));
+    REQUIRE(updater.setStoreMaxSize(UPDATE_TEST_MAX_SIZE));
+
+    SECTION("The patch is downloaded")
+    {
+        REQUIRE(updater.runUpdate(in, in.data.size(), String()));
+        REQUIRE(in.pos == in.data.size());
+        REQUIRE(updateFlashHolds(image));
+    }
+
+    SECTION("Another application is running")
+    {
+        updateApp[100] ^= 1;
+        REQUIRE_FALSE(updater.runUpdate(in, in.data.size(), String()));
+        REQUIRE(updater.getLastError() == UPDATE_ERROR_BASE);
+    }
+}
@@ -40,6 +40,9 @@ extern "C"
 string_buffer*
 stringBufferCreate(void);
 
+// sets up a buffer owned by the caller, e.g. on the stack, it needs no free
+void stringBufferInit(string_buffer* buffer);
+
 char stringBufferAdd(char value, string_buffer* buffer);
 
 char* stringBufferToString(string_buffer* buffer);
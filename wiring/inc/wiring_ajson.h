@@ -74,6 +74,50 @@ typedef struct aJsonObject
     };
 } aJsonObject;
 
+// longest path aJsonClass::extract() follows
+#define AJSON_PATH_LEN 64
+
+/* One field for aJsonClass::extract(). path names it in the message,
+ * e.g. "params.list[2].name". type is aJson_Boolean (bool), aJson_Int
+ * (int), aJson_Uint (uint32_t), aJson_Float (double) or aJson_String
+ * (char buffer of size bytes) and tells what value points to. found is
+ * set when the field is present and fits the type. */
+typedef struct aJsonExtract
+{
+    const char *path;
+    char type;
+    void *value;
+    size_t size;
+    bool found;
+} aJsonExtract;
+
+/* aJsonArena is optional memory for one parse or build: items and
+ * strings are taken from the caller's buffer one after the other and
+ * are all released by reset(). When the buffer is full the heap is used
+ * again, so aJsonClass::deleteItem() is still to be called before reset(),
+ * it frees what did not fit and leaves the rest alone. */
+class aJsonArena
+{
+    public:
+        aJsonArena(void *buffer_, size_t size_)
+            : buffer((uint8_t *)buffer_), size(size_), offset(0)
+        {}
+
+        /* NULL when the arena has no room left. */
+        void* alloc(size_t len, size_t align = sizeof(double));
+        bool contains(const void *ptr) const
+        {
+            return ((const uint8_t *)ptr >= buffer) && ((const uint8_t *)ptr < buffer + size);
+        }
+        void reset(void) { offset = 0; }
+        size_t used(void) const { return offset; }
+
+    private:
+        uint8_t *buffer;
+        size_t size;
+        size_t offset;
+};
+
 /* aJsonStream is stream representation of aJson for its internal use;
  * it is meant to abstract out differences between Stream (e.g. serial
  * stream) and Client (which may or may not be connected) or provide even
@@ -81,7 +125,7 @@ typedef struct aJsonObject
 class aJsonStream : public Print
 {
     public:
-        aJsonStream(Stream *stream_): stream_obj(stream_), bucket(EOF) {}
+        aJsonStream(Stream *stream_): stream_obj(stream_), bucket(EOF), arena(NULL) {}
         /* Use this to check if more data is available, as aJsonStream
         * can read some more data than really consumed and automatically
         * skips separating whitespace if you use this method. */
@@ -97,6 +141,7 @@ class aJsonStream : public Print
         int printString(aJsonObject *item);
 
         int skip(void);
+        int skipValue(void);
         int flush(void);
 
         int parseValue(aJsonObject *item, char** filter);
@@ -108,6 +153,12 @@ class aJsonStream : public Print
         int parseObject(aJsonObject *item, char** filter);
         int printObject(aJsonObject *item);
 
+        int readName(char *buffer, size_t size);
+        int extractValue(char *path, size_t len, aJsonExtract *table, size_t count);
+        int extractObject(char *path, size_t len, aJsonExtract *table, size_t count);
+        int extractArray(char *path, size_t len, aJsonExtract *table, size_t count);
+        int extractItem(aJsonExtract *field);
+
     protected:
         /* Blocking load of character, returning EOF if the stream
         * is exhausted. */
@@ -135,21 +186,40 @@ class aJsonStream : public Print
         * to be returned by next getch() - returned by a call
         * to ungetch(). */
         int bucket;
+
+        /* Set by aJsonClass::parse(), where parsed items are allocated. */
+        aJsonArena *arena;
+        friend class aJsonClass;
 };
 
 #ifndef configNO_NETWORK
+// how much of an HTTP body aJsonClientStream reads at once
+#define AJSON_CLIENT_RX_SIZE 32
+
+class HTTPClient;
+
 /* JSON stream that consumes data from a connection (usually
- * Ethernet client) until the connection is closed. */
+ * Ethernet client) until the connection is closed, or the body
+ * of an HTTP response, which is parsed as it arrives instead of
+ * being buffered first. */
 class aJsonClientStream : public aJsonStream {
     public:
         aJsonClientStream(Client *stream_)
-            : aJsonStream(NULL), client_obj(stream_)
+            : aJsonStream(NULL), client_obj(stream_), http_obj(NULL), rx_pos(0), rx_len(0)
+        {}
+        aJsonClientStream(HTTPClient *http_)
+            : aJsonStream(NULL), client_obj(NULL), http_obj(http_), rx_pos(0), rx_len(0)
         {}
 
+        virtual bool available(void);
+
     private:
         virtual int getch(void);
 
         Client *client_obj;
+        HTTPClient *http_obj;
+        uint8_t rx_buf[AJSON_CLIENT_RX_SIZE];
+        uint8_t rx_pos, rx_len;
         virtual inline Client *stream() { return client_obj; }
 };
 #endif
@@ -179,11 +249,56 @@ class aJsonStringStream : public aJsonStream
 };
 
 
+/* Forward only JSON writer that appends straight to a buffer or to a
+ * Print sink, without building a tree first. Commas are put in by the
+ * writer, name is NULL for array elements. A full buffer cuts the text
+ * but length() goes on counting, so a buffer of length() + 1 bytes is
+ * what the whole text needs, a writer on (NULL, 0) only measures. */
+class aJsonWriter
+{
+    public:
+        aJsonWriter(char *buffer_, size_t size_);
+        aJsonWriter(Print *sink_);
+
+        aJsonWriter& beginObject(const char *name = NULL);
+        aJsonWriter& endObject(void);
+        aJsonWriter& beginArray(const char *name = NULL);
+        aJsonWriter& endArray(void);
+
+        aJsonWriter& add(const char *name, const char *value);
+        aJsonWriter& add(const char *name, bool value);
+        aJsonWriter& add(const char *name, int value);
+        aJsonWriter& add(const char *name, unsigned int value);
+        aJsonWriter& add(const char *name, long value);
+        aJsonWriter& add(const char *name, unsigned long value);
+        aJsonWriter& add(const char *name, double value, unsigned char digits = 5);
+        aJsonWriter& addNull(const char *name);
+
+        size_t length(void) const { return len; }
+        bool overflow(void) const { return (sink == NULL) && (len >= size); }
+
+    private:
+        void write(const char *str, size_t n);
+        void writeString(const char *str);
+        void writeNumber(unsigned long value, bool negative);
+        void separator(const char *name);
+
+        char *buffer;
+        size_t size;
+        Print *sink;
+        size_t len;
+        uint32_t comma; // one bit per nesting level (31 at most), set once it holds a value
+        uint8_t depth;
+};
+
 class aJsonClass
 {
         /******************************************************************************
         * Constructors
         ******************************************************************************/
+    public:
+        // Items are allocated from arena_ if given, see aJsonArena.
+        aJsonClass(aJsonArena *arena_ = NULL) : arena(arena_) {}
 
         /******************************************************************************
         * User API
@@ -192,7 +307,11 @@ class aJsonClass
         // Supply a block of JSON, and this returns a aJson object you can interrogate. Call aJson.deleteItem when finished.
         aJsonObject* parse(aJsonStream* stream); //Reads from a stream
         aJsonObject* parse(aJsonStream* stream,char** filter_values); //Read from a file, but only return values include in the char* array filter_values
+                                                                      //(NULL terminated, matched against the names of the outermost object, the others are skipped unparsed)
         aJsonObject* parse(char *value); //Reads from a string
+        // Fill the fields of table in one pass, without building a tree. Returns how many were found, or EOF if the text is malformed.
+        int extract(aJsonStream* stream, aJsonExtract *table, size_t count);
+        int extract(char *value, aJsonExtract *table, size_t count);
         // Render a aJsonObject entity to text for transfer/storage. Free the char* when finished.
         int print(aJsonObject *item, aJsonStream* stream);
         char* print(aJsonObject* item);
@@ -244,11 +363,15 @@ class aJsonClass
 
     protected:
         friend class aJsonStream;
-        static aJsonObject* newItem(void);
+        static aJsonObject* newItem(aJsonArena *arena);
+        static void freeItem(aJsonArena *arena, void *ptr);
 
     private:
         void suffixObject(aJsonObject *prev, aJsonObject *item);
         aJsonObject* createReference(aJsonObject *item);
+        char* newString(const char *string);
+
+        aJsonArena *arena;
 };
 
 bool jsonGetValue(uint8_t *payload, const char *string, bool &ret_bool);
@@ -263,6 +386,7 @@ bool jsonGetValue(uint8_t *payload,  const char *string, long &ret_long);
 bool jsonGetValue(uint8_t *payload, const char *string, unsigned long &ret_ulong);
 bool jsonGetValue(uint8_t *payload, const char *string, float &ret_float);
 bool jsonGetValue(uint8_t *payload, const char *string, double &ret_double);
+int jsonGetValues(uint8_t *payload, aJsonExtract *table, size_t count);
 
 #endif /*WIRING_AJSON_H_*/
 
@@ -51,6 +51,12 @@
 /// size for the stream handling
 #define HTTP_TCP_BUFFER_SIZE (1460)
 
+/// longest response header line parsed, the rest of a line is dropped
+#define HTTPCLIENT_HEADER_LINE_SIZE (128)
+
+/// room for the values of the headers given to collectHeaders()
+#define HTTPCLIENT_HEADER_VALUES_SIZE (128)
+
 /// HTTP codes see RFC7231
 typedef enum {
     HTTP_CODE_CONTINUE = 100,
@@ -115,7 +121,8 @@ typedef enum {
 
 typedef enum {
     HTTPC_TE_IDENTITY,
-    HTTPC_TE_CHUNKED
+    HTTPC_TE_CHUNKED,
+    HTTPC_TE_UNKNOWN    // not supported, the response is refused
 } transferEncoding_t;
 
 class TransportTraits;
@@ -156,6 +163,7 @@ public:
 
     /// Response handling
     void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    const char* headerValue(const char* name, size_t* length = NULL); // get request header value in place, valid until the next request
     String header(const char* name);   // get request header value by name
     String header(size_t i);              // get request header value by number
     String headerName(size_t i);          // get request header name by number
@@ -168,6 +176,7 @@ public:
     TCPClient& getStream(void);
     TCPClient* getStreamPtr(void);
     int writeToStream(Stream* stream);
+    int readBody(uint8_t * buffer, size_t size); // read the decoded payload, returns 0 at the end of it
     String getString(void);
 
     static String errorToString(int error);
@@ -175,16 +184,22 @@ public:
 protected:
     struct RequestArgument {
         String key;
-        String value;
+        const char* value;
+        size_t length;
     };
 
     bool beginInternal(String url, const char* expectedProtocol);
     void clear();
+    void endOther(const String& host, uint16_t port);
     int returnError(int error);
     bool connect(void);
     bool sendHeader(const char * type);
     int handleHeaderResponse();
+    void handleHeaderLine(char * line, size_t len);
     int writeToStreamDataBlock(Stream * stream, int len);
+    int readTimeout(void);
+    int readChunkSize(void);
+    int readChunkTrailer(void);
 
     TransportTraitsPtr _transportTraits;
     std::unique_ptr<TCPClient> _tcp;
@@ -205,11 +220,16 @@ protected:
     /// Response handling
     RequestArgument* _currentHeaders = nullptr;
     size_t           _headerKeysCount = 0;
+    char*            _headerValues = nullptr;
+    size_t           _headerValuesLength = 0;
 
     int _returnCode = 0;
     int _size = -1;
     bool _canReuse = false;
     transferEncoding_t _transferEncoding = HTTPC_TE_IDENTITY;
+    int _bodyLeft = 0;      // payload left in the body or the current chunk, -1 until the connection closes
+    bool _bodyDone = true;
+    bool _bodyRaw = false;  // the stream was handed out, the body may have been read past readBody()
 };
 
 #endif
@@ -54,6 +54,7 @@ class Stream : public Print
 // parsing methods
 
   void setTimeout(system_tick_t timeout);  // sets maximum milliseconds to wait for stream data, default is 1 second
+  system_tick_t getTimeout() { return _timeout; }  // returns the timeout set by setTimeout
 
   bool find(char *target);   // reads data from the stream until the target string is found
   // returns true if target string is found, false if timed out (see setTimeout)
@@ -72,7 +73,7 @@ class Stream : public Print
 
   float parseFloat();               // float version of parseInt
 
-  size_t readBytes( char *buffer, size_t length); // read chars from stream into buffer
+  virtual size_t readBytes( char *buffer, size_t length); // read chars from stream into buffer
   // terminates if length characters have been read or timeout (see setTimeout)
   // returns the number of characters placed in the buffer (0 means no valid data found)
 
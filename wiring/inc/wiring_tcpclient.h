@@ -32,14 +32,56 @@
 #include "socket_hal.h"
 #include "platforms.h"
 
+// default size of the read buffer, see setReadBuffer()
 #define TCPCLIENT_BUF_MAX_SIZE  256
 
+// buffered writes go out after this many ms without a further write
+#ifndef TCPCLIENT_WRITE_IDLE_MS
+#define TCPCLIENT_WRITE_IDLE_MS  20
+#endif
+
 class TCPClient : public Client {
 
     public:
         TCPClient();
         TCPClient(sock_handle_t sock);
-        virtual ~TCPClient() {};
+        TCPClient(const TCPClient& client);
+        virtual ~TCPClient();
+        TCPClient& operator=(const TCPClient& client);
+
+        /**
+         * Gathers small writes and sends them in one go. They are sent once the
+         * buffer is full, on flush(), before data is read, on stop() and after
+         * TCPCLIENT_WRITE_IDLE_MS without a further write. Writes that do not fit
+         * into the buffer are sent right away. A copy of the client gets an
+         * empty buffer of the same size.
+         *
+         * @param buffer_size The size of the write buffer. 0 (the default) sends
+         *  every write right away.
+         * @param buffer    A pre-allocated buffer. This is optional, and if not specified
+         *  the TCPClient class will allocate the buffer dynamically.
+         * @return true if the buffer is set
+         */
+        bool setWriteBuffer(size_t buffer_size, uint8_t* buffer=NULL);
+
+        /**
+         * Sets the buffer received data is staged in. Reads larger than what is
+         * buffered are received straight into the caller's memory, the buffer
+         * serves the smaller ones. Data already buffered is kept.
+         *
+         * @param buffer_size The size of the read buffer, TCPCLIENT_BUF_MAX_SIZE
+         *  unless set. It is allocated on first use.
+         * @param buffer    A pre-allocated buffer. This is optional, and if not specified
+         *  the TCPClient class will allocate the buffer dynamically.
+         * @return true if the buffer is set
+         */
+        bool setReadBuffer(size_t buffer_size, uint8_t* buffer=NULL);
+
+        /**
+         * Sends what the buffered clients gathered and did not add to for
+         * TCPCLIENT_WRITE_IDLE_MS. Called after each application loop.
+         */
+        static void flushIdle();
 
         uint8_t status();
         virtual int connect(IPAddress ip, uint16_t port, network_interface_t=0);
@@ -49,6 +91,7 @@ class TCPClient : public Client {
         virtual int available();
         virtual int read();
         virtual int read(uint8_t *buffer, size_t size);
+        virtual size_t readBytes(char *buffer, size_t length);
         virtual int peek();
         virtual void flush();
         void flush_buffer();
@@ -68,11 +111,23 @@ class TCPClient : public Client {
     private:
         static uint16_t _srcport;
         sock_handle_t _sock;
-        uint8_t _buffer[TCPCLIENT_BUF_MAX_SIZE];
+        uint8_t* _buffer;
+        uint16_t _bufferSize;
+        uint8_t _bufferAllocated;
         uint16_t _offset;
         uint16_t _total;
         IPAddress _remoteIP;
+        uint8_t* _txBuffer;
+        uint16_t _txSize;
+        uint16_t _txCount;
+        uint8_t _txAllocated;
+        system_tick_t _txTime;
+        TCPClient* _txNext;
+        static TCPClient* _txClients;
         inline int bufferCount();
+        int sendBuffered();
+        void releaseWriteBuffer();
+        void releaseReadBuffer();
 };
 
 #endif
@@ -45,16 +45,18 @@ class USARTSerial : public Stream
         virtual int available(void);
         virtual int peek(void);
         virtual int read(void);
+        int read(uint8_t *buffer, size_t size);  // reads up to size bytes already received, does not block
         virtual void flush(void);
         size_t write(uint16_t);
         virtual size_t write(uint8_t);
+        virtual size_t write(const uint8_t *buffer, size_t size);
 
         inline size_t write(unsigned long n) { return write((uint8_t)n); }
         inline size_t write(long n) { return write((uint8_t)n); }
         inline size_t write(unsigned int n) { return write((uint8_t)n); }
         inline size_t write(int n) { return write((uint8_t)n); }
 
-        using Print::write; // pull in write(str) and write(buf, size) from Print
+        using Print::write; // pull in write(str) from Print
 
         operator bool();
 
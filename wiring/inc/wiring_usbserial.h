@@ -46,6 +46,7 @@ class USBSerial : public Stream
 
         virtual size_t write(uint8_t byte);
         virtual int read();
+        int read(uint8_t *buffer, size_t size);  // reads up to size bytes already received, does not block
         virtual int availableForWrite(void);
         virtual int available();
         virtual void flush();
@@ -61,6 +61,14 @@ string_buffer *stringBufferCreate(void)
     return result;
 }
 
+void stringBufferInit(string_buffer* buffer)
+{
+    // the content is not cleared, the strings are terminated when they end
+    buffer->string = global_buffer;
+    buffer->memory = BUFFER_SIZE;
+    buffer->string_length = 0;
+}
+
 char stringBufferAdd(char value, string_buffer* buffer)
 {
     if (buffer->string_length >= buffer->memory)
@@ -23,6 +23,7 @@
 #include "wiring_usbserial.h"
 #include "wiring_usartserial.h"
 #include "wiring_watchdog.h"
+#include "wiring_tcpclient.h"
 #include "rng_hal.h"
 
 
@@ -85,6 +86,9 @@ void usbSerialEvent() __attribute__((weak));
 void _post_loop()
 {
 	serialEventRun();
+#ifndef configNO_NETWORK
+	TCPClient::flushIdle();
+#endif
 	//application_checkin();
 }
 
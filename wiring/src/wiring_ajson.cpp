@@ -40,7 +40,11 @@
 #include <limits.h>
 #include "stringbuffer.h"
 #include "wiring_ajson.h"
-#include "wiring.h"
+#include "wiring_ticks.h"
+#include "wiring_string.h"
+#ifndef configNO_NETWORK
+#include "wiring_httpclient.h"
+#endif
 #include "service_debug.h"
 
 /******************************************************************************
@@ -106,6 +110,14 @@ size_t aJsonStream::readBytes(uint8_t *buffer, size_t len)
 }
 
 #ifndef configNO_NETWORK
+bool aJsonClientStream::available(void)
+{
+    if (http_obj == NULL) {
+        return aJsonStream::available();
+    }
+    return this->skip() != EOF;
+}
+
 int aJsonClientStream::getch()
 {
     if (bucket != EOF) {
@@ -113,6 +125,18 @@ int aJsonClientStream::getch()
         bucket = EOF;
         return ret;
     }
+    if (http_obj != NULL) {
+        // the body is read in small blocks, it ends where the response ends
+        if (rx_pos >= rx_len) {
+            int len = http_obj->readBody(rx_buf, sizeof(rx_buf));
+            if (len <= 0) {
+                return EOF;
+            }
+            rx_pos = 0;
+            rx_len = len;
+        }
+        return rx_buf[rx_pos++];
+    }
     while (!stream()->available() && stream()->connected()) /* spin */;
     // therefore, !stream()->connected()
     if (!stream()->available()) {
@@ -155,15 +179,50 @@ size_t aJsonStringStream::write(uint8_t ch)
     return 1;
 }
 
+void *aJsonArena::alloc(size_t len, size_t align)
+{
+    uintptr_t start = ((uintptr_t)buffer + offset + align - 1) & ~(uintptr_t)(align - 1);
+    if (start + len > (uintptr_t)buffer + size) {
+        return NULL;
+    }
+    offset = start + len - (uintptr_t)buffer;
+    return (void *)start;
+}
+
+// Allocate from the arena, or from the heap without one or once it is full.
+static void *arenaAlloc(aJsonArena *arena, size_t len, size_t align = sizeof(double))
+{
+    void *ptr = arena ? arena->alloc(len, align) : NULL;
+    return ptr ? ptr : malloc(len);
+}
+
 // Internal constructor.
-aJsonObject *aJsonClass::newItem(void)
+aJsonObject *aJsonClass::newItem(aJsonArena *arena)
 {
-    aJsonObject* node = (aJsonObject*)malloc(sizeof(aJsonObject));
+    aJsonObject* node = (aJsonObject*)arenaAlloc(arena, sizeof(aJsonObject));
     if (node)
     {memset(node, 0, sizeof(aJsonObject));}
     return node;
 }
 
+// Arena memory is given back all at once by aJsonArena::reset().
+void aJsonClass::freeItem(aJsonArena *arena, void *ptr)
+{
+    if (!arena || !arena->contains(ptr)) {
+        free(ptr);
+    }
+}
+
+char *aJsonClass::newString(const char *string)
+{
+    size_t len = strlen(string) + 1;
+    char *str = (char *)arenaAlloc(arena, len, 1);
+    if (str) {
+        memcpy(str, string, len);
+    }
+    return str;
+}
+
 // Delete a aJsonObject structure.
 void aJsonClass::deleteItem(aJsonObject *c)
 {
@@ -173,12 +232,12 @@ void aJsonClass::deleteItem(aJsonObject *c)
         if (!(c->type & aJson_IsReference) && c->child) {
             deleteItem(c->child);
         } if ((c->type == aJson_String) && c->valuestring) {
-            free(c->valuestring);
+            freeItem(arena, c->valuestring);
         }
         if (c->name) {
-            free(c->name);
+            freeItem(arena, c->name);
         }
-        free(c);
+        freeItem(arena, c);
         c = next;
     }
 }
@@ -277,15 +336,12 @@ int aJsonStream::parseString(aJsonObject *item)
         return EOF; // not a string!
     }
     item->type = aJson_String;
-    //allocate a buffer & track how long it is and how much we have read
-    string_buffer* buffer = stringBufferCreate();
-    if (buffer == NULL) {
-        //unable to allocate the string
-        return EOF;
-    }
+    //track how long it is and how much we have read
+    string_buffer local;
+    string_buffer* buffer = &local;
+    stringBufferInit(buffer);
     in = this->getch();
     if (in == EOF) {
-        stringBufferFree(buffer);
         return EOF;
     }
     while (in != EOF) {
@@ -295,7 +351,6 @@ int aJsonStream::parseString(aJsonObject *item)
             } else {
                 in = this->getch();
                 if (in == EOF) {
-                    stringBufferFree(buffer);
                     return EOF;
                 }
                 switch (in) {
@@ -330,12 +385,20 @@ int aJsonStream::parseString(aJsonObject *item)
             }
             in = this->getch();
             if (in == EOF) {
-                stringBufferFree(buffer);
                 return EOF;
             }
         }
         //the string ends here
-        item->valuestring = stringBufferToString(buffer);
+        stringBufferAdd(0, buffer);
+        buffer->string[buffer->string_length - 1] = 0; // cut when the buffer is full
+        if (arena == NULL) {
+            item->valuestring = (char *)malloc(buffer->string_length);
+        } else {
+            item->valuestring = (char *)arenaAlloc(arena, buffer->string_length, 1);
+        }
+        if (item->valuestring) {
+            memcpy(item->valuestring, buffer->string, buffer->string_length);
+        }
         return 0;
     }
     //we should not be here but it is ok
@@ -409,6 +472,58 @@ int aJsonStream::skip(void)
     return EOF;
 }
 
+// Consume a value without building it, strings may hold brackets
+// so they are skipped as a whole.
+int aJsonStream::skipValue(void)
+{
+    int depth = 0;
+    do {
+        if (this->skip() == EOF) {
+            return EOF;
+        }
+        int in = this->getch();
+        if (in == '\"') {
+            in = this->getch();
+            while (in != '\"') {
+                if (in == EOF) {
+                    return EOF;
+                }
+                if (in == '\\' && this->getch() == EOF) {
+                    return EOF;
+                }
+                in = this->getch();
+            }
+        } else if (in == '{' || in == '[') {
+            depth++;
+        } else if (in == '}' || in == ']') {
+            if (--depth < 0) {
+                return EOF; // malformed.
+            }
+        } else if (in != ',' && in != ':') {
+            // number, true, false or null
+            while (isalnum(in) || in == '-' || in == '+' || in == '.') {
+                in = this->getch();
+            }
+            if (in == EOF) {
+                return EOF;
+            }
+            this->ungetch(in);
+        }
+    } while (depth > 0);
+    return 0;
+}
+
+// Check whether name is listed in the NULL terminated filter.
+static bool filterMatch(const char *name, char** filter)
+{
+    for (; *filter != NULL; filter++) {
+        if (!strcasecmp(name, *filter)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Utility to flush our buffer in case it contains garbage
 // since the parser will return the buffer untouched if it
 // cannot understand it.
@@ -442,7 +557,8 @@ aJsonObject *aJsonClass::parse(aJsonStream* stream, char** filter)
     if (stream == NULL) {
         return NULL;
     }
-    aJsonObject *c = newItem();
+    stream->arena = arena;
+    aJsonObject *c = newItem(arena);
     if (!c)
     {return NULL;} /* memory fail */
 
@@ -454,6 +570,34 @@ aJsonObject *aJsonClass::parse(aJsonStream* stream, char** filter)
     return c;
 }
 
+// Pick single fields out of the text without building a tree.
+int aJsonClass::extract(char *value, aJsonExtract *table, size_t count)
+{
+    aJsonStringStream stringStream(value, NULL);
+    return extract(&stringStream, table, count);
+}
+
+int aJsonClass::extract(aJsonStream* stream, aJsonExtract *table, size_t count)
+{
+    char path[AJSON_PATH_LEN];
+    int found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        table[i].found = false;
+    }
+    if (stream == NULL) {
+        return EOF;
+    }
+    path[0] = 0;
+    if (stream->extractValue(path, 0, table, count) == EOF) {
+        return EOF;
+    }
+    for (size_t i = 0; i < count; i++) {
+        found += table[i].found;
+    }
+    return found;
+}
+
 // Render a aJsonObject item/entity/structure to text.
 int aJsonClass::print(aJsonObject* item, aJsonStream* stream)
 {
@@ -591,7 +735,7 @@ int aJsonStream::parseArray(aJsonObject *item, char** filter)
     aJsonObject *child = NULL;
     char first = -1;
     while ((first) || (in == ',')) {
-        aJsonObject *new_item = aJsonClass::newItem();
+        aJsonObject *new_item = aJsonClass::newItem(arena);
         if (new_item == NULL) {
             return EOF; // memory fail
         }
@@ -666,25 +810,24 @@ int aJsonStream::parseObject(aJsonObject *item, char** filter)
     aJsonObject* child = NULL;
     char first = -1;
     while ((first) || (in == ',')) {
-        aJsonObject* new_item = aJsonClass::newItem();
+        first = 0;
+        aJsonObject* new_item = aJsonClass::newItem(arena);
         if (new_item == NULL) {
             return EOF; // memory fail
         }
-        if (first) {
-            first = 0;
+        if (child == NULL) {
             item->child = new_item;
         } else {
             child->next = new_item;
             new_item->prev = child;
         }
-        child = new_item;
         this->skip();
-        if (this->parseString(child) == EOF) {
+        if (this->parseString(new_item) == EOF) {
             return EOF;
         }
         this->skip();
-        child->name = child->valuestring;
-        child->valuestring = NULL;
+        new_item->name = new_item->valuestring;
+        new_item->valuestring = NULL;
 
         in = this->getch();
         if (in != ':') {
@@ -692,8 +835,23 @@ int aJsonStream::parseObject(aJsonObject *item, char** filter)
         }
         // skip any spacing, get the value.
         this->skip();
-        if (this->parseValue(child, filter) == EOF) {
-            return EOF;
+        if (filter != NULL && !filterMatch(new_item->name, filter)) {
+            // not wanted, drop the member without building its value
+            if (this->skipValue() == EOF) {
+                return EOF;
+            }
+            if (child == NULL) {
+                item->child = NULL;
+            } else {
+                child->next = NULL;
+            }
+            aJsonClass::freeItem(arena, new_item->name);
+            aJsonClass::freeItem(arena, new_item);
+        } else {
+            child = new_item;
+            if (this->parseValue(child, NULL) == EOF) {
+                return EOF;
+            }
         }
         this->skip();
         in = this->getch();
@@ -739,6 +897,445 @@ int aJsonStream::printObject(aJsonObject *item)
     return 0;
 }
 
+// Read a string into buffer, cut to fit. Returns its full length
+// like snprintf, so a result >= size tells it was cut.
+int aJsonStream::readName(char *buffer, size_t size)
+{
+    size_t len = 0;
+    int in = this->getch();
+    if (in != '\"') {
+        return EOF; // not a string!
+    }
+    in = this->getch();
+    while (in != '\"') {
+        if (in == EOF) {
+            return EOF;
+        }
+        if (in == '\\') {
+            in = this->getch();
+            switch (in) {
+                case EOF:
+                    return EOF;
+                case 'b':
+                    in = '\b';
+                    break;
+                case 'f':
+                    in = '\f';
+                    break;
+                case 'n':
+                    in = '\n';
+                    break;
+                case 'r':
+                    in = '\r';
+                    break;
+                case 't':
+                    in = '\t';
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (len + 1 < size) {
+            buffer[len] = in;
+        }
+        len++;
+        in = this->getch();
+    }
+    if (size) {
+        buffer[(len < size) ? len : size - 1] = 0;
+    }
+    return len;
+}
+
+// Walk one value at path, len long. Only values some field of the
+// table lies in are entered, the others are skipped.
+int aJsonStream::extractValue(char *path, size_t len, aJsonExtract *table, size_t count)
+{
+    aJsonExtract *field = NULL;
+    bool inside = false;
+
+    if (this->skip() == EOF) {
+        return EOF;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const char *p = table[i].path;
+        if (strncmp(p, path, len)) {
+            continue;
+        }
+        if (p[len] == 0) {
+            if (field == NULL) {
+                field = &table[i];
+            }
+        } else if (len == 0 || p[len] == '.' || p[len] == '[') {
+            inside = true;
+        }
+    }
+    if (field != NULL) {
+        return this->extractItem(field);
+    }
+    if (inside) {
+        int in = this->getch();
+        this->ungetch(in);
+        if (in == '{') {
+            return this->extractObject(path, len, table, count);
+        } else if (in == '[') {
+            return this->extractArray(path, len, table, count);
+        }
+    }
+    return this->skipValue();
+}
+
+int aJsonStream::extractObject(char *path, size_t len, aJsonExtract *table, size_t count)
+{
+    this->getch(); // '{'
+    this->skip();
+    int in = this->getch();
+    if (in == '}') {
+        return 0; // empty object.
+    }
+    this->ungetch(in);
+
+    size_t start = len ? len + 1 : 0;
+    do {
+        this->skip();
+        int n = (start < AJSON_PATH_LEN) ? this->readName(path + start, AJSON_PATH_LEN - start) : this->readName(NULL, 0);
+        if (n == EOF) {
+            return EOF;
+        }
+        this->skip();
+        if (this->getch() != ':') {
+            return EOF;
+        }
+        if (start + n < AJSON_PATH_LEN) {
+            if (len) {
+                path[len] = '.';
+            }
+            if (this->extractValue(path, start + n, table, count) == EOF) {
+                return EOF;
+            }
+        } else if (this->skipValue() == EOF) {
+            return EOF; // path too long to be looked for
+        }
+        this->skip();
+        in = this->getch();
+    } while (in == ',');
+    path[len] = 0;
+    return (in == '}') ? 0 : EOF;
+}
+
+int aJsonStream::extractArray(char *path, size_t len, aJsonExtract *table, size_t count)
+{
+    this->getch(); // '['
+    this->skip();
+    int in = this->getch();
+    if (in == ']') {
+        return 0; // empty array.
+    }
+    this->ungetch(in);
+
+    unsigned int index = 0;
+    do {
+        int n = snprintf(path + len, AJSON_PATH_LEN - len, "[%u]", index++);
+        if (n > 0 && len + n < AJSON_PATH_LEN) {
+            if (this->extractValue(path, len + n, table, count) == EOF) {
+                return EOF;
+            }
+        } else if (this->skipValue() == EOF) {
+            return EOF;
+        }
+        this->skip();
+        in = this->getch();
+    } while (in == ',');
+    path[len] = 0;
+    return (in == ']') ? 0 : EOF;
+}
+
+// Convert the value to the type of the field, the way jsonGetValue() does.
+int aJsonStream::extractItem(aJsonExtract *field)
+{
+    int in = this->getch();
+    this->ungetch(in);
+    if (in == '\"') {
+        if (field->type != aJson_String) {
+            return this->skipValue();
+        }
+        if (this->readName((char *)field->value, field->size) == EOF) {
+            return EOF;
+        }
+        field->found = true;
+        return 0;
+    }
+    if (in == '{' || in == '[') {
+        return this->skipValue();
+    }
+
+    aJsonObject item;
+    memset(&item, 0, sizeof(item));
+    if (this->parseValue(&item, NULL) == EOF) {
+        return EOF;
+    }
+    if (item.type == aJson_Boolean) {
+        // true/false count as 1/0
+        item.type = aJson_Int;
+        item.valueint = item.valuebool ? 1 : 0;
+    }
+    switch (field->type) {
+        case aJson_Boolean:
+            if (item.type == aJson_Int) {
+                *(bool *)field->value = (item.valueint != 0);
+                field->found = true;
+            }
+            break;
+        case aJson_Int:
+            if (item.type == aJson_Int) {
+                *(int *)field->value = item.valueint;
+                field->found = true;
+            }
+            break;
+        case aJson_Uint:
+            if (item.type == aJson_Uint) {
+                *(uint32_t *)field->value = item.valueuint;
+                field->found = true;
+            } else if (item.type == aJson_Int && item.valueint >= 0) {
+                *(uint32_t *)field->value = item.valueint;
+                field->found = true;
+            }
+            break;
+        case aJson_Float:
+            if (item.type == aJson_Float) {
+                *(double *)field->value = item.valuefloat;
+                field->found = true;
+            } else if (item.type == aJson_Int) {
+                *(double *)field->value = item.valueint;
+                field->found = true;
+            } else if (item.type == aJson_Uint) {
+                *(double *)field->value = item.valueuint;
+                field->found = true;
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+aJsonWriter::aJsonWriter(char *buffer_, size_t size_)
+    : buffer(buffer_), size(buffer_ ? size_ : 0), sink(NULL), len(0), comma(0), depth(0)
+{
+    if (size) {
+        buffer[0] = 0;
+    }
+}
+
+aJsonWriter::aJsonWriter(Print *sink_)
+    : buffer(NULL), size(0), sink(sink_), len(0), comma(0), depth(0)
+{
+}
+
+void aJsonWriter::write(const char *str, size_t n)
+{
+    if (sink != NULL) {
+        sink->write((const uint8_t *)str, n);
+    } else if (len + 1 < size) {
+        size_t room = size - 1 - len;
+        size_t copy = (n < room) ? n : room;
+        memcpy(buffer + len, str, copy);
+        buffer[len + copy] = 0;
+    }
+    len += n;
+}
+
+// Runs of plain characters go out in one write.
+void aJsonWriter::writeString(const char *str)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *run = str ? str : "";
+    const char *ptr = run;
+
+    write("\"", 1);
+    for (; *ptr; ptr++) {
+        unsigned char ch = *ptr;
+        if (ch > 31 && ch != '\"' && ch != '\\') {
+            continue;
+        }
+        write(run, ptr - run);
+        run = ptr + 1;
+
+        char escape[6] = { '\\', (char)ch, '0', '0', hex[ch >> 4], hex[ch & 0xf] };
+        size_t n = 2;
+        switch (ch) {
+            case '\"':
+            case '\\':
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                n = 6;
+                break;
+        }
+        write(escape, n);
+    }
+    write(run, ptr - run);
+    write("\"", 1);
+}
+
+void aJsonWriter::writeNumber(unsigned long value, bool negative)
+{
+    char digits[24];
+    char *ptr = &digits[sizeof(digits)];
+    do {
+        *--ptr = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    if (negative) {
+        *--ptr = '-';
+    }
+    write(ptr, &digits[sizeof(digits)] - ptr);
+}
+
+void aJsonWriter::separator(const char *name)
+{
+    if (comma & (1UL << depth)) {
+        write(",", 1);
+    }
+    comma |= (1UL << depth);
+    if (name != NULL) {
+        writeString(name);
+        write(":", 1);
+    }
+}
+
+aJsonWriter& aJsonWriter::beginObject(const char *name)
+{
+    separator(name);
+    write("{", 1);
+    depth++;
+    comma &= ~(1UL << depth);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::endObject(void)
+{
+    depth--;
+    write("}", 1);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::beginArray(const char *name)
+{
+    separator(name);
+    write("[", 1);
+    depth++;
+    comma &= ~(1UL << depth);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::endArray(void)
+{
+    depth--;
+    write("]", 1);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, const char *value)
+{
+    separator(name);
+    writeString(value);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, bool value)
+{
+    separator(name);
+    if (value) {
+        write("true", 4);
+    } else {
+        write("false", 5);
+    }
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, int value)
+{
+    return add(name, (long)value);
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, unsigned int value)
+{
+    return add(name, (unsigned long)value);
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, long value)
+{
+    separator(name);
+    writeNumber((value < 0) ? 0UL - (unsigned long)value : (unsigned long)value, value < 0);
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::add(const char *name, unsigned long value)
+{
+    separator(name);
+    writeNumber(value, false);
+    return *this;
+}
+
+// Same digits as aJson print() gives, numbers JSON cannot hold become null.
+aJsonWriter& aJsonWriter::add(const char *name, double value, unsigned char digits)
+{
+    separator(name);
+    bool negative = value < 0;
+    if (negative) {
+        value = -value;
+    }
+    double rounding = 0.5;
+    for (unsigned char i = 0; i < digits; i++) {
+        rounding /= 10.0;
+    }
+    value += rounding;
+    if (isnan(value) || value >= 4294967295.0) {
+        write("null", 4);
+        return *this;
+    }
+
+    unsigned long integer = (unsigned long)value;
+    double remainder = value - (double)integer;
+    writeNumber(integer, negative);
+    if (digits) {
+        char fraction[16];
+        size_t n = 0;
+        fraction[n++] = '.';
+        while (digits-- && n < sizeof(fraction)) {
+            remainder *= 10.0;
+            int digit = (int)remainder;
+            remainder -= digit;
+            fraction[n++] = '0' + digit;
+        }
+        write(fraction, n);
+    }
+    return *this;
+}
+
+aJsonWriter& aJsonWriter::addNull(const char *name)
+{
+    separator(name);
+    write("null", 4);
+    return *this;
+}
+
 // Get Array size/item / object item.
 unsigned char aJsonClass::getArraySize(aJsonObject *array)
 {
@@ -774,7 +1371,7 @@ void aJsonClass::suffixObject(aJsonObject *prev, aJsonObject *item)
 // Utility for handling references.
 aJsonObject *aJsonClass::createReference(aJsonObject *item)
 {
-    aJsonObject *ref = newItem();
+    aJsonObject *ref = newItem(arena);
     if (!ref)
         return 0;
     memcpy(ref, item, sizeof(aJsonObject));
@@ -804,11 +1401,9 @@ void aJsonClass::addItemToObject(aJsonObject *object, const char *string, aJsonO
     if (!item)
         return;
     if (item->name)
-        free(item->name);
+        freeItem(arena, item->name);
 
-    //item->name = strdup(string);
-    item->name=(char *)malloc(strlen(string)+1);
-    strcpy(item->name,string);
+    item->name = newString(string);
 
     addItemToArray(object, item);
 }
@@ -888,9 +1483,7 @@ void aJsonClass::replaceItemInObject(aJsonObject *object, const char *string, aJ
     while (c && strcasecmp(c->name, string))
         i++, c = c->next;
     if (c) {
-        //newitem->name = strdup(string);
-        newitem->name=(char *)malloc(strlen(string)+1);
-        strcpy(newitem->name,string);
+        newitem->name = newString(string);
         replaceItemInArray(object, i, newitem);
     }
 }
@@ -898,7 +1491,7 @@ void aJsonClass::replaceItemInObject(aJsonObject *object, const char *string, aJ
 // Create basic types:
 aJsonObject *aJsonClass::createNull(void)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item)
         item->type = aJson_NULL;
     return item;
@@ -906,7 +1499,7 @@ aJsonObject *aJsonClass::createNull(void)
 
 aJsonObject *aJsonClass::createItem(bool b)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_Boolean;
         item->valuebool = b;
@@ -916,7 +1509,7 @@ aJsonObject *aJsonClass::createItem(bool b)
 
 aJsonObject *aJsonClass::createItem(char b)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_Boolean;
         item->valuebool = b ? -1 : 0;
@@ -926,7 +1519,7 @@ aJsonObject *aJsonClass::createItem(char b)
 
 aJsonObject *aJsonClass::createItem(int num)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_Int;
         item->valueint = (int) num;
@@ -936,7 +1529,7 @@ aJsonObject *aJsonClass::createItem(int num)
 
 aJsonObject *aJsonClass::createItem(uint32_t num)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_Uint;
         item->valueuint = (uint32_t)num;
@@ -946,7 +1539,7 @@ aJsonObject *aJsonClass::createItem(uint32_t num)
 
 aJsonObject *aJsonClass::createItem(double num)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_Float;
         item->valuefloat = num;
@@ -956,19 +1549,17 @@ aJsonObject *aJsonClass::createItem(double num)
 
 aJsonObject *aJsonClass::createItem(const char *string)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item) {
         item->type = aJson_String;
-        //item->valuestring = strdup(string);
-        item->valuestring=(char *)malloc(strlen(string)+1);
-        strcpy(item->valuestring,string);
+        item->valuestring = newString(string);
     }
     return item;
 }
 
 aJsonObject *aJsonClass::createArray(void)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item)
         item->type = aJson_Array;
     return item;
@@ -976,7 +1567,7 @@ aJsonObject *aJsonClass::createArray(void)
 
 aJsonObject *aJsonClass::createObject(void)
 {
-    aJsonObject *item = newItem();
+    aJsonObject *item = newItem(arena);
     if (item)
         item->type = aJson_Object;
     return item;
@@ -1375,3 +1966,8 @@ bool jsonGetValue(uint8_t *payload, const char *string, double &ret_double)
     return true;
 }
 
+int jsonGetValues(uint8_t *payload, aJsonExtract *table, size_t count)
+{
+    aJsonClass aJson;
+    return aJson.extract((char *)payload, table, count);
+}
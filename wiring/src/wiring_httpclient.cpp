@@ -27,6 +27,9 @@
 #ifndef configNO_NETWORK
 
 #include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <limits.h>
 #include "base64.h"
 #include "stream_string.h"
 #include "wiring_ticks.h"
@@ -81,6 +84,9 @@ HTTPClient::~HTTPClient()
     if(_currentHeaders) {
         delete[] _currentHeaders;
     }
+    if(_headerValues) {
+        delete[] _headerValues;
+    }
 }
 
 void HTTPClient::clear()
@@ -96,11 +102,14 @@ void HTTPClient::clear()
  */
 bool HTTPClient::begin(String url)
 {
+    String host = _host;
+    uint16_t port = _port;
     _transportTraits.reset(nullptr);
     _port = 80;
     if (!beginInternal(url, "http")) {
         return false;
     }
+    endOther(host, port);
     _transportTraits = TransportTraitsPtr(new TransportTraits());
     return true;
 }
@@ -155,8 +164,11 @@ bool HTTPClient::beginInternal(String url, const char* expectedProtocol)
 bool HTTPClient::begin(String host, uint16_t port, String uri)
 {
     clear();
+    String oldHost = _host;
+    uint16_t oldPort = _port;
     _host = host;
     _port = port;
+    endOther(oldHost, oldPort);
     _uri = uri;
     _transportTraits = TransportTraitsPtr(new TransportTraits());
     WHTTPCLIENT_DEBUG("[HTTP-Client][begin] host: %s port: %d uri: %s\r\n", host.c_str(), port, uri.c_str());
@@ -170,13 +182,24 @@ bool HTTPClient::begin(String host, uint16_t port, String uri)
 void HTTPClient::end(void)
 {
     if(connected()) {
-        if(_tcp->available() > 0) {
+        if(_bodyRaw && !_bodyDone) {
+            // the body was read off the socket, where it ends is unknown
+            _canReuse = false;
+        } else if(_reuse && _canReuse && !_bodyDone) {
+            // the next response has to start right behind this body
+            uint8_t buff[32];
+            while(readBody(buff, sizeof(buff)) > 0) {
+            }
+        }
+        if(connected() && _tcp->available() > 0) {
             WHTTPCLIENT_DEBUG("[HTTP-Client][end] still data in buffer (%d), clean up.\r\n", _tcp->available());
             while(_tcp->available() > 0) {
                 _tcp->read();
             }
         }
-        if(_reuse && _canReuse) {
+        if(!connected()) {
+            WHTTPCLIENT_DEBUG("[HTTP-Client][end] tcp is closed\r\n");
+        } else if(_reuse && _canReuse) {
             WHTTPCLIENT_DEBUG("[HTTP-Client][end] tcp keep open for reuse\r\n");
         } else {
             WHTTPCLIENT_DEBUG("[HTTP-Client][end] tcp stop\r\n");
@@ -185,6 +208,21 @@ void HTTPClient::end(void)
     } else {
         WHTTPCLIENT_DEBUG("[HTTP-Client][end] tcp is closed\r\n");
     }
+    _bodyDone = true;
+    _bodyRaw = false;
+}
+
+/**
+ * closes a kept alive connection to a server other than the current one
+ * @param host String   the server the connection was made to
+ * @param port uint16_t
+ */
+void HTTPClient::endOther(const String& host, uint16_t port)
+{
+    if(_tcp && ((_port != port) || !_host.equalsIgnoreCase(host))) {
+        WHTTPCLIENT_DEBUG("[HTTP-Client][begin] other server, tcp stop\r\n");
+        _tcp->stop();
+    }
 }
 
 /**
@@ -324,30 +362,40 @@ int HTTPClient::sendRequest(const char * type, String payload)
  */
 int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
 {
-    // connect to server
-    if(!connect()) {
-        return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
-    }
-
     if(payload && size > 0) {
         addHeader(F("Content-Length"), String(size));
     }
 
-    // send Header
-    if(!sendHeader(type)) {
-        return returnError(HTTPC_ERROR_SEND_HEADER_FAILED);
-    }
+    while(1) {
+        // a kept alive connection may have been closed by the server meanwhile
+        bool reused = connected();
 
-    // send Payload if needed
-    if(payload && size > 0) {
-        WHTTPCLIENT_DEBUG("[HTTP-Client][sendRequest] payload : %s\r\n", payload);
-        if(_tcp->write(&payload[0], size) != size) {
-            return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+        // connect to server
+        if(!connect()) {
+            return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
         }
-    }
 
-    // handle Server Response (Header)
-    return returnError(handleHeaderResponse());
+        int code;
+        if(!sendHeader(type)) {
+            // send Header
+            code = HTTPC_ERROR_SEND_HEADER_FAILED;
+        } else if(payload && size > 0 && _tcp->write(&payload[0], size) != size) {
+            // send Payload if needed
+            code = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        } else {
+            // handle Server Response (Header)
+            code = handleHeaderResponse();
+        }
+
+        // only a request that did not get out is sent again, once it is written
+        // the server may have acted on it (a POST must not be repeated)
+        if(reused && (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED)) {
+            WHTTPCLIENT_DEBUG("[HTTP-Client][sendRequest] reused connection is gone, reconnect\r\n");
+            _tcp->stop();
+            continue;
+        }
+        return returnError(code);
+    }
 }
 
 /**
@@ -504,6 +552,7 @@ int HTTPClient::getSize(void)
 TCPClient& HTTPClient::getStream(void)
 {
     if(connected()) {
+        _bodyRaw = true;
         return *_tcp;
     }
 
@@ -519,6 +568,7 @@ TCPClient& HTTPClient::getStream(void)
 TCPClient* HTTPClient::getStreamPtr(void)
 {
     if(connected()) {
+        _bodyRaw = true;
         return _tcp.get();
     }
 
@@ -606,10 +656,76 @@ int HTTPClient::writeToStream(Stream * stream)
         return returnError(HTTPC_ERROR_ENCODING);
     }
 
+    _bodyDone = true;
     end();
     return ret;
 }
 
+/**
+ * read the payload without buffering it, chunked transfer encoding is decoded
+ * @param buffer uint8_t *
+ * @param size size_t
+ * @return < 0 = error, 0 = end of the payload, > 0 = size read
+ */
+int HTTPClient::readBody(uint8_t * buffer, size_t size)
+{
+    if(_bodyDone || !size) {
+        return 0;
+    }
+
+    if(!_tcp) {
+        return returnError(HTTPC_ERROR_NOT_CONNECTED);
+    }
+
+    if((_transferEncoding == HTTPC_TE_CHUNKED) && (_bodyLeft == 0)) {
+        int len = readChunkSize();
+        if(len < 0) {
+            return returnError(len);
+        }
+        WHTTPCLIENT_DEBUG("[HTTP-Client][readBody] read chunk len: %d\r\n", len);
+        if(len == 0) {
+            len = readChunkTrailer();
+            if(len < 0) {
+                return returnError(len);
+            }
+            _bodyDone = true;
+            return 0;
+        }
+        _bodyLeft = len;
+    }
+
+    // read only the asked bytes
+    if((_bodyLeft > 0) && (size > (size_t) _bodyLeft)) {
+        size = _bodyLeft;
+    }
+
+    unsigned long lastDataTime = millis();
+    while(1) {
+        int len = _tcp->read(buffer, size);
+        if(len > 0) {
+            if(_bodyLeft > 0) {
+                _bodyLeft -= len;
+                if((_bodyLeft == 0) && (_transferEncoding == HTTPC_TE_IDENTITY)) {
+                    _bodyDone = true;
+                }
+            }
+            return len;
+        }
+        if(!_tcp->connected()) {
+            if(_bodyLeft < 0) {
+                // no Content-Length, the body ends with the connection
+                _bodyDone = true;
+                return 0;
+            }
+            return returnError(HTTPC_ERROR_CONNECTION_LOST);
+        }
+        if((millis() - lastDataTime) > _tcpTimeout) {
+            return returnError(HTTPC_ERROR_READ_TIMEOUT);
+        }
+        delay(0);
+    }
+}
+
 /**
  * return all payload as String (may need lot of ram or trigger out of memory!)
  * @return String
@@ -709,23 +825,38 @@ void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKey
     _currentHeaders = new RequestArgument[_headerKeysCount];
     for(size_t i = 0; i < _headerKeysCount; i++) {
         _currentHeaders[i].key = headerKeys[i];
+        _currentHeaders[i].value = nullptr;
+        _currentHeaders[i].length = 0;
+    }
+    if(!_headerValues) {
+        _headerValues = new char[HTTPCLIENT_HEADER_VALUES_SIZE];
     }
+    _headerValuesLength = 0;
 }
 
-String HTTPClient::header(const char* name)
+const char * HTTPClient::headerValue(const char* name, size_t* length)
 {
     for(size_t i = 0; i < _headerKeysCount; ++i) {
         if(_currentHeaders[i].key == name) {
+            if(length) {
+                *length = _currentHeaders[i].length;
+            }
             return _currentHeaders[i].value;
         }
     }
-    return String();
+    return nullptr;
+}
+
+String HTTPClient::header(const char* name)
+{
+    const char * value = headerValue(name);
+    return value ? String(value) : String();
 }
 
 String HTTPClient::header(size_t i)
 {
-    if(i < _headerKeysCount) {
-        return _currentHeaders[i].value;
+    if(i < _headerKeysCount && _currentHeaders[i].value) {
+        return String(_currentHeaders[i].value);
     }
     return String();
 }
@@ -746,7 +877,7 @@ int HTTPClient::headers()
 bool HTTPClient::hasHeader(const char* name)
 {
     for(size_t i = 0; i < _headerKeysCount; ++i) {
-        if((_currentHeaders[i].key == name) && (_currentHeaders[i].value.length() > 0)) {
+        if((_currentHeaders[i].key == name) && (_currentHeaders[i].length > 0)) {
             return true;
         }
     }
@@ -845,8 +976,69 @@ bool HTTPClient::sendHeader(const char * type)
     return (_tcp->write((const uint8_t *) header.c_str(), header.length()) == header.length());
 }
 
+/**
+ * compares a header name that is not terminated
+ * @param name const char *  the header name as received
+ * @param len size_t         its length
+ * @param key const char *   the name to compare with
+ * @return true if equal ignoring case
+ */
+static bool headerNameIs(const char * name, size_t len, const char * key)
+{
+    return (strlen(key) == len) && (strncasecmp(name, key, len) == 0);
+}
+
+/**
+ * handles one response header line, the status line or a header
+ * @param line char *   the line, terminated and trimmed
+ * @param len size_t    its length
+ */
+void HTTPClient::handleHeaderLine(char * line, size_t len)
+{
+    if(strncmp(line, "HTTP/1.", 7) == 0) {
+        _returnCode = (len > 9) ? atoi(line + 9) : 0;
+        // HTTP/1.1 keeps the connection open unless told otherwise
+        _canReuse = _reuse && (line[7] != '0');
+        return;
+    }
+
+    char * value = strchr(line, ':');
+    if(!value) {
+        return;
+    }
+    size_t nameLen = value - line;
+    value ++;
+    while(*value == ' ' || *value == '\t') {
+        value ++;
+    }
+
+    if(headerNameIs(line, nameLen, "Content-Length")) {
+        _size = atoi(value);
+    } else if(headerNameIs(line, nameLen, "Connection")) {
+        _canReuse = _reuse && (strcasecmp(value, "keep-alive") == 0);
+    } else if(headerNameIs(line, nameLen, "Transfer-Encoding")) {
+        _transferEncoding = (strcasecmp(value, "chunked") == 0) ? HTTPC_TE_CHUNKED : HTTPC_TE_UNKNOWN;
+    }
+
+    for(size_t i = 0; i < _headerKeysCount; i++) {
+        if(headerNameIs(line, nameLen, _currentHeaders[i].key.c_str())) {
+            // the values are kept in one buffer, what does not fit is left out
+            size_t valueLen = (line + len) - value;
+            if(_headerValuesLength + valueLen < HTTPCLIENT_HEADER_VALUES_SIZE) {
+                char * copy = _headerValues + _headerValuesLength;
+                memcpy(copy, value, valueLen + 1);
+                _headerValuesLength += valueLen + 1;
+                _currentHeaders[i].value = copy;
+                _currentHeaders[i].length = valueLen;
+            }
+            break;
+        }
+    }
+}
+
 /**
  * reads the response from the server
+ * the header lines are parsed in a fixed buffer, nothing is allocated
  * @return int http code
  */
 int HTTPClient::handleHeaderResponse()
@@ -855,80 +1047,75 @@ int HTTPClient::handleHeaderResponse()
         return HTTPC_ERROR_NOT_CONNECTED;
     }
 
-    String transferEncoding;
+    char line[HTTPCLIENT_HEADER_LINE_SIZE];
+    size_t len = 0;
+
     _returnCode = -1;
     _size = -1;
     _transferEncoding = HTTPC_TE_IDENTITY;
+    _canReuse = false;
+    _bodyDone = true;
+    _bodyRaw = false;
+    _headerValuesLength = 0;
+    for(size_t i = 0; i < _headerKeysCount; i++) {
+        _currentHeaders[i].value = nullptr;
+        _currentHeaders[i].length = 0;
+    }
     unsigned long lastDataTime = millis();
 
     while(connected()) {
-        size_t len = _tcp->available();
-        if(len > 0) {
-            String headerLine = _tcp->readStringUntil('\n');
-            headerLine.trim(); // remove \r
-
-            lastDataTime = millis();
-
-            WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] RX: '%s'\r\n", headerLine.c_str());
-
-            if(headerLine.startsWith("HTTP/1.")) {
-                _returnCode = headerLine.substring(9, headerLine.indexOf(' ', 9)).toInt();
-            } else if(headerLine.indexOf(':')) {
-                String headerName = headerLine.substring(0, headerLine.indexOf(':'));
-                String headerValue = headerLine.substring(headerLine.indexOf(':') + 1);
-                headerValue.trim();
-
-                if(headerName.equalsIgnoreCase("Content-Length")) {
-                    _size = headerValue.toInt();
-                }
-
-                if(headerName.equalsIgnoreCase("Connection")) {
-                    _canReuse = headerValue.equalsIgnoreCase("keep-alive");
-                }
-
-                if(headerName.equalsIgnoreCase("Transfer-Encoding")) {
-                    transferEncoding = headerValue;
-                }
+        int c = _tcp->read();
+        if(c < 0) {
+            if((millis() - lastDataTime) > _tcpTimeout) {
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            delay(0);
+            continue;
+        }
+        lastDataTime = millis();
 
-                for(size_t i = 0; i < _headerKeysCount; i++) {
-                    if(_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
-                        _currentHeaders[i].value = headerValue;
-                        break;
-                    }
-                }
+        if(c != '\n') {
+            // the rest of an overlong line is dropped
+            if(len < sizeof(line) - 1) {
+                line[len++] = c;
             }
+            continue;
+        }
+        while(len > 0 && isspace((unsigned char) line[len - 1])) {
+            len--; // remove \r
+        }
+        line[len] = 0;
 
-            if(headerLine == "") {
-                WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] code: %d\r\n", _returnCode);
+        WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] RX: '%s'\r\n", line);
 
-                if(_size > 0) {
-                    WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] size: %d\r\n", _size);
-                }
+        if(len > 0) {
+            handleHeaderLine(line, len);
+            len = 0;
+            continue;
+        }
 
-                if(transferEncoding.length() > 0) {
-                    WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] Transfer-Encoding: %s\r\n", transferEncoding.c_str());
-                    if(transferEncoding.equalsIgnoreCase("chunked")) {
-                        _transferEncoding = HTTPC_TE_CHUNKED;
-                    } else {
-                        return HTTPC_ERROR_ENCODING;
-                    }
-                } else {
-                    _transferEncoding = HTTPC_TE_IDENTITY;
-                }
+        WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] code: %d\r\n", _returnCode);
 
-                if(_returnCode) {
-                    return _returnCode;
-                } else {
-                    WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] Remote host is not an HTTP Server!\r\n");
-                    return HTTPC_ERROR_NO_HTTP_SERVER;
-                }
-            }
+        if(_size > 0) {
+            WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] size: %d\r\n", _size);
+        }
+
+        if(_transferEncoding == HTTPC_TE_UNKNOWN) {
+            WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] unsupported Transfer-Encoding\r\n");
+            return HTTPC_ERROR_ENCODING;
+        }
+        if((_transferEncoding == HTTPC_TE_IDENTITY) && (_size < 0)) {
+            // the body ends when the server closes the connection
+            _canReuse = false;
+        }
+        _bodyLeft = (_transferEncoding == HTTPC_TE_CHUNKED) ? 0 : _size;
+        _bodyDone = (_transferEncoding == HTTPC_TE_IDENTITY) && (_size == 0);
 
+        if(_returnCode) {
+            return _returnCode;
         } else {
-            if((millis() - lastDataTime) > _tcpTimeout) {
-                return HTTPC_ERROR_READ_TIMEOUT;
-            }
-            delay(0);
+            WHTTPCLIENT_DEBUG("[HTTP-Client][handleHeaderResponse] Remote host is not an HTTP Server!\r\n");
+            return HTTPC_ERROR_NO_HTTP_SERVER;
         }
     }
 
@@ -1047,6 +1234,88 @@ int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
     return bytesWritten;
 }
 
+/**
+ * read one byte of the response
+ * @return < 0 = error, byte otherwise
+ */
+int HTTPClient::readTimeout(void)
+{
+    unsigned long lastDataTime = millis();
+
+    while(connected()) {
+        int c = _tcp->read();
+        if(c >= 0) {
+            return c;
+        }
+        if((millis() - lastDataTime) > _tcpTimeout) {
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        delay(0);
+    }
+    return HTTPC_ERROR_CONNECTION_LOST;
+}
+
+/**
+ * read a chunk header "<hex size>[;extension]\r\n", the \r\n ending the previous chunk is skipped
+ * @return < 0 = error, size of the chunk otherwise
+ */
+int HTTPClient::readChunkSize(void)
+{
+    int size = -1;
+    bool extension = false;
+
+    while(1) {
+        int c = readTimeout();
+        if(c < 0) {
+            return c;
+        }
+        if(c == '\n') {
+            if(size >= 0) {
+                return size;
+            }
+            if(extension) {
+                return HTTPC_ERROR_ENCODING;
+            }
+            continue;
+        }
+        if(extension || (c == '\r')) {
+            continue;
+        }
+        if((c == ';') || (c == ' ') || (c == '\t')) {
+            extension = true;
+            continue;
+        }
+        if(!isxdigit(c) || (size > (INT_MAX >> 4))) {
+            return HTTPC_ERROR_ENCODING;
+        }
+        size = ((size < 0) ? 0 : (size << 4)) + (isdigit(c) ? (c - '0') : (tolower(c) - 'a' + 10));
+    }
+}
+
+/**
+ * skip the trailer lines behind the last chunk up to the closing empty line
+ * @return < 0 = error, 0 = ok
+ */
+int HTTPClient::readChunkTrailer(void)
+{
+    size_t len = 0;
+
+    while(1) {
+        int c = readTimeout();
+        if(c < 0) {
+            return c;
+        }
+        if(c == '\n') {
+            if(len == 0) {
+                return 0;
+            }
+            len = 0;
+        } else if(c != '\r') {
+            len++;
+        }
+    }
+}
+
 /**
  * called to handle error return, may disconnect the connection if still exists
  * @param error
@@ -27,6 +27,8 @@
 #include "socket_hal.h"
 #include "inet_hal.h"
 #include "intorobot_macros.h"
+#include "wiring_ticks.h"
+#include <new>
 
 //#define WIRING_TCPCLIENT_DEBUG
 
@@ -43,6 +45,7 @@
 using namespace intorobot;
 
 uint16_t TCPClient::_srcport = 1024;
+TCPClient* TCPClient::_txClients = NULL;
 
 static bool inline isOpen(sock_handle_t sd)
 {
@@ -53,11 +56,146 @@ TCPClient::TCPClient() : TCPClient(socket_handle_invalid())
 {
 }
 
-TCPClient::TCPClient(sock_handle_t sock) : _sock(sock)
+TCPClient::TCPClient(sock_handle_t sock) : _sock(sock), _buffer(NULL), _bufferSize(TCPCLIENT_BUF_MAX_SIZE), _bufferAllocated(0), _txBuffer(NULL), _txSize(0), _txCount(0), _txAllocated(0), _txNext(NULL)
 {
     flush_buffer();
 }
 
+TCPClient::TCPClient(const TCPClient& client) : Client(client), _buffer(NULL), _bufferSize(TCPCLIENT_BUF_MAX_SIZE), _bufferAllocated(0), _txBuffer(NULL), _txSize(0), _txCount(0), _txAllocated(0), _txNext(NULL)
+{
+    *this = client;
+}
+
+TCPClient::~TCPClient()
+{
+    // copies of this client do not share what it buffered
+    sendBuffered();
+    releaseWriteBuffer();
+    releaseReadBuffer();
+}
+
+TCPClient& TCPClient::operator=(const TCPClient& client)
+{
+    if (this != &client)
+    {
+        // what is buffered belongs to the socket being replaced
+        sendBuffered();
+        Client::operator=(client);
+        _sock = client._sock;
+        flush_buffer();
+        if (!_buffer || (_bufferSize != client._bufferSize))
+        {
+            releaseReadBuffer();
+            _bufferSize = client._bufferSize;
+        }
+        if ((client._total > client._offset) && (_buffer || setReadBuffer(_bufferSize)))
+        {
+            _total = client._total - client._offset;
+            memcpy(_buffer, client._buffer + client._offset, _total);
+        }
+        _remoteIP = client._remoteIP;
+        // only the size is copied, what client buffered is sent by client
+        if (client._txSize != _txSize)
+            setWriteBuffer(client._txSize);
+    }
+    return *this;
+}
+
+bool TCPClient::setWriteBuffer(size_t buffer_size, uint8_t* buffer)
+{
+    sendBuffered();
+    releaseWriteBuffer();
+    if (buffer_size > 0xFFFF)
+        return false;
+    _txBuffer = buffer_size ? buffer : NULL;
+    if (!_txBuffer && buffer_size)
+    {
+        _txBuffer = new (std::nothrow) uint8_t[buffer_size];
+        _txAllocated = true;
+    }
+    if (_txBuffer && buffer_size)
+    {
+        _txSize = buffer_size;
+        _txNext = _txClients;
+        _txClients = this;
+    }
+    return _txSize == buffer_size;
+}
+
+bool TCPClient::setReadBuffer(size_t buffer_size, uint8_t* buffer)
+{
+    int count = bufferCount();
+    if (!buffer_size || (buffer_size > 0xFFFF) || ((size_t)count > buffer_size))
+        return false;
+    uint8_t* b = buffer ? buffer : new (std::nothrow) uint8_t[buffer_size];
+    if (!b)
+        return false;
+    if (count)
+        memcpy(b, _buffer + _offset, count);
+    releaseReadBuffer();
+    _buffer = b;
+    _bufferAllocated = !buffer;
+    _bufferSize = buffer_size;
+    _offset = 0;
+    _total = count;
+    return true;
+}
+
+void TCPClient::releaseReadBuffer()
+{
+    if (_bufferAllocated && _buffer)
+        delete[] _buffer;
+    _buffer = NULL;
+    _bufferAllocated = false;
+}
+
+void TCPClient::releaseWriteBuffer()
+{
+    if (_txSize)
+    {
+        TCPClient** c = &_txClients;
+        while (*c && *c != this)
+            c = &(*c)->_txNext;
+        if (*c)
+            *c = _txNext;
+    }
+    if (_txAllocated && _txBuffer)
+        delete[] _txBuffer;
+    _txBuffer = NULL;
+    _txAllocated = false;
+    _txSize = 0;
+    _txCount = 0;
+    _txNext = NULL;
+}
+
+int TCPClient::sendBuffered()
+{
+    int sent = 0;
+    while (sent < _txCount)
+    {
+        int n = isOpen(_sock) ? socket_send(_sock, _txBuffer + sent, _txCount - sent) : -1;
+        if (n <= 0)
+        {
+            // failed and there is nothing better to do with the rest
+            _txCount = 0;
+            return -1;
+        }
+        sent += n;
+    }
+    _txCount = 0;
+    return sent;
+}
+
+void TCPClient::flushIdle()
+{
+    system_tick_t now = millis();
+    for (TCPClient* c = _txClients; c; c = c->_txNext)
+    {
+        if (c->_txCount && ((now - c->_txTime) >= TCPCLIENT_WRITE_IDLE_MS))
+            c->sendBuffered();
+    }
+}
+
 int TCPClient::connect(const char* host, uint16_t port, network_interface_t nif)
 {
     stop();
@@ -122,7 +260,21 @@ size_t TCPClient::write(uint8_t b)
 
 size_t TCPClient::write(const uint8_t *buffer, size_t size)
 {
-    return status() ? socket_send(_sock, buffer, size) : -1;
+    if (!status())
+        return -1;
+    if (!_txSize)
+        return socket_send(_sock, buffer, size);
+    // keep the order, what is buffered goes out first
+    if ((_txCount + size > _txSize) && (sendBuffered() < 0))
+        return -1;
+    if (size > _txSize)
+        return socket_send(_sock, buffer, size);
+    memcpy(_txBuffer + _txCount, buffer, size);
+    _txCount += size;
+    _txTime = millis();
+    if (_txCount == _txSize)
+        sendBuffered();
+    return size;
 }
 
 int TCPClient::bufferCount()
@@ -134,18 +286,27 @@ int TCPClient::available()
 {
     int avail = 0;
 
+    // the peer likely waits for what is buffered before it answers
+    sendBuffered();
+
     // At EOB => Flush it
     if (_total && (_offset == _total))
     {
         flush_buffer();
     }
 
+    // the buffer is allocated on first use
+    if(!_buffer && !setReadBuffer(_bufferSize))
+    {
+        return 0;
+    }
+
     if(Network.from(nif).ready() && isOpen(_sock))
     {
         // Have room
-        if ( _total < arraySize(_buffer))
+        if ( _total < _bufferSize)
         {
-            int ret = socket_receive(_sock, _buffer + _total , arraySize(_buffer)-_total, 0);
+            int ret = socket_receive(_sock, _buffer + _total , _bufferSize-_total, 0);
             if (ret > 0)
             {
                 WTCPCLIENT_DEBUG("tcp receive data %d\r\n", ret);
@@ -160,23 +321,72 @@ int TCPClient::available()
 
 int TCPClient::read()
 {
+    sendBuffered();
     return (bufferCount() || available()) ? _buffer[_offset++] : -1;
 }
 
 int TCPClient::read(uint8_t *buffer, size_t size)
 {
-    int read = -1;
-    if (bufferCount() || available())
+    sendBuffered();
+    int read = bufferCount();
+    if ((size_t) read >= size)
+    {
+        memcpy(buffer, &_buffer[_offset], size);
+        _offset += size;
+        return size;
+    }
+    if (!read && (size < _bufferSize))
     {
+        // small reads go through the buffer, one receive may serve several of them
+        if (!available())
+            return -1;
         read = (size > (size_t) bufferCount()) ? bufferCount() : size;
         memcpy(buffer, &_buffer[_offset], read);
         _offset += read;
+        return read;
+    }
+    // more than is buffered, hand that out and receive the rest
+    // straight into the caller's memory
+    if (read)
+    {
+        memcpy(buffer, &_buffer[_offset], read);
+        flush_buffer();
+    }
+    if(Network.from(nif).ready() && isOpen(_sock))
+    {
+        int ret = socket_receive(_sock, buffer + read, size - read, 0);
+        if (ret > 0)
+        {
+            WTCPCLIENT_DEBUG("tcp receive data %d\r\n", ret);
+            read += ret;
+        }
+    }
+    return read ? read : -1;
+}
+
+size_t TCPClient::readBytes(char *buffer, size_t length)
+{
+    size_t count = 0;
+    _startMillis = millis();
+    while (count < length)
+    {
+        int n = read((uint8_t *) buffer + count, length - count);
+        if (n > 0)
+        {
+            count += n;
+            _startMillis = millis();
+        }
+        else if ((millis() - _startMillis) >= _timeout)
+        {
+            break;
+        }
     }
-    return read;
+    return count;
 }
 
 int TCPClient::peek()
 {
+    sendBuffered();
     return  (bufferCount() || available()) ? _buffer[_offset] : -1;
 }
 
@@ -188,6 +398,7 @@ void TCPClient::flush_buffer()
 
 void TCPClient::flush()
 {
+    sendBuffered();
     while (available())
         read();
 }
@@ -196,6 +407,7 @@ void TCPClient::flush()
 void TCPClient::stop()
 {
     WTCPCLIENT_DEBUG("tcp stop! close socket %d\r\n", _sock);
+    sendBuffered();
     if (isOpen(_sock))
         socket_close(_sock);
     _sock = socket_handle_invalid();
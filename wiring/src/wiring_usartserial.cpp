@@ -62,7 +62,7 @@ void USARTSerial::blockOnOverrun(bool block)
 
 int USARTSerial::availableForWrite(void)
 {
-    return HAL_USART_Available_Data(_serial);
+    return HAL_USART_Available_Data_For_Write(_serial);
 }
 
 int USARTSerial::available(void)
@@ -80,6 +80,11 @@ int USARTSerial::read(void)
     return HAL_USART_Read_Data(_serial);
 }
 
+int USARTSerial::read(uint8_t *buffer, size_t size)
+{
+    return HAL_USART_Read_Buffer(_serial, buffer, size);
+}
+
 void USARTSerial::flush()
 {
     HAL_USART_Flush_Data(_serial);
@@ -95,6 +100,33 @@ size_t USARTSerial::write(uint8_t c)
     return 0;
 }
 
+size_t USARTSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (_blocking) {
+        return HAL_USART_Write_Buffer(_serial, buffer, size);
+    }
+    // non-blocking writes only take what there is room for. HALs without a
+    // transmit queue report room for one byte and send it at once, so ask
+    // again until everything is written or there is no room left
+    size_t sent = 0;
+    while (sent < size) {
+        int room = HAL_USART_Available_Data_For_Write(_serial);
+        if (room <= 0) {
+            break;
+        }
+        size_t n = size - sent;
+        if (n > (size_t)room) {
+            n = room;
+        }
+        size_t written = HAL_USART_Write_Buffer(_serial, buffer + sent, n);
+        sent += written;
+        if (written < n) {
+            break;
+        }
+    }
+    return sent;
+}
+
 size_t USARTSerial::write(uint16_t c)
 {
     return HAL_USART_Write_NineBitData(_serial, c);
@@ -50,6 +50,11 @@ int USBSerial::read()
     return USB_USART_Receive_Data(false);
 }
 
+int USBSerial::read(uint8_t *buffer, size_t size)
+{
+    return USB_USART_Receive_Buffer(buffer, size);
+}
+
 int USBSerial::availableForWrite()
 {
     return USB_USART_Available_Data_For_Write();